@@ -0,0 +1,195 @@
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import time
+
+BIN_PATH = "./build/bench_sha1"
+BASELINE_PATH = "./tests/bench_baseline.json"
+FORMAT_VERSION = 1
+
+REPEAT = 5              # bench_sha1 runs per measurement
+THRESHOLD = 0.05        # slowdowns below 5% are never reported
+NSIGMA = 3.0            # ... nor those within 3 standard deviations of the noise
+MAD_SIGMA = 1.4826      # MAD to standard deviation, for normally distributed noise
+
+#
+#  Usage:
+#
+#    python bench_gate.py record  [baseline.json] [-- bench_sha1 args]
+#    python bench_gate.py compare [baseline.json] [-- bench_sha1 args]
+#
+#  'record' runs build/bench_sha1 -f json REPEAT times and writes the
+#  median and the median absolute deviation (MAD) of ns per call for
+#  every (op, backend, size) to the baseline, together with the build
+#  flags, compiler, CPU and git commit it was measured on.
+#
+#  'compare' measures again the same way (with the baseline's
+#  bench_sha1 arguments unless others are given) and fails (exit
+#  status 1) if a case got slower by more than THRESHOLD and by more
+#  than NSIGMA times the combined noise of both measurements, so that a
+#  single noisy run can neither hide nor fake a regression.  Cases that
+#  are missing on one side are listed but do not fail the gate.
+#
+#  REPEAT, THRESHOLD, CC and OPTFLAGS (recorded as the build) are read
+#  from the environment.
+#
+
+
+#
+# Helper functions
+#
+
+
+def git_commit():
+  """ Commit the benchmark binary was built from, or "" outside a git tree """
+  try:
+    out = subprocess.run(["git", "rev-parse", "--short", "HEAD"], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    return out.stdout.decode().strip()
+  except OSError:
+    return ""
+
+
+def compiler():
+  """ First line of $CC --version """
+  try:
+    out = subprocess.run([os.environ.get("CC", "cc"), "--version"], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    return out.stdout.decode().split("\n")[0].strip()
+  except OSError:
+    return ""
+
+
+def cpu_model():
+  try:
+    with open("/proc/cpuinfo") as f:
+      for line in f:
+        if line.startswith("model name"):
+          return line.split(":", 1)[1].strip()
+  except OSError:
+    pass
+  return platform.processor()
+
+
+def measure(bench_args, repeat):
+  """ ns per call of every case over 'repeat' runs: {(op, backend, size): [ns, ...]} """
+  samples = {}
+  for r in range(repeat):
+    out = subprocess.run([BIN_PATH, "-f", "json"] + bench_args, stdout=subprocess.PIPE, check=True)
+    for rec in json.loads(out.stdout.decode())["results"]:
+      samples.setdefault((rec["op"], rec["backend"], rec["size"]), []).append(rec["ns_per_call"])
+    print("  run %d of %d: %d cases" % (r + 1, repeat, len(samples)))
+  return samples
+
+
+def summarize(ns):
+  median = statistics.median(ns)
+  mad = statistics.median([abs(x - median) for x in ns])
+  return { "median_ns": round(median, 1), "mad_ns": round(mad, 1), "runs": len(ns) }
+
+
+def case_name(op, backend, size):
+  return "%s/%s/%d" % (op, backend, size)
+
+
+def environment(bench_args):
+  return {
+    "format": FORMAT_VERSION,
+    "date": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+    "commit": git_commit(),
+    "compiler": compiler(),
+    "optflags": os.environ.get("OPTFLAGS", "").strip(),
+    "cpu": cpu_model(),
+    "bench_args": bench_args,
+  }
+
+
+def record(path, bench_args, repeat):
+  samples = measure(bench_args, repeat)
+  baseline = environment(bench_args)
+  baseline["cases"] = [dict(op=op, backend=backend, size=size, **summarize(ns))
+                       for (op, backend, size), ns in sorted(samples.items())]
+  with open(path, "w") as f:
+    json.dump(baseline, f, indent=2)
+    f.write("\n")
+  print("")
+  print("Recorded %d cases (%d runs each) to %s" % (len(samples), repeat, path))
+  return 0
+
+
+def compare(path, bench_args, repeat, threshold):
+  with open(path) as f:
+    baseline = json.load(f)
+  if baseline.get("format") != FORMAT_VERSION:
+    print("%s: baseline format %s, expected %d: record it again" % (path, baseline.get("format"), FORMAT_VERSION))
+    return 2
+
+  if not bench_args:
+    bench_args = baseline.get("bench_args", [])
+  current = environment(bench_args)
+  for field in ("compiler", "optflags", "cpu", "bench_args"):
+    if baseline.get(field) != current[field]:
+      print("  warning: %s differs from the baseline: %r, baseline %r" % (field, current[field], baseline.get(field)))
+
+  samples = measure(bench_args, repeat)
+  base = dict(((c["op"], c["backend"], c["size"]), c) for c in baseline["cases"])
+
+  print("")
+  print("%-40s %12s %12s %8s  %s" % ("case", "baseline ns", "current ns", "change", ""))
+  regressions = 0
+  for key in sorted(set(base) | set(samples)):
+    if key not in samples:
+      print("%-40s %12.1f %12s %8s  missing" % (case_name(*key), base[key]["median_ns"], "-", ""))
+      continue
+    now = summarize(samples[key])
+    if key not in base:
+      print("%-40s %12s %12.1f %8s  new" % (case_name(*key), "-", now["median_ns"], ""))
+      continue
+
+    old = base[key]
+    delta = now["median_ns"] - old["median_ns"]
+    noise = MAD_SIGMA * (old["mad_ns"] ** 2 + now["mad_ns"] ** 2) ** 0.5
+    # throughput change: positive is faster
+    change = old["median_ns"] / now["median_ns"] - 1.0 if now["median_ns"] > 0 else 0.0
+    verdict = ""
+    if (-change > threshold) and (delta > NSIGMA * noise):
+      verdict = "REGRESSION"
+      regressions += 1
+    elif (change > threshold) and (-delta > NSIGMA * noise):
+      verdict = "faster"
+    print("%-40s %12.1f %12.1f %+7.1f%%  %s" % (case_name(*key), old["median_ns"], now["median_ns"], 100.0 * change, verdict))
+
+  print("")
+  print("%d of %d cases slower than the baseline by more than %.0f%% (baseline %s, commit %s)"
+        % (regressions, len(base), 100.0 * threshold, baseline.get("date", "?"), baseline.get("commit", "?") or "?"))
+  return 1 if regressions > 0 else 0
+
+
+
+#
+# Driver
+#
+if __name__ == "__main__":
+
+  args = sys.argv[1:]
+  bench_args = []
+  if "--" in args:
+    bench_args = args[args.index("--") + 1:]
+    args = args[:args.index("--")]
+
+  if (len(args) not in (1, 2)) or (args[0] not in ("record", "compare")):
+    print("")
+    print("Usage: %s record|compare [baseline.json] [-- bench_sha1 args]" % sys.argv[0])
+    print("")
+    sys.exit(2)
+
+  path = args[1] if len(args) > 1 else BASELINE_PATH
+  repeat = int(os.environ.get("REPEAT", REPEAT))
+  threshold = float(os.environ.get("THRESHOLD", THRESHOLD))
+
+  print("")
+  if args[0] == "record":
+    sys.exit(record(path, bench_args, repeat))
+  else:
+    sys.exit(compare(path, bench_args, repeat, threshold))
@@ -0,0 +1,129 @@
+from hashlib import sha1
+import hmac
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+BIN_PATH = "./build/hmac-sha1sum"
+
+# File sizes around the block size, the read() buffer and the mmap chunk
+SIZES = [0, 1, 55, 63, 64, 65, 4095, 1048575, 1048576, 1048577, 3000017]
+KEY = b"Jefe, what do ya want for nothing?"
+
+
+#
+# Helper functions
+#
+
+
+def run(args, stdin=None):
+  return subprocess.run([BIN_PATH] + args, input=stdin, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+
+def sum_lines(digest, names, datas):
+  return "".join("%s  %s\n" % (digest(d), n) for n, d in zip(names, datas)).encode()
+
+
+def check(what, ok):
+  print("  %-60s %s" % (what, "OK" if ok else "FAILED"))
+  return 0 if ok else 1
+
+
+
+#
+# Test driver
+#
+if __name__ == "__main__":
+
+  print("")
+  print("Running %s on %d files, through mmap, a pipe and a directory walk, comparing" % (BIN_PATH, len(SIZES)))
+  print("the output to Python's hashlib and hmac modules.")
+  print("")
+
+  tmpdir = tempfile.mkdtemp()
+  failures = 0
+  try:
+    names = []
+    datas = []
+    for size in SIZES:
+      name = os.path.join(tmpdir, "f%d" % size)
+      data = bytes(random.getrandbits(8) for _ in range(min(size, 4096))) * (size // 4096 + 1)
+      data = data[:size]
+      with open(name, "wb") as f:
+        f.write(data)
+      names.append(name)
+      datas.append(data)
+
+    sha_hex = lambda d: sha1(d).hexdigest()
+    hmac_hex = lambda d: hmac.new(KEY, d, sha1).hexdigest()
+
+    proc = run(names)
+    failures += check("SHA-1 of mapped files", proc.returncode == 0 and proc.stdout == sum_lines(sha_hex, names, datas))
+
+    proc = run(["-k", KEY.decode()] + names)
+    failures += check("HMAC-SHA1 of mapped files, -k", proc.returncode == 0 and proc.stdout == sum_lines(hmac_hex, names, datas))
+
+    keyfile = os.path.join(tmpdir, "key")
+    with open(keyfile, "wb") as f:
+      f.write(KEY)
+    proc = run(["-K", keyfile, names[-1]])
+    failures += check("HMAC-SHA1 with the key from a file, -K", proc.stdout == sum_lines(hmac_hex, names[-1:], datas[-1:]))
+
+    ok = True
+    for data in (datas[0], datas[-1]):
+      proc = run([], stdin=data)
+      ok = ok and proc.stdout == sum_lines(sha_hex, ["-"], [data])
+    failures += check("SHA-1 of standard input", ok)
+
+    sums = os.path.join(tmpdir, "sums")
+    with open(sums, "wb") as f:
+      f.write(sum_lines(sha_hex, names, datas))
+    proc = run(["-c", sums])
+    failures += check("check mode, all files intact", proc.returncode == 0 and proc.stdout.count(b": OK\n") == len(names))
+
+    with open(names[-1], "r+b") as f:
+      f.seek(12345)
+      f.write(bytes([datas[-1][12345] ^ 1]))
+    proc = run(["-c", sums])
+    failures += check("check mode, one file modified", proc.returncode == 1 and proc.stdout.count(b": FAILED\n") == 1)
+
+    tree = os.path.join(tmpdir, "tree")
+    tree_names = []
+    tree_datas = []
+    for i in range(300):
+      name = os.path.join(tree, "d%d" % (i % 4), "e%d" % (i % 3), "f%03d" % i)
+      os.makedirs(os.path.dirname(name), exist_ok=True)
+      data = datas[i % len(datas)][i % 5:]
+      with open(name, "wb") as f:
+        f.write(data)
+      tree_names.append(name)
+      tree_datas.append(data)
+    order = sorted(range(len(tree_names)), key=lambda i: tree_names[i])
+    tree_names = [tree_names[i] for i in order]
+    tree_datas = [tree_datas[i] for i in order]
+
+    manifest = os.path.join(tmpdir, "manifest")
+    for backend in ("io_uring", "threads"):
+      os.environ["SHA1_IO_BACKEND"] = backend
+      proc = run(["-k", KEY.decode(), "-m", "1", "-r", tree])
+      failures += check("HMAC-SHA1 manifest of a tree, -r, %s reader" % backend,
+                        proc.returncode == 0 and proc.stdout == sum_lines(hmac_hex, tree_names, tree_datas))
+    with open(manifest, "wb") as f:
+      f.write(proc.stdout)
+    proc = run(["-k", KEY.decode(), "-c", manifest])
+    failures += check("check mode on the manifest", proc.returncode == 0 and proc.stdout.count(b": OK\n") == len(tree_names))
+    del os.environ["SHA1_IO_BACKEND"]
+
+    if shutil.which("sha1sum") is not None:
+      proc = subprocess.run(["sha1sum"] + names, stdout=subprocess.PIPE)
+      failures += check("output identical to sha1sum", run(names).stdout == proc.stdout)
+  finally:
+    shutil.rmtree(tmpdir)
+
+  print("")
+
+  if failures != 0:
+    sys.exit(1)
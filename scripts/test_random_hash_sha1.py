@@ -2,27 +2,16 @@ import binascii
 import hashlib
 import os
 import random
-import string
 import subprocess
 import sys
-import time
-import threading
-try:
-    import Queue
-except:
-    import queue as Queue
+import tempfile
 
-BIN_PATH = "./build/test_random_sha1"
+BIN_PATH = "./build/test_vectors_sha1"
 
 NTHREADS = 2
 NTESTS = 10
 NBYTES = 20
 
-global still_making_input
-still_making_input = True
-tests = Queue.Queue()
-failures = list()
-
 
 #
 # Helper functions
@@ -30,55 +19,33 @@ failures = list()
 
 
 def random_string(len):
-  """ Returns a random string of length 'len' consisting of upper + lowercase letters and digits """
-  ret = list()
-  rand = random.Random()
-
-  for i in range(len):
-    ret.append("%.02x" % rand.randint(0, 255))
-
-  return "".join(ret)
-
-  #selector = string.ascii_uppercase + string.ascii_lowercase + string.digits
-  #return ''.join(random.choice(selector) for _ in range(len))
-
-
-def run_test(input_string, expected_output):
-  """ Run the C test program, comparing the Python SHA1 implementation to the one in C """
-  return subprocess.call([BIN_PATH, input_string, expected_output])
-
+  """ Returns a hex string of 'len' random bytes """
+  return "%0*x" % (2 * len, random.getrandbits(8 * len)) if len > 0 else ""
 
-def run_in_thread(target_function):
-  t = threading.Thread(target=target_function)
-  t.start()
-  t.join()
 
+def hex_field(s):
+  """ Empty fields are written as '-' in the vector file """
+  return s if len(s) > 0 else "-"
 
-def run_tests():
-  while (tests.empty() == False) or (still_making_input == True):
-    try:
-      inp, out = tests.get(True, 0)
-      retcode = run_test(inp, out)
-      if retcode != 0:
-        failures.append([inp, out])
-        sys.stdout.write("X")
-      else:
-        sys.stdout.write(".")
-      sys.stdout.flush()
-    except Queue.Empty:
-      time.sleep(0.1)
 
+def log_failures(records):
+  """ Keep the failing records in a vector file of their own and log the command that replays it """
+  fd, path = tempfile.mkstemp(prefix="error_vectors_", suffix=".txt", dir=".")
+  with os.fdopen(fd, "w") as f:
+    for record in records:
+      f.write("%s\n" % record)
+  error_log = open("error_log.txt", "a")
+  error_log.write("%s %s%s" % (BIN_PATH, os.path.relpath(path), os.linesep))
+  error_log.close()
 
-def make_test_input():
 
-  # Create input and expected output
+def make_test_input(f):
+  """ Write NTESTS vectors: random input and the digest from Python's hashlib.sha1() """
   for i in range(NTESTS):
     test_input = random_string(NBYTES)
-    #test_input = bytearray(random.getrandbits(8) for _ in xrange(8))
-    sha = hashlib.sha1()
-    sha.update(binascii.a2b_hex(test_input))
-    test_output = sha.hexdigest()
-    tests.put([test_input, test_output])
+    test_output = hashlib.sha1(binascii.a2b_hex(test_input)).hexdigest()
+    f.write("sha1 %s %s\n" % (hex_field(test_input), test_output))
+
 
 #
 # Test driver
@@ -110,40 +77,26 @@ if __name__ == "__main__":
   print("comparing the results to the output of Python's hashlib.sha1().")
   print("")
 
-  # Spawn thread to create test inputs in the background, instead of blocking here...
-  t_mk_input = threading.Thread(target=make_test_input)
-  t_mk_input.start()
- 
-
-  # Create new threads
-  threadlist = list()
-  for i in range(NTHREADS):
-    threadlist.append(threading.Thread(target=run_tests))
-
-  # Run all threads
-  for i, thread in enumerate(threadlist):
-    thread.start()
+  # Write all vectors to one file and check them in a single run of the C program
+  with tempfile.NamedTemporaryFile(mode="w", suffix=".txt", delete=False) as f:
+    make_test_input(f)
+    vector_file = f.name
 
-  # Wait for input-creation to complete
-  t_mk_input.join()
+  try:
+    proc = subprocess.run([BIN_PATH, "-j", str(NTHREADS), vector_file], stdout=subprocess.PIPE, universal_newlines=True)
+  finally:
+    os.remove(vector_file)
 
-  still_making_input = False
+  # "FAIL <record>": the record is a vector line as written above
+  failures = [line[len("FAIL "):] for line in proc.stdout.splitlines() if line.startswith("FAIL ")]
 
-  # Wait for threads to complete
-  for i, thread in enumerate(threadlist):
-    thread.join()
-
-
-  print(" ")
   print(" ")
   print("%d/%d tests succeeded." % (NTESTS - len(failures), NTESTS))
   print(" ")
 
   if len(failures) > 0:
-    error_log = open("error_log.txt", "a")
-    for fail_input, fail_output in failures:
-      error_log.write("./build/test_random2 %s %s %s" % (fail_input, fail_output, os.linesep))
-    error_log.close()
-    
+    log_failures(failures)
 
+  if proc.returncode != 0:
+    sys.exit(1)
 
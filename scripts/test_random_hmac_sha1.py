@@ -4,87 +4,54 @@ from hashlib import sha1
 import hmac
 import os
 import random
-import string
 import subprocess
 import sys
-import time
-import threading
-try:
-    import Queue
-except:
-    import queue as Queue
+import tempfile
 
-BIN_PATH = "./build/test_hmac_sha1"
+BIN_PATH = "./build/test_vectors_sha1"
 
 NTHREADS = 2
 NTESTS = 10
 NBYTES = 20
 
 
-global still_making_input
-still_making_input = True
-tests = Queue.Queue()
-failures = list()
-
-
 #
 # Helper functions
 #
 
 
 def random_string(len):
-  """ Returns a random string of length 'len' consisting of upper + lowercase letters and digits """
-  ret = list()
-  rand = random.Random()
-
-  for i in range(len):
-    ret.append("%.02x" % rand.randint(0, 255))
-
-  return "".join(ret)
-
-  #selector = string.ascii_uppercase + string.ascii_lowercase + string.digits
-  #return ''.join(random.choice(selector) for _ in range(len))
-
-
-def run_test(key, msg, expected_output):
-  """ Run the C test program, comparing the Python HMAC-SHA1 implementation to the one in C """
-  return subprocess.call([BIN_PATH, key, msg, expected_output])
-
-
-def run_in_thread(target_function):
-  t = threading.Thread(target=target_function)
-  t.start()
-  t.join()
-
-
-def run_tests():
-  while (tests.empty() == False) or (still_making_input == True):
-    try:
-      key, msg, out = tests.get(True, 0)
-      retcode = run_test(key, msg, out)
-      if retcode != 0:
-        failures.append([key, msg, out])
-        sys.stdout.write("X")
-      else:
-        sys.stdout.write(".")
-      sys.stdout.flush()
-    except Queue.Empty:
-      time.sleep(0.1) #pass # Ignore exceptions here
+  """ Returns a hex string of 'len' random bytes """
+  return "%0*x" % (2 * len, random.getrandbits(8 * len)) if len > 0 else ""
 
 
+def hex_field(s):
+  """ Empty fields are written as '-' in the vector file """
+  return s if len(s) > 0 else "-"
 
 
 def hmac_sha(key, msg):
   return hmac.new(key, msg, sha1).hexdigest()
 
 
-def make_test_input():
-  # Create input and expected output
+def log_failures(records):
+  """ Keep the failing records in a vector file of their own and log the command that replays it """
+  fd, path = tempfile.mkstemp(prefix="error_vectors_", suffix=".txt", dir=".")
+  with os.fdopen(fd, "w") as f:
+    for record in records:
+      f.write("%s\n" % record)
+  error_log = open("error_log.txt", "a")
+  error_log.write("%s %s%s" % (BIN_PATH, os.path.relpath(path), os.linesep))
+  error_log.close()
+
+
+def make_test_input(f):
+  """ Write NTESTS vectors: random key and msg, and the HMAC from Python's hmac module """
   for i in range(NTESTS):
     test_key = random_string(NBYTES)
     test_msg = random_string(NBYTES)
     test_output = hmac_sha(binascii.a2b_hex(test_key), binascii.a2b_hex(test_msg))
-    tests.put([test_key, test_msg, test_output])
+    f.write("hmac %s %s %s\n" % (hex_field(test_key), hex_field(test_msg), test_output))
 
 
 
@@ -118,36 +85,26 @@ if __name__ == "__main__":
   print("comparing the results to the HMAC calculation using Python's hmac module.")
   print("")
 
-  t_mk_input = threading.Thread(target=make_test_input)
-  t_mk_input.start()
+  # Write all vectors to one file and check them in a single run of the C program
+  with tempfile.NamedTemporaryFile(mode="w", suffix=".txt", delete=False) as f:
+    make_test_input(f)
+    vector_file = f.name
 
-  # Create new threads
-  threadlist = list()
-  for i in range(NTHREADS):
-    threadlist.append(threading.Thread(target=run_tests))
+  try:
+    proc = subprocess.run([BIN_PATH, "-j", str(NTHREADS), vector_file], stdout=subprocess.PIPE, universal_newlines=True)
+  finally:
+    os.remove(vector_file)
 
-  # Run all threads
-  for i, thread in enumerate(threadlist):
-    thread.start()
+  # "FAIL <record>": the record is a vector line as written above
+  failures = [line[len("FAIL "):] for line in proc.stdout.splitlines() if line.startswith("FAIL ")]
 
-  t_mk_input.join()
-  still_making_input = False
-
-  # Wait for threads to complete
-  for i, thread in enumerate(threadlist):
-    thread.join()
-
-
-  print(" ")
   print(" ")
   print("%d/%d tests succeeded." % (NTESTS - len(failures), NTESTS))
   print(" ")
 
   if len(failures) > 0:
-    error_log = open("error_log.txt", "a")
-    for fail_key, fail_msg, fail_output in failures:
-      error_log.write("%s %s %s %s %s" % (BIN_PATH, fail_key, fail_msg, fail_output, os.linesep))
-    error_log.close()
-    
+    log_failures(failures)
 
+  if proc.returncode != 0:
+    sys.exit(1)
 
@@ -0,0 +1,123 @@
+from hashlib import sha1
+import hmac
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+BIN_PATH = "./build/test_vectors_sha1"
+
+KEY = b"Jefe"
+MSGS = [b"", b"abc", b"what do ya want for nothing?", bytes(range(256)) * 5]
+
+
+#
+# Helper functions
+#
+
+
+def run(args):
+  return subprocess.run([BIN_PATH] + args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+
+def check(what, ok):
+  print("  %-60s %s" % (what, "OK" if ok else "FAILED"))
+  return 0 if ok else 1
+
+
+def hex_field(b):
+  """ Empty fields are written as '-' in the vector file """
+  return b.hex() if len(b) > 0 else "-"
+
+
+def text_vectors():
+  lines = ["# sha1 and hmac records"]
+  for msg in MSGS:
+    lines.append("sha1 %s %s" % (hex_field(msg), sha1(msg).hexdigest()))
+    lines.append("hmac %s %s %s" % (hex_field(KEY), hex_field(msg), hmac.new(KEY, msg, sha1).hexdigest()))
+  return ("\n".join(lines) + "\n").encode()
+
+
+def binary_record(key, msg):
+  """ One SHA1VEC record: hmac if a key is given, else sha1 """
+  if key is None:
+    return struct.pack("<BIQ", 0, 0, len(msg)) + msg + sha1(msg).digest()
+  return struct.pack("<BIQ", 1, len(key), len(msg)) + key + msg + hmac.new(key, msg, sha1).digest()
+
+
+def binary_vectors():
+  return b"SHA1VEC\n" + b"".join(binary_record(None, msg) + binary_record(KEY, msg) for msg in MSGS)
+
+
+def write(path, data):
+  with open(path, "wb") as f:
+    f.write(data)
+  return path
+
+
+def malformed(proc, message):
+  """ Rejected with exit status 255 and a message, not a crash """
+  return proc.returncode == 255 and message in proc.stdout and b"FAIL " not in proc.stdout
+
+
+
+#
+# Test driver
+#
+if __name__ == "__main__":
+
+  print("")
+  print("Running %s on text and binary vector files, good and malformed ones." % BIN_PATH)
+  print("")
+
+  tmpdir = tempfile.mkdtemp()
+  failures = 0
+  try:
+    n = 2 * len(MSGS)
+    text = write(os.path.join(tmpdir, "good.txt"), text_vectors())
+    binary = write(os.path.join(tmpdir, "good.bin"), binary_vectors())
+
+    proc = run([text])
+    failures += check("text vectors", proc.returncode == 0 and b"%d/%d vectors passed" % (n, n) in proc.stdout)
+
+    proc = run(["-j", "3", binary])
+    failures += check("binary SHA1VEC vectors", proc.returncode == 0 and b"%d/%d vectors passed" % (n, n) in proc.stdout)
+
+    proc = run([text, binary])
+    failures += check("text and binary files in one run", proc.returncode == 0 and b"%d/%d vectors passed" % (2 * n, 2 * n) in proc.stdout)
+
+    wrong = bytearray(binary_vectors())
+    wrong[-1] ^= 1
+    proc = run([write(os.path.join(tmpdir, "wrong.bin"), bytes(wrong))])
+    failures += check("a wrong digest is reported as FAIL", proc.returncode == 1 and proc.stdout.count(b"FAIL hmac ") == 1)
+
+    for name, line in (("bad hex digit in the message", "sha1 zz %s" % ("00" * 20)),
+                       ("bad hex digit in the key", "hmac 0g 00 %s" % ("00" * 20)),
+                       ("bad hex digit in the digest", "sha1 00 %sxx" % ("00" * 19)),
+                       ("odd number of hex digits", "sha1 0 %s" % ("00" * 20)),
+                       ("short digest", "sha1 00 %s" % ("00" * 19)),
+                       ("missing field", "hmac 00 %s" % ("00" * 20))):
+      proc = run([write(os.path.join(tmpdir, "bad.txt"), ("sha1 - %s\n%s\n" % (sha1(b"").hexdigest(), line)).encode())])
+      failures += check("malformed text line: %s" % name, malformed(proc, b"bad.txt:2: malformed vector"))
+
+    good = binary_vectors()
+    proc = run([write(os.path.join(tmpdir, "short.bin"), good[:-7])])
+    failures += check("truncated binary record", malformed(proc, b"truncated binary record"))
+
+    proc = run([write(os.path.join(tmpdir, "header.bin"), good[:8 + 5])])
+    failures += check("truncated binary record header", malformed(proc, b"malformed binary record"))
+
+    proc = run([write(os.path.join(tmpdir, "huge.bin"), b"SHA1VEC\n" + struct.pack("<BIQ", 0, 0, 1 << 40))])
+    failures += check("binary record longer than a batch", malformed(proc, b"exceeds"))
+
+    proc = run([write(os.path.join(tmpdir, "magic.bin"), b"SHA1VEX\n")])
+    failures += check("bad magic", malformed(proc, b"bad magic"))
+  finally:
+    shutil.rmtree(tmpdir)
+
+  print("")
+
+  if failures != 0:
+    sys.exit(1)
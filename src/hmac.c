@@ -1,45 +1,26 @@
 #include "hmac.h"
-
-/* function doing the HMAC-SHA-1 calculation */
-void hmac_sha1(const uint8_t* key, const uint32_t keysize, const uint8_t* msg, const uint32_t msgsize, uint8_t* output)
-{
-  struct sha1 outer, inner;
-  uint8_t tmp;
-
-  if (keysize > HMAC_SHA1_BLOCK_SIZE) // if len(key) > blocksize(sha1) => key = sha1(key)
-  {
-    uint8_t new_key[HMAC_SHA1_DIGEST_SIZE];
-    sha1_reset(&outer);
-    sha1_input(&outer, key, keysize);
-    sha1_result(&outer, new_key);
-    return hmac_sha1(new_key, HMAC_SHA1_DIGEST_SIZE, msg, msgsize, output);
-  } 
-  sha1_reset(&outer);
-  sha1_reset(&inner);
-
-  uint32_t i;
-  for (i = 0; i < keysize; ++i)
-  {
-    tmp = key[i] ^ 0x5C;
-    sha1_input(&outer, &tmp, 1);
-    tmp = key[i] ^ 0x36;
-    sha1_input(&inner, &tmp, 1);
-  }
-  for (; i < HMAC_SHA1_BLOCK_SIZE; ++i)
-  {
-    tmp = 0x5C;
-    sha1_input(&outer, &tmp, 1);
-    tmp = 0x36;
-    sha1_input(&inner, &tmp, 1);
-  }
-
-  sha1_input(&inner, msg, msgsize);
-  sha1_result(&inner, output);
-
-  sha1_input(&outer, output, HMAC_SHA1_DIGEST_SIZE);
-  sha1_result(&outer, output);
-}
-
-
-
-
+#include "sha1_internal.h"
+
+/* outer hashes are issued in groups of this many tags */
+#define BATCH_GROUP 64
+
+/* HMAC-SHA-1 from the generic HMAC code */
+#define HMAC_NAME         hmac_sha1
+#define HMAC_KEY          struct hmac_sha1_key
+#define HMAC_CTX          struct hmac_sha1_ctx
+#define HASH_CTX          struct sha1
+#define HASH_RESET        sha1_reset
+#define HASH_CLONE        sha1_clone
+#define HASH_INPUT        sha1_input
+#define HASH_INPUTV       sha1_inputv
+#define HASH_RESULT       sha1_result
+#define HASH_MB_HASH      sha1_mb_hash
+#define HASH_DIGEST_BLOCK sha1_digest_block
+#define HASH_WORDS        5
+#define HASH_DIGEST_SIZE  HMAC_SHA1_DIGEST_SIZE
+#define HASH_BLOCK_SIZE   HMAC_SHA1_BLOCK_SIZE
+#ifdef SHA1_STATS
+#define HMAC_CLOCK()            sha1_stats_now()
+#define HMAC_STATS(length, ns)  sha1_stats_hmac(length, ns)
+#endif
+#include "hmac_impl.h"
@@ -7,6 +7,25 @@
 #define HMAC_SHA1_DIGEST_SIZE 20
 #define HMAC_SHA1_BLOCK_SIZE  64
 
+/*
+ * Precomputed key: SHA-1 midstates after absorbing (key ^ ipad) and (key ^ opad).
+ * Set it up once per key with hmac_sha1_key_init() and reuse it for any number of messages.
+ */
+struct hmac_sha1_key
+{
+  uint32_t inner[5];                /* Intermediate_Hash after the ipad block */
+  uint32_t outer[5];                /* Intermediate_Hash after the opad block */
+};
+
+/*
+ * Streaming HMAC state: the running inner hash plus the outer midstate.
+ */
+struct hmac_sha1_ctx
+{
+  struct sha1 inner;                /* SHA-1 over (key ^ ipad) || msg so far */
+  uint32_t    outer[5];             /* Intermediate_Hash after the opad block */
+};
+
 /***********************************************************************'
  * HMAC(K,m)      : HMAC SHA1
  * @param key     : secret key
@@ -15,9 +34,111 @@
  * @param msgsize : msg-length in bytes
  * @param output  : writeable buffer with at least 20 bytes available
  */
-void hmac_sha1(const uint8_t* key, const uint32_t keysize, const uint8_t* msg, const uint32_t msgsize, uint8_t* output);
+void hmac_sha1(const uint8_t* key, const size_t keysize, const uint8_t* msg, const size_t msgsize, uint8_t* output);
 
+/***********************************************************************'
+ * Precompute the inner and outer midstates for a key
+ * @param ctx     : key context to initialize
+ * @param key     : secret key
+ * @param keysize : key-length in bytes
+ */
+void hmac_sha1_key_init(struct hmac_sha1_key* ctx, const uint8_t* key, const size_t keysize);
 
-#endif /* __HMAC_H__ */
+/***********************************************************************'
+ * HMAC(K,m) using a precomputed key, costs two compressions less than hmac_sha1()
+ * @param ctx     : key context set up by hmac_sha1_key_init()
+ * @param msg     : msg to calculate HMAC over
+ * @param msgsize : msg-length in bytes
+ * @param output  : writeable buffer with at least 20 bytes available
+ */
+void hmac_sha1_with_key(const struct hmac_sha1_key* ctx, const uint8_t* msg, const size_t msgsize, uint8_t* output);
+
+/***********************************************************************'
+ * HMAC(K,m) of a message scattered over several buffers, e.g. header,
+ * sequence number and payload, without copying them together
+ * @param ctx     : key context set up by hmac_sha1_key_init()
+ * @param iov     : the buffers, in message order
+ * @param iovcnt  : number of buffers
+ * @param output  : writeable buffer with at least 20 bytes available
+ * @return        : sha Error Code, as returned by sha1_inputv()
+ */
+int hmac_sha1v(const struct hmac_sha1_key* ctx, const struct iovec* iov, int iovcnt, uint8_t* output);
 
+/***********************************************************************'
+ * HMAC(K,m) over n messages under one precomputed key, spread over the
+ * lanes of the multi-buffer SHA-1 kernel (see sha1_multi())
+ * @param ctx     : key context set up by hmac_sha1_key_init()
+ * @param msgs    : pointers to the messages
+ * @param lens    : message lengths in bytes
+ * @param n       : number of messages
+ * @param out     : n tags of 20 bytes
+ */
+void hmac_sha1_batch(const struct hmac_sha1_key* ctx, const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*out)[HMAC_SHA1_DIGEST_SIZE]);
+
+/***********************************************************************'
+ * Streaming HMAC: init, then update any number of times, then final
+ * @param ctx     : streaming context
+ * @param key     : secret key
+ * @param keysize : key-length in bytes
+ */
+void hmac_sha1_init(struct hmac_sha1_ctx* ctx, const uint8_t* key, const size_t keysize);
+
+/***********************************************************************'
+ * Start a streaming HMAC from a precomputed key
+ * @param ctx     : streaming context
+ * @param key     : key context set up by hmac_sha1_key_init()
+ */
+void hmac_sha1_init_key(struct hmac_sha1_ctx* ctx, const struct hmac_sha1_key* key);
+
+/***********************************************************************'
+ * Feed the next chunk of the message
+ * @param ctx     : streaming context
+ * @param msg     : next chunk of the msg
+ * @param msgsize : chunk-length in bytes
+ * @return        : sha Error Code, as returned by sha1_input()
+ */
+int hmac_sha1_update(struct hmac_sha1_ctx* ctx, const uint8_t* msg, const size_t msgsize);
+
+/***********************************************************************'
+ * Feed the next chunk of the message, scattered over several buffers
+ * @param ctx     : streaming context
+ * @param iov     : the buffers, in message order
+ * @param iovcnt  : number of buffers
+ * @return        : sha Error Code, as returned by sha1_inputv()
+ */
+int hmac_sha1_updatev(struct hmac_sha1_ctx* ctx, const struct iovec* iov, int iovcnt);
+
+/***********************************************************************'
+ * Finish the HMAC and write the tag
+ * @param ctx     : streaming context, must be re-initialized before reuse
+ * @param output  : writeable buffer with at least 20 bytes available
+ * @return        : sha Error Code, as returned by sha1_result()
+ */
+int hmac_sha1_final(struct hmac_sha1_ctx* ctx, uint8_t* output);
+
+/***********************************************************************'
+ * Copy a streaming context, e.g. after a common beginning of several
+ * messages, so that each copy can be continued with its own ending
+ * @param dst     : streaming context to overwrite
+ * @param src     : streaming context to copy, not yet finished
+ * @return        : sha Error Code, as returned by sha1_clone()
+ */
+int hmac_sha1_clone(struct hmac_sha1_ctx* dst, const struct hmac_sha1_ctx* src);
+
+/***********************************************************************'
+ * HMAC(K, p || msgs[i]) for n endings of the message p streamed into ctx
+ * so far: p is compressed once, the endings over the lanes of the
+ * multi-buffer SHA-1 kernel (see sha1_multi_from()).  ctx is not changed.
+ * @param ctx     : streaming context holding the common beginning
+ * @param msgs    : pointers to the endings
+ * @param lens    : ending lengths in bytes
+ * @param n       : number of endings
+ * @param out     : n tags of 20 bytes
+ * @return        : sha Error Code
+ */
+int hmac_sha1_batch_from(const struct hmac_sha1_ctx* ctx, const uint8_t* const* msgs, const size_t* lens, size_t n,
+                         uint8_t (*out)[HMAC_SHA1_DIGEST_SIZE]);
+
+
+#endif /* __HMAC_H__ */
 
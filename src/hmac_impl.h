@@ -0,0 +1,303 @@
+/*
+ *  hmac_impl.h
+ *
+ *  Description:
+ *      HMAC (RFC 2104) written once for any hash with 64-octet blocks,
+ *      and instantiated per hash by including this file after defining:
+ *
+ *          HMAC_NAME          function name prefix, e.g. hmac_sha1
+ *          HMAC_KEY / HMAC_CTX   key and streaming context types
+ *          HASH_CTX           hash context type (with Intermediate_Hash
+ *                             and Length fields, as struct sha1)
+ *          HASH_RESET / HASH_CLONE / HASH_INPUT / HASH_INPUTV /
+ *          HASH_RESULT
+ *          HASH_MB_HASH       multi-buffer hash (iv, prefix, head, ...)
+ *          HASH_DIGEST_BLOCK  digest of <= 55 final octets in one padded
+ *                             block (state, prefix, msg, len, digest)
+ *          HASH_WORDS         state words
+ *          HASH_DIGEST_SIZE   digest octets, HASH_BLOCK_SIZE block octets
+ *
+ *      and optionally, to count one-shot MACs:
+ *
+ *          HMAC_CLOCK()       nanosecond clock
+ *          HMAC_STATS(length, ns)  records one call
+ *
+ *      Every call resolves to the hash's own functions at compile time,
+ *      so the generic code costs nothing per call.  All macros are
+ *      undefined again at the end.
+ *
+ */
+
+#define HMAC_CAT2_(a, b)  a##_##b
+#define HMAC_CAT_(a, b)   HMAC_CAT2_(a, b)
+#define HMAC_FN(name)     HMAC_CAT_(HMAC_NAME, name)
+#define HMAC_V2_(a)       a##v
+#define HMAC_V_(a)        HMAC_V2_(a)
+
+#ifndef HMAC_STATS
+#define HMAC_CLOCK()            0
+#define HMAC_STATS(length, ns)  ((void)(length), (void)(ns))
+#endif
+
+/* resume a hash context from a midstate taken after exactly one block */
+static void HMAC_FN(resume)(HASH_CTX* ctx, const uint32_t state[HASH_WORDS])
+{
+  uint32_t i;
+
+  HASH_RESET(ctx);
+  for (i = 0; i < HASH_WORDS; ++i)
+  {
+    ctx->Intermediate_Hash[i] = state[i];
+  }
+  ctx->Length = HASH_BLOCK_SIZE * 8;
+}
+
+/* absorb one pad block and keep the resulting midstate */
+static void HMAC_FN(midstate)(const uint8_t* block, uint32_t state[HASH_WORDS])
+{
+  HASH_CTX ctx;
+  uint32_t i;
+
+  HASH_RESET(&ctx);
+  HASH_INPUT(&ctx, block, HASH_BLOCK_SIZE);
+  for (i = 0; i < HASH_WORDS; ++i)
+  {
+    state[i] = ctx.Intermediate_Hash[i];
+  }
+}
+
+/* function precomputing the ipad/opad midstates of a key */
+void HMAC_FN(key_init)(HMAC_KEY* ctx, const uint8_t* key, const size_t keysize)
+{
+  uint8_t new_key[HASH_DIGEST_SIZE];
+  uint8_t pad[HASH_BLOCK_SIZE];
+  size_t len = keysize;
+  uint32_t i;
+
+  if (keysize > HASH_BLOCK_SIZE) // if len(key) > blocksize(hash) => key = hash(key)
+  {
+    HASH_CTX tmp;
+    HASH_RESET(&tmp);
+    HASH_INPUT(&tmp, key, keysize);
+    HASH_RESULT(&tmp, new_key);
+    key = new_key;
+    len = HASH_DIGEST_SIZE;
+  }
+
+  for (i = 0; i < len; ++i)
+  {
+    pad[i] = key[i] ^ 0x36;
+  }
+  for (; i < HASH_BLOCK_SIZE; ++i)
+  {
+    pad[i] = 0x36;
+  }
+  HMAC_FN(midstate)(pad, ctx->inner);
+
+  for (i = 0; i < HASH_BLOCK_SIZE; ++i)
+  {
+    pad[i] ^= (0x36 ^ 0x5C);
+  }
+  HMAC_FN(midstate)(pad, ctx->outer);
+
+  /* key material may be sensitive, clear it out (not a dead store to the compiler) */
+  sha_clear(pad, sizeof(pad));
+  sha_clear(new_key, sizeof(new_key));
+}
+
+/* functions for the streaming HMAC calculation */
+void HMAC_FN(init_key)(HMAC_CTX* ctx, const HMAC_KEY* key)
+{
+  uint32_t i;
+
+  HMAC_FN(resume)(&ctx->inner, key->inner);
+  for (i = 0; i < HASH_WORDS; ++i)
+  {
+    ctx->outer[i] = key->outer[i];
+  }
+}
+
+void HMAC_FN(init)(HMAC_CTX* ctx, const uint8_t* key, const size_t keysize)
+{
+  HMAC_KEY tmp;
+
+  HMAC_FN(key_init)(&tmp, key, keysize);
+  HMAC_FN(init_key)(ctx, &tmp);
+}
+
+int HMAC_FN(clone)(HMAC_CTX* dst, const HMAC_CTX* src)
+{
+  uint32_t i;
+
+  if ((dst == 0) || (src == 0))
+  {
+    return shaNull;
+  }
+
+  for (i = 0; i < HASH_WORDS; ++i)
+  {
+    dst->outer[i] = src->outer[i];
+  }
+  return HASH_CLONE(&dst->inner, &src->inner);
+}
+
+int HMAC_FN(update)(HMAC_CTX* ctx, const uint8_t* msg, const size_t msgsize)
+{
+  return HASH_INPUT(&ctx->inner, msg, msgsize);
+}
+
+int HMAC_FN(updatev)(HMAC_CTX* ctx, const struct iovec* iov, int iovcnt)
+{
+  return HASH_INPUTV(&ctx->inner, iov, iovcnt);
+}
+
+int HMAC_FN(final)(HMAC_CTX* ctx, uint8_t* output)
+{
+  int err;
+
+  err = HASH_RESULT(&ctx->inner, output);
+  if (err != shaSuccess)
+  {
+    return err;
+  }
+
+  /* the outer hash is the opad block plus the inner digest: one padded block */
+  HASH_DIGEST_BLOCK(ctx->outer, HASH_BLOCK_SIZE, output, HASH_DIGEST_SIZE, output);
+  return shaSuccess;
+}
+
+/* HMAC from precomputed midstates, the common part of HMAC_NAME and with_key */
+static void HMAC_FN(mac)(const HMAC_KEY* ctx, const uint8_t* msg, const size_t msgsize, uint8_t* output)
+{
+  HMAC_CTX stream;
+
+  if (    (msgsize <= HASH_BLOCK_SIZE - 9)
+       && ((msg != 0) || (msgsize == 0)))
+  {
+    /* short messages: inner and outer hash are one padded block each */
+    HASH_DIGEST_BLOCK(ctx->inner, HASH_BLOCK_SIZE, msg, msgsize, output);
+    HASH_DIGEST_BLOCK(ctx->outer, HASH_BLOCK_SIZE, output, HASH_DIGEST_SIZE, output);
+    return;
+  }
+
+  HMAC_FN(init_key)(&stream, ctx);
+  HMAC_FN(update)(&stream, msg, msgsize);
+  HMAC_FN(final)(&stream, output);
+}
+
+/* function doing the HMAC calculation from precomputed midstates */
+void HMAC_FN(with_key)(const HMAC_KEY* ctx, const uint8_t* msg, const size_t msgsize, uint8_t* output)
+{
+  const uint64_t start = HMAC_CLOCK();
+
+  HMAC_FN(mac)(ctx, msg, msgsize, output);
+  HMAC_STATS(msgsize, HMAC_CLOCK() - start);
+}
+
+/* function doing the HMAC calculation over a scattered message from precomputed midstates */
+int HMAC_V_(HMAC_NAME)(const HMAC_KEY* ctx, const struct iovec* iov, int iovcnt, uint8_t* output)
+{
+  HMAC_CTX stream;
+  int err;
+
+  HMAC_FN(init_key)(&stream, ctx);
+  err = HMAC_FN(updatev)(&stream, iov, iovcnt);
+  if (err != shaSuccess)
+  {
+    return err;
+  }
+  return HMAC_FN(final)(&stream, output);
+}
+
+/* outer hashes of n inner digests in out[], replaced in place by the tags */
+static void HMAC_FN(outer_batch)(const uint32_t outer[HASH_WORDS], size_t n, uint8_t (*out)[HASH_DIGEST_SIZE])
+{
+  const uint8_t* tags[BATCH_GROUP];
+  size_t tag_lens[BATCH_GROUP];
+  size_t i, j, m;
+
+  /* each tag is staged before its lane writes back */
+  for (i = 0; i < n; i += m)
+  {
+    m = (n - i < BATCH_GROUP) ? (n - i) : BATCH_GROUP;
+    for (j = 0; j < m; ++j)
+    {
+      tags[j] = out[i + j];
+      tag_lens[j] = HASH_DIGEST_SIZE;
+    }
+    HASH_MB_HASH(outer, HASH_BLOCK_SIZE, 0, 0, tags, tag_lens, m, &out[i]);
+  }
+}
+
+/* function doing the HMAC calculation for many messages under one key */
+void HMAC_FN(batch)(const HMAC_KEY* ctx, const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*out)[HASH_DIGEST_SIZE])
+{
+  /* inner hashes of all messages, continuing from the ipad midstate */
+  HASH_MB_HASH(ctx->inner, HASH_BLOCK_SIZE, 0, 0, msgs, lens, n, out);
+  HMAC_FN(outer_batch)(ctx->outer, n, out);
+}
+
+/* function doing the HMAC calculation for many endings of a message streamed so far */
+int HMAC_FN(batch_from)(const HMAC_CTX* ctx, const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*out)[HASH_DIGEST_SIZE])
+{
+  const HASH_CTX* inner;
+  int err;
+
+  if (ctx == 0)
+  {
+    return shaNull;
+  }
+
+  inner = &ctx->inner;
+  if ((inner->flags & (FLAG_COMPUTED | FLAG_CORRUPTED)) != 0)
+  {
+    return shaStateError;
+  }
+
+  err = sha_mb_check(msgs, lens, n, out);
+  if ((err != shaSuccess) || (n == 0))
+  {
+    return err;
+  }
+
+  /* inner hashes continue from the streamed midstate, its partial block shared by every lane */
+  HASH_MB_HASH(inner->Intermediate_Hash, (inner->Length >> 3) - inner->Message_Block_Index,
+               inner->Message_Block, inner->Message_Block_Index, msgs, lens, n, out);
+  HMAC_FN(outer_batch)(ctx->outer, n, out);
+
+  return shaSuccess;
+}
+
+/* function doing the HMAC calculation */
+void HMAC_NAME(const uint8_t* key, const size_t keysize, const uint8_t* msg, const size_t msgsize, uint8_t* output)
+{
+  const uint64_t start = HMAC_CLOCK();
+  HMAC_KEY ctx;
+
+  HMAC_FN(key_init)(&ctx, key, keysize);
+  HMAC_FN(mac)(&ctx, msg, msgsize, output);
+  HMAC_STATS(msgsize, HMAC_CLOCK() - start);
+}
+
+
+#undef HMAC_CAT2_
+#undef HMAC_CAT_
+#undef HMAC_FN
+#undef HMAC_V2_
+#undef HMAC_V_
+#undef HMAC_CLOCK
+#undef HMAC_STATS
+#undef HMAC_NAME
+#undef HMAC_KEY
+#undef HMAC_CTX
+#undef HASH_CTX
+#undef HASH_RESET
+#undef HASH_CLONE
+#undef HASH_INPUT
+#undef HASH_INPUTV
+#undef HASH_RESULT
+#undef HASH_MB_HASH
+#undef HASH_DIGEST_BLOCK
+#undef HASH_WORDS
+#undef HASH_DIGEST_SIZE
+#undef HASH_BLOCK_SIZE
@@ -0,0 +1,292 @@
+/*
+ *  hmac_sha1.hpp
+ *
+ *  Description:
+ *      Header-only C++20 interface to sha1.h and hmac.h: RAII classes
+ *      for SHA-1 and HMAC-SHA1 that take std::span input and return
+ *      std::array digests.  The classes hold the C contexts by value,
+ *      so construction, copies and moves never allocate.
+ *
+ *      Messages whose length is known at compile time (fixed-extent
+ *      spans, std::array) of at most 55 octets select a template that
+ *      builds the single padded block directly and compresses it once.
+ *      For HMAC the outer hash is always one such block.
+ *
+ *      Link against the C library (sha1*.c, hmac.c).
+ *
+ */
+
+#ifndef _HMAC_SHA1_HPP_
+#define _HMAC_SHA1_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+extern "C" {
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_internal.h"
+}
+
+namespace tiny_hmac {
+
+using Sha1Digest = std::array<std::uint8_t, SHA1HashSize>;
+
+namespace detail {
+
+inline const std::uint32_t sha1_iv[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+/* Longest message that fits one block together with its padding */
+inline constexpr std::size_t one_block_max = 55;
+
+inline std::span<const std::uint8_t> bytes(std::string_view s) noexcept
+{
+  return { reinterpret_cast<const std::uint8_t*>(s.data()), s.size() };
+}
+
+/*
+ * SHA-1 of an N-octet message continuing from 'state', after 'prefix'
+ * octets were absorbed into it: one padded block, one compression
+ * (sha1_digest_block(), which clears the block).  N is checked at
+ * compile time.
+ */
+template <std::size_t N>
+inline Sha1Digest one_block(const std::uint32_t state[5], std::uint64_t prefix, const std::uint8_t* msg) noexcept
+{
+  static_assert(N <= one_block_max, "message does not fit one block");
+
+  Sha1Digest digest;
+
+  sha1_digest_block(state, prefix, msg, N, digest.data());
+  return digest;
+}
+
+} // namespace detail
+
+
+/*
+ * Streaming SHA-1.  finalize() returns the digest and starts over, so an
+ * object can hash any number of messages; copies fork the running state.
+ */
+class Sha1
+{
+public:
+  Sha1() noexcept
+  {
+    sha1_reset(&ctx_);
+  }
+
+  Sha1& update(std::span<const std::uint8_t> data) noexcept
+  {
+    sha1_input(&ctx_, data.data(), data.size());
+    return *this;
+  }
+
+  Sha1& update(std::string_view data) noexcept
+  {
+    return update(detail::bytes(data));
+  }
+
+  Sha1Digest finalize() noexcept
+  {
+    Sha1Digest digest;
+
+    sha1_result(&ctx_, digest.data());
+    sha1_reset(&ctx_);
+    return digest;
+  }
+
+  /* one-shot SHA-1 */
+  static Sha1Digest digest(std::span<const std::uint8_t> data) noexcept
+  {
+    return Sha1().update(data).finalize();
+  }
+
+  static Sha1Digest digest(std::string_view data) noexcept
+  {
+    return digest(detail::bytes(data));
+  }
+
+  /* one-shot SHA-1 of a message of compile-time length */
+  template <std::size_t N>
+    requires (N != std::dynamic_extent)
+  static Sha1Digest digest(std::span<const std::uint8_t, N> data) noexcept
+  {
+    if constexpr (N <= detail::one_block_max)
+    {
+      return detail::one_block<N>(detail::sha1_iv, 0, data.data());
+    }
+    else
+    {
+      return digest(std::span<const std::uint8_t>(data));
+    }
+  }
+
+  template <std::size_t N>
+  static Sha1Digest digest(const std::array<std::uint8_t, N>& data) noexcept
+  {
+    return digest(std::span<const std::uint8_t, N>(data));
+  }
+
+  const struct sha1& native() const noexcept
+  {
+    return ctx_;
+  }
+
+private:
+  struct sha1 ctx_;
+};
+
+
+/*
+ * Precomputed HMAC-SHA1 key (ipad/opad midstates, see hmac_sha1_key_init()),
+ * cleared when destroyed.
+ */
+class HmacSha1Key
+{
+public:
+  explicit HmacSha1Key(std::span<const std::uint8_t> key) noexcept
+  {
+    hmac_sha1_key_init(&key_, key.data(), key.size());
+  }
+
+  explicit HmacSha1Key(std::string_view key) noexcept
+    : HmacSha1Key(detail::bytes(key))
+  {
+  }
+
+  explicit HmacSha1Key(const struct hmac_sha1_key& key) noexcept
+    : key_(key)
+  {
+  }
+
+  HmacSha1Key(const HmacSha1Key&) noexcept = default;
+  HmacSha1Key(HmacSha1Key&&) noexcept = default;
+  HmacSha1Key& operator=(const HmacSha1Key&) noexcept = default;
+  HmacSha1Key& operator=(HmacSha1Key&&) noexcept = default;
+
+  ~HmacSha1Key()
+  {
+    sha_clear(&key_, sizeof(key_));
+  }
+
+  const struct hmac_sha1_key& native() const noexcept
+  {
+    return key_;
+  }
+
+private:
+  struct hmac_sha1_key key_;
+};
+
+
+/*
+ * Streaming HMAC-SHA1 under one key.  finalize() returns the tag and
+ * starts the next message under the same key; copies fork the running
+ * state, e.g. after a header shared by several messages.
+ */
+class HmacSha1
+{
+public:
+  explicit HmacSha1(const HmacSha1Key& key) noexcept
+    : key_(key)
+  {
+    hmac_sha1_init_key(&ctx_, &key_.native());
+  }
+
+  explicit HmacSha1(std::span<const std::uint8_t> key) noexcept
+    : HmacSha1(HmacSha1Key(key))
+  {
+  }
+
+  explicit HmacSha1(std::string_view key) noexcept
+    : HmacSha1(HmacSha1Key(key))
+  {
+  }
+
+  HmacSha1(const HmacSha1&) noexcept = default;
+  HmacSha1(HmacSha1&&) noexcept = default;
+  HmacSha1& operator=(const HmacSha1&) noexcept = default;
+  HmacSha1& operator=(HmacSha1&&) noexcept = default;
+
+  ~HmacSha1()
+  {
+    sha_clear(&ctx_, sizeof(ctx_));
+  }
+
+  HmacSha1& update(std::span<const std::uint8_t> data) noexcept
+  {
+    hmac_sha1_update(&ctx_, data.data(), data.size());
+    return *this;
+  }
+
+  HmacSha1& update(std::string_view data) noexcept
+  {
+    return update(detail::bytes(data));
+  }
+
+  Sha1Digest finalize() noexcept
+  {
+    Sha1Digest tag;
+
+    hmac_sha1_final(&ctx_, tag.data());
+    hmac_sha1_init_key(&ctx_, &key_.native());
+    return tag;
+  }
+
+  /* one-shot HMAC-SHA1 */
+  static Sha1Digest mac(const HmacSha1Key& key, std::span<const std::uint8_t> msg) noexcept
+  {
+    Sha1Digest tag;
+
+    hmac_sha1_with_key(&key.native(), msg.data(), msg.size(), tag.data());
+    return tag;
+  }
+
+  static Sha1Digest mac(const HmacSha1Key& key, std::string_view msg) noexcept
+  {
+    return mac(key, detail::bytes(msg));
+  }
+
+  /* one-shot HMAC-SHA1 of a message of compile-time length: two single-block compressions up to 55 octets */
+  template <std::size_t N>
+    requires (N != std::dynamic_extent)
+  static Sha1Digest mac(const HmacSha1Key& key, std::span<const std::uint8_t, N> msg) noexcept
+  {
+    if constexpr (N <= detail::one_block_max)
+    {
+      Sha1Digest inner = detail::one_block<N>(key.native().inner, HMAC_SHA1_BLOCK_SIZE, msg.data());
+      const Sha1Digest tag = detail::one_block<SHA1HashSize>(key.native().outer, HMAC_SHA1_BLOCK_SIZE, inner.data());
+
+      sha_clear(inner.data(), inner.size());
+      return tag;
+    }
+    else
+    {
+      return mac(key, std::span<const std::uint8_t>(msg));
+    }
+  }
+
+  template <std::size_t N>
+  static Sha1Digest mac(const HmacSha1Key& key, const std::array<std::uint8_t, N>& msg) noexcept
+  {
+    return mac(key, std::span<const std::uint8_t, N>(msg));
+  }
+
+  const struct hmac_sha1_ctx& native() const noexcept
+  {
+    return ctx_;
+  }
+
+private:
+  HmacSha1Key          key_;
+  struct hmac_sha1_ctx ctx_;
+};
+
+} // namespace tiny_hmac
+
+
+#endif /* #ifndef _HMAC_SHA1_HPP_ */
@@ -0,0 +1,22 @@
+#include "hmac_sha256.h"
+#include "sha256_internal.h"
+
+/* outer hashes are issued in groups of this many tags */
+#define BATCH_GROUP 64
+
+/* HMAC-SHA-256 from the generic HMAC code */
+#define HMAC_NAME         hmac_sha256
+#define HMAC_KEY          struct hmac_sha256_key
+#define HMAC_CTX          struct hmac_sha256_ctx
+#define HASH_CTX          struct sha256
+#define HASH_RESET        sha256_reset
+#define HASH_CLONE        sha256_clone
+#define HASH_INPUT        sha256_input
+#define HASH_INPUTV       sha256_inputv
+#define HASH_RESULT       sha256_result
+#define HASH_MB_HASH      sha256_mb_hash
+#define HASH_DIGEST_BLOCK sha256_digest_block
+#define HASH_WORDS        8
+#define HASH_DIGEST_SIZE  HMAC_SHA256_DIGEST_SIZE
+#define HASH_BLOCK_SIZE   HMAC_SHA256_BLOCK_SIZE
+#include "hmac_impl.h"
@@ -0,0 +1,85 @@
+#ifndef __HMAC_SHA256_H__
+#define __HMAC_SHA256_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+#define HMAC_SHA256_DIGEST_SIZE 32
+#define HMAC_SHA256_BLOCK_SIZE  64
+
+/*
+ * HMAC-SHA-256, built from the same generic HMAC code as HMAC-SHA-1 (see
+ * hmac_impl.h): every function below behaves exactly like its hmac_sha1
+ * counterpart in hmac.h, with 32-byte tags.
+ */
+
+/*
+ * Precomputed key: SHA-256 midstates after absorbing (key ^ ipad) and (key ^ opad).
+ */
+struct hmac_sha256_key
+{
+  uint32_t inner[8];                /* Intermediate_Hash after the ipad block */
+  uint32_t outer[8];                /* Intermediate_Hash after the opad block */
+};
+
+/*
+ * Streaming HMAC state: the running inner hash plus the outer midstate.
+ */
+struct hmac_sha256_ctx
+{
+  struct sha256 inner;              /* SHA-256 over (key ^ ipad) || msg so far */
+  uint32_t      outer[8];           /* Intermediate_Hash after the opad block  */
+};
+
+/***********************************************************************'
+ * HMAC(K,m)      : HMAC SHA256
+ * @param key     : secret key
+ * @param keysize : key-length in bytes
+ * @param msg     : msg to calculate HMAC over
+ * @param msgsize : msg-length in bytes
+ * @param output  : writeable buffer with at least 32 bytes available
+ */
+void hmac_sha256(const uint8_t* key, const size_t keysize, const uint8_t* msg, const size_t msgsize, uint8_t* output);
+
+/***********************************************************************'
+ * Precompute the inner and outer midstates for a key
+ */
+void hmac_sha256_key_init(struct hmac_sha256_key* ctx, const uint8_t* key, const size_t keysize);
+
+/***********************************************************************'
+ * HMAC(K,m) using a precomputed key
+ */
+void hmac_sha256_with_key(const struct hmac_sha256_key* ctx, const uint8_t* msg, const size_t msgsize, uint8_t* output);
+
+/***********************************************************************'
+ * HMAC(K,m) of a message scattered over several buffers
+ */
+int hmac_sha256v(const struct hmac_sha256_key* ctx, const struct iovec* iov, int iovcnt, uint8_t* output);
+
+/***********************************************************************'
+ * HMAC(K,m) over n messages under one precomputed key, spread over the
+ * lanes of the multi-buffer SHA-256 kernel (see sha256_multi())
+ */
+void hmac_sha256_batch(const struct hmac_sha256_key* ctx, const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*out)[HMAC_SHA256_DIGEST_SIZE]);
+
+/***********************************************************************'
+ * Streaming HMAC: init (or init_key), then update any number of times,
+ * then final
+ */
+void hmac_sha256_init    (struct hmac_sha256_ctx* ctx, const uint8_t* key, const size_t keysize);
+void hmac_sha256_init_key(struct hmac_sha256_ctx* ctx, const struct hmac_sha256_key* key);
+int  hmac_sha256_update  (struct hmac_sha256_ctx* ctx, const uint8_t* msg, const size_t msgsize);
+int  hmac_sha256_updatev (struct hmac_sha256_ctx* ctx, const struct iovec* iov, int iovcnt);
+int  hmac_sha256_final   (struct hmac_sha256_ctx* ctx, uint8_t* output);
+
+/***********************************************************************'
+ * Copy a streaming context, and finish many endings of the message
+ * streamed into it so far; see hmac_sha1_clone() and hmac_sha1_batch_from()
+ */
+int  hmac_sha256_clone     (struct hmac_sha256_ctx* dst, const struct hmac_sha256_ctx* src);
+int  hmac_sha256_batch_from(const struct hmac_sha256_ctx* ctx, const uint8_t* const* msgs, const size_t* lens, size_t n,
+                            uint8_t (*out)[HMAC_SHA256_DIGEST_SIZE]);
+
+
+#endif /* __HMAC_SHA256_H__ */
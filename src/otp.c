@@ -0,0 +1,234 @@
+/*
+ *  otp.c
+ *
+ *  Description:
+ *      HOTP / TOTP on HMAC-SHA1, see otp.h.
+ *
+ *      Resumed from the key midstates, the inner hash is one block
+ *
+ *          counter[8] || 0x80 || 0 ... || bit length (64 + 8) * 8
+ *
+ *      and the outer hash one block
+ *
+ *          tag[20] || 0x80 || 0 ... || bit length (64 + 20) * 8
+ *
+ *      so only the counter and the tag are written per code.  A single
+ *      code goes through sha1_digest_block() twice; runs of counters are
+ *      computed a kernel's worth of lanes at a time.
+ *
+ */
+
+#include "sha1.h"
+#include "hmac.h"
+#include "otp.h"
+#include "sha1_internal.h"
+
+#define COUNTER_SIZE     8
+
+static const uint32_t _pow10[OTP_MAX_DIGITS + 1] =
+{
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+
+/* RFC 4226 section 5.3: dynamic truncation of the tag */
+static uint32_t _truncate(const uint8_t tag[HMAC_SHA1_DIGEST_SIZE], unsigned digits)
+{
+  unsigned offset = tag[HMAC_SHA1_DIGEST_SIZE - 1] & 0x0F;
+  uint32_t bin = ((uint32_t)(tag[offset] & 0x7F) << 24)
+               | ((uint32_t)tag[offset + 1] << 16)
+               | ((uint32_t)tag[offset + 2] << 8)
+               | ((uint32_t)tag[offset + 3]);
+
+  return bin % _pow10[digits];
+}
+
+/* Code for one counter on the single-stream backend */
+static uint32_t _code_one(const struct hmac_sha1_key* key, uint64_t counter, unsigned digits)
+{
+  uint8_t  be_counter[COUNTER_SIZE];
+  uint8_t  tag[HMAC_SHA1_DIGEST_SIZE];
+  uint32_t code;
+
+  sha_put64(be_counter, counter);
+  sha1_digest_block(key->inner, HMAC_SHA1_BLOCK_SIZE, be_counter, COUNTER_SIZE, tag);
+  sha1_digest_block(key->outer, HMAC_SHA1_BLOCK_SIZE, tag, HMAC_SHA1_DIGEST_SIZE, tag);
+  code = _truncate(tag, digits);
+
+  sha_clear(tag, sizeof(tag));
+  return code;
+}
+
+/* Codes for m <= lanes consecutive counters, one per lane */
+static void _codes_lanes(const struct sha1_mb_kernel* kernel, const struct hmac_sha1_key* key,
+                         uint64_t counter, unsigned m, unsigned digits, uint32_t* codes)
+{
+  const unsigned lanes = kernel->lanes;
+  uint8_t        block[SHA1_MB_MAX_LANES][64];
+  const uint8_t* blocks[SHA1_MB_MAX_LANES];
+  uint32_t       state[5 * SHA1_MB_MAX_LANES];
+  const uint32_t mask = (1u << m) - 1;
+  unsigned l, i;
+
+  for (l = 0; l < lanes; ++l)
+  {
+    blocks[l] = block[(l < m) ? l : 0];
+  }
+
+  for (l = 0; l < m; ++l)
+  {
+    sha_pad_block(block[l], COUNTER_SIZE, HMAC_SHA1_BLOCK_SIZE);
+    sha_put64(block[l], counter + l);
+    for (i = 0; i < 5; ++i)
+    {
+      state[i * lanes + l] = key->inner[i];
+    }
+  }
+  sha_mb_compress(kernel, state, blocks, mask);
+
+  for (l = 0; l < m; ++l)
+  {
+    sha_pad_block(block[l], HMAC_SHA1_DIGEST_SIZE, HMAC_SHA1_BLOCK_SIZE);
+    for (i = 0; i < 5; ++i)
+    {
+      sha_put32(block[l] + 4 * i, state[i * lanes + l]);
+      state[i * lanes + l] = key->outer[i];
+    }
+  }
+  sha_mb_compress(kernel, state, blocks, mask);
+
+  for (l = 0; l < m; ++l)
+  {
+    for (i = 0; i < 5; ++i)
+    {
+      sha_put32(block[l] + 4 * i, state[i * lanes + l]);
+    }
+    codes[l] = _truncate(block[l], digits);
+  }
+
+  /* the blocks hold the tags, clear them out like _code_one() does */
+  sha_clear(block, sizeof(block));
+  sha_clear(state, sizeof(state));
+}
+
+
+uint32_t hotp_sha1(const struct hmac_sha1_key* key, uint64_t counter, unsigned digits)
+{
+  if ((key == 0) || (digits == 0) || (digits > OTP_MAX_DIGITS))
+  {
+    return 0;
+  }
+  return _code_one(key, counter, digits);
+}
+
+int hotp_sha1_codes(const struct hmac_sha1_key* key, uint64_t counter, size_t n, unsigned digits, uint32_t* codes)
+{
+  const struct sha1_mb_kernel* kernel;
+  size_t k;
+  unsigned m;
+
+  if (n == 0)
+  {
+    return shaSuccess;
+  }
+  if ((key == 0) || (codes == 0))
+  {
+    return shaNull;
+  }
+  if ((digits == 0) || (digits > OTP_MAX_DIGITS))
+  {
+    return shaBadParam;
+  }
+
+  if (n == 1)
+  {
+    codes[0] = _code_one(key, counter, digits);
+    return shaSuccess;
+  }
+
+  kernel = sha1_mb_kernel();
+  for (k = 0; k < n; k += m)
+  {
+    m = (n - k < kernel->lanes) ? (unsigned)(n - k) : kernel->lanes;
+    _codes_lanes(kernel, key, counter + k, m, digits, codes + k);
+  }
+
+  return shaSuccess;
+}
+
+/*
+ *  hotp_sha1_verify
+ *
+ *  Description:
+ *      Computes every code in the window a group of lanes at a time and
+ *      compares all of them without branching on the result, so timing
+ *      reveals nothing about which counter matched.
+ *
+ */
+int hotp_sha1_verify(const struct hmac_sha1_key* key, uint64_t counter, unsigned behind, unsigned ahead,
+                     unsigned digits, uint32_t code, uint64_t* matched)
+{
+  uint32_t codes[SHA1_MB_MAX_LANES];
+  uint64_t first, last, c, found_at = 0;
+  uint32_t found = 0, hit;
+  size_t   m, j;
+
+  if ((key == 0) || (digits == 0) || (digits > OTP_MAX_DIGITS))
+  {
+    return 0;
+  }
+
+  first = (counter < behind) ? 0 : (counter - behind);
+  last  = (counter > UINT64_MAX - ahead) ? UINT64_MAX : (counter + ahead);
+
+  for (c = first; ; c += m)
+  {
+    m = (last - c < SHA1_MB_MAX_LANES) ? (size_t)(last - c + 1) : SHA1_MB_MAX_LANES;
+    hotp_sha1_codes(key, c, m, digits, codes);
+
+    for (j = 0; j < m; ++j)
+    {
+      /* only the first hit is recorded, masked rather than branched on */
+      hit = (uint32_t)((codes[j] ^ code) == 0);
+      found_at |= (c + j) & ((uint64_t)0 - (hit & (found ^ 1)));
+      found |= hit;
+    }
+
+    if (last - c < m)
+    {
+      break;
+    }
+  }
+
+  if (found && (matched != 0))
+  {
+    *matched = found_at;
+  }
+  sha_clear(codes, sizeof(codes));
+
+  return (int)found;
+}
+
+static uint64_t _time_step(uint64_t now, uint64_t t0, uint32_t step)
+{
+  return (now < t0) ? 0 : ((now - t0) / step);
+}
+
+uint32_t totp_sha1(const struct hmac_sha1_key* key, uint64_t now, uint64_t t0, uint32_t step, unsigned digits)
+{
+  if (step == 0)
+  {
+    return 0;
+  }
+  return hotp_sha1(key, _time_step(now, t0, step), digits);
+}
+
+int totp_sha1_verify(const struct hmac_sha1_key* key, uint64_t now, uint64_t t0, uint32_t step, unsigned window,
+                     unsigned digits, uint32_t code, uint64_t* matched)
+{
+  if (step == 0)
+  {
+    return 0;
+  }
+  return hotp_sha1_verify(key, _time_step(now, t0, step), window, window, digits, code, matched);
+}
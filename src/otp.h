@@ -0,0 +1,73 @@
+/*
+ *  otp.h
+ *
+ *  Description:
+ *      HMAC-SHA1 one-time passwords: HOTP (RFC 4226) and TOTP
+ *      (RFC 6238).
+ *
+ *      The message is always the 8-octet big-endian counter, so with
+ *      the key midstates from hmac_sha1_key_init() a code is exactly two
+ *      compressions of hard-coded padding blocks.  A window of adjacent
+ *      counters is checked in one go across the lanes of the
+ *      multi-buffer SHA-1 kernel.
+ *
+ */
+
+#ifndef _OTP_H_
+#define _OTP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hmac.h"
+
+#define OTP_MAX_DIGITS 9            /* codes must fit in 31 bits */
+
+/***********************************************************************'
+ * HOTP(K, C) with dynamic truncation to 'digits' decimal digits
+ * @param key     : key context set up by hmac_sha1_key_init() on the secret
+ * @param counter : moving factor C
+ * @param digits  : 1 .. OTP_MAX_DIGITS, usually 6
+ * @return        : the code, 0 .. 10^digits - 1
+ */
+uint32_t hotp_sha1(const struct hmac_sha1_key* key, uint64_t counter, unsigned digits);
+
+/***********************************************************************'
+ * HOTP codes for the n consecutive counters counter .. counter + n - 1
+ * @param codes   : n codes
+ * @return        : sha Error Code: shaNull for missing buffers,
+ *                  shaBadParam for a digit count out of range
+ */
+int hotp_sha1_codes(const struct hmac_sha1_key* key, uint64_t counter, size_t n, unsigned digits, uint32_t* codes);
+
+/***********************************************************************'
+ * Check a code against the counters counter - behind .. counter + ahead.
+ * All counters in the window are computed and compared, the run time
+ * does not depend on where (or whether) the code matches.
+ * @param code    : code to check
+ * @param matched : optional, set to the matching counter (the lowest one
+ *                  if several match)
+ * @return        : 1 if the code matches a counter in the window, else 0
+ */
+int hotp_sha1_verify(const struct hmac_sha1_key* key, uint64_t counter, unsigned behind, unsigned ahead,
+                     unsigned digits, uint32_t code, uint64_t* matched);
+
+/***********************************************************************'
+ * TOTP: HOTP with C = (now - t0) / step
+ * @param now     : current Unix time in seconds
+ * @param t0      : Unix time to start counting steps from, usually 0
+ * @param step    : time step in seconds, usually 30
+ * @return        : the code, 0 if step is 0
+ */
+uint32_t totp_sha1(const struct hmac_sha1_key* key, uint64_t now, uint64_t t0, uint32_t step, unsigned digits);
+
+/***********************************************************************'
+ * Check a TOTP code, accepting up to 'window' time steps of clock drift
+ * either way
+ * @param matched : optional, set to the matching time step counter
+ * @return        : 1 if the code matches, else 0
+ */
+int totp_sha1_verify(const struct hmac_sha1_key* key, uint64_t now, uint64_t t0, uint32_t step, unsigned window,
+                     unsigned digits, uint32_t code, uint64_t* matched);
+
+
+#endif /* #ifndef _OTP_H_ */
@@ -0,0 +1,246 @@
+/*
+ *  pbkdf2.c
+ *
+ *  Description:
+ *      PBKDF2-HMAC-SHA1, see pbkdf2.h.
+ *
+ *      Every output block T_i of every password is an independent chain
+ *
+ *          U_1 = HMAC(P, S || INT(i)),  U_j = HMAC(P, U_(j-1)),
+ *          T_i = U_1 ^ U_2 ^ ... ^ U_c
+ *
+ *      U_1 goes through the streaming HMAC.  From then on the message is
+ *      always 20 octets after a 64-octet pad block, so both the inner and
+ *      the outer hash are a single pre-padded block resumed from the key
+ *      midstate: two compressions per iteration, nothing else.
+ *
+ *      Chains are run a kernel's worth of lanes at a time, all in lock
+ *      step since they share the iteration count.  A lone chain (one
+ *      password, dkLen <= 20) goes through sha1_digest_block() on the
+ *      single-stream backend instead.
+ *
+ */
+
+#include <string.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "pbkdf2.h"
+#include "sha1_internal.h"
+
+/*
+ * One output block of one password
+ */
+struct _chain
+{
+  struct hmac_sha1_key key;
+  uint32_t             t[5];          /* T_i so far                       */
+  uint8_t*             out;           /* where T_i goes                   */
+  size_t               outlen;        /* 20, or less for the last block   */
+};
+
+
+/* U_1 = HMAC(P, S || INT(i)); starts T_i and the block holding U */
+static void _first(struct _chain* c, const uint8_t* salt, size_t saltlen, uint32_t index, uint8_t block[64])
+{
+  struct hmac_sha1_ctx ctx;
+  uint8_t be_index[4];
+  uint32_t i;
+
+  sha_put32(be_index, index);
+  hmac_sha1_init_key(&ctx, &c->key);
+  hmac_sha1_update(&ctx, salt, saltlen);
+  hmac_sha1_update(&ctx, be_index, 4);
+  hmac_sha1_final(&ctx, block);
+  sha_clear(&ctx, sizeof(ctx));
+
+  for (i = 0; i < 5; ++i)
+  {
+    c->t[i] = sha_get32(block + 4 * i);
+  }
+}
+
+/* U_2 .. U_c of a single chain on the single-stream backend, U kept in the block */
+static void _iterate_one(struct _chain* c, uint8_t block[64], uint32_t count)
+{
+  uint32_t i;
+
+  while (count-- > 0)
+  {
+    sha1_digest_block(c->key.inner, HMAC_SHA1_BLOCK_SIZE, block, HMAC_SHA1_DIGEST_SIZE, block);
+    sha1_digest_block(c->key.outer, HMAC_SHA1_BLOCK_SIZE, block, HMAC_SHA1_DIGEST_SIZE, block);
+    for (i = 0; i < 5; ++i)
+    {
+      c->t[i] ^= sha_get32(block + 4 * i);
+    }
+  }
+}
+
+/* U_2 .. U_c of m <= lanes chains in lock step, one chain per lane */
+static void _iterate_lanes(const struct sha1_mb_kernel* kernel, struct _chain* c, unsigned m,
+                           uint8_t (*block)[64], uint32_t count)
+{
+  const unsigned lanes = kernel->lanes;
+  const uint8_t* blocks[SHA1_MB_MAX_LANES];
+  uint32_t       state[5 * SHA1_MB_MAX_LANES];
+  const uint32_t mask = (m >= 32) ? 0xFFFFFFFFu : ((1u << m) - 1);
+  unsigned l, i;
+
+  for (l = 0; l < lanes; ++l)
+  {
+    blocks[l] = block[(l < m) ? l : 0];
+  }
+
+  while (count-- > 0)
+  {
+    for (l = 0; l < m; ++l)
+    {
+      for (i = 0; i < 5; ++i)
+      {
+        state[i * lanes + l] = c[l].key.inner[i];
+      }
+    }
+    sha_mb_compress(kernel, state, blocks, mask);
+
+    for (l = 0; l < m; ++l)
+    {
+      for (i = 0; i < 5; ++i)
+      {
+        sha_put32(block[l] + 4 * i, state[i * lanes + l]);
+        state[i * lanes + l] = c[l].key.outer[i];
+      }
+    }
+    sha_mb_compress(kernel, state, blocks, mask);
+
+    for (l = 0; l < m; ++l)
+    {
+      for (i = 0; i < 5; ++i)
+      {
+        sha_put32(block[l] + 4 * i, state[i * lanes + l]);
+        c[l].t[i] ^= state[i * lanes + l];
+      }
+    }
+  }
+
+  /* the lanes held the last U of every chain */
+  sha_clear(state, sizeof(state));
+}
+
+/* Write T_i out, truncated for the last block, and clear the chain */
+static void _finish(struct _chain* c)
+{
+  uint8_t t[HMAC_SHA1_DIGEST_SIZE];
+  uint32_t i;
+
+  for (i = 0; i < 5; ++i)
+  {
+    sha_put32(t + 4 * i, c->t[i]);
+  }
+  memcpy(c->out, t, c->outlen);
+
+  /* derived key material, clear it out */
+  sha_clear(t, sizeof(t));
+  sha_clear(c, sizeof(*c));
+}
+
+
+/*
+ *  pbkdf2_hmac_sha1_multi
+ *
+ *  Description:
+ *      Derives n keys; chain k is output block (k % nblocks) + 1 of
+ *      password k / nblocks.
+ *
+ */
+int pbkdf2_hmac_sha1_multi(const uint8_t* const* pass, const size_t* passlens, size_t n,
+                           const uint8_t* salt, size_t saltlen,
+                           uint32_t iterations, uint8_t* out, size_t outlen)
+{
+  const struct sha1_mb_kernel* kernel;
+  struct _chain chain[SHA1_MB_MAX_LANES];
+  uint8_t       block[SHA1_MB_MAX_LANES][64];
+  size_t        nblocks, nchains, k, p, b;
+  unsigned      lanes, m, l;
+
+  if ((n == 0) || (outlen == 0))
+  {
+    return shaSuccess;
+  }
+
+  if (    (pass == 0)
+       || (passlens == 0)
+       || (out == 0)
+       || ((salt == 0) && (saltlen != 0)))
+  {
+    return shaNull;
+  }
+
+  for (p = 0; p < n; ++p)
+  {
+    if ((pass[p] == 0) && (passlens[p] != 0))
+    {
+      return shaNull;
+    }
+  }
+
+  /* dkLen > (2^32 - 1) * hLen is an error per RFC 8018 */
+  nblocks = (outlen + HMAC_SHA1_DIGEST_SIZE - 1) / HMAC_SHA1_DIGEST_SIZE;
+  if ((iterations == 0) || ((uint64_t)nblocks > 0xFFFFFFFFu))
+  {
+    return shaBadParam;
+  }
+
+  kernel  = sha1_mb_kernel();
+  lanes   = kernel->lanes;
+  nchains = n * nblocks;
+
+  for (k = 0; k < nchains; k += m)
+  {
+    m = (nchains - k < lanes) ? (unsigned)(nchains - k) : lanes;
+
+    for (l = 0; l < m; ++l)
+    {
+      p = (k + l) / nblocks;
+      b = (k + l) % nblocks;
+
+      /* blocks of the same password share its midstates */
+      if ((l > 0) && (b > 0))
+      {
+        chain[l].key = chain[l - 1].key;
+      }
+      else
+      {
+        hmac_sha1_key_init(&chain[l].key, pass[p], passlens[p]);
+      }
+      chain[l].out    = out + p * outlen + b * HMAC_SHA1_DIGEST_SIZE;
+      chain[l].outlen = (b == nblocks - 1) ? (outlen - b * HMAC_SHA1_DIGEST_SIZE) : HMAC_SHA1_DIGEST_SIZE;
+
+      sha_pad_block(block[l], HMAC_SHA1_DIGEST_SIZE, HMAC_SHA1_BLOCK_SIZE);
+      _first(&chain[l], salt, saltlen, (uint32_t)(b + 1), block[l]);
+    }
+
+    if (m == 1)
+    {
+      _iterate_one(&chain[0], block[0], iterations - 1);
+    }
+    else
+    {
+      _iterate_lanes(kernel, chain, m, block, iterations - 1);
+    }
+
+    for (l = 0; l < m; ++l)
+    {
+      _finish(&chain[l]);
+    }
+  }
+
+  sha_clear(block, sizeof(block));
+
+  return shaSuccess;
+}
+
+int pbkdf2_hmac_sha1(const uint8_t* pass, size_t passlen,
+                     const uint8_t* salt, size_t saltlen,
+                     uint32_t iterations, uint8_t* out, size_t outlen)
+{
+  return pbkdf2_hmac_sha1_multi(&pass, &passlen, 1, salt, saltlen, iterations, out, outlen);
+}
@@ -0,0 +1,52 @@
+/*
+ *  pbkdf2.h
+ *
+ *  Description:
+ *      PBKDF2 key derivation (RFC 8018, section 5.2) with HMAC-SHA1 as
+ *      the pseudorandom function.
+ *
+ *      The ipad/opad midstates of the password are computed once, so
+ *      every iteration costs exactly two single-block compressions
+ *      instead of the four of a plain hmac_sha1() call.  Independent
+ *      output blocks and passwords run side by side in the lanes of the
+ *      multi-buffer SHA-1 kernel.
+ *
+ */
+
+#ifndef _PBKDF2_H_
+#define _PBKDF2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***********************************************************************'
+ * DK = PBKDF2-HMAC-SHA1(P, S, c, dkLen)
+ * @param pass       : password
+ * @param passlen    : password-length in bytes
+ * @param salt       : salt
+ * @param saltlen    : salt-length in bytes
+ * @param iterations : iteration count c, at least 1
+ * @param out        : writeable buffer with at least outlen bytes available
+ * @param outlen     : derived key length dkLen in bytes
+ * @return           : sha Error Code: shaNull for missing buffers, shaBadParam
+ *                     for zero iterations or an oversized dkLen
+ */
+int pbkdf2_hmac_sha1(const uint8_t* pass, size_t passlen,
+                     const uint8_t* salt, size_t saltlen,
+                     uint32_t iterations, uint8_t* out, size_t outlen);
+
+/***********************************************************************'
+ * PBKDF2-HMAC-SHA1 for n passwords sharing salt, iterations and dkLen
+ * (e.g. a word list against one WPA2 SSID), spread over the SIMD lanes
+ * @param pass       : pointers to the passwords
+ * @param passlens   : password lengths in bytes
+ * @param n          : number of passwords
+ * @param out        : n derived keys of outlen bytes each, back to back
+ * @return           : sha Error Code, as for pbkdf2_hmac_sha1()
+ */
+int pbkdf2_hmac_sha1_multi(const uint8_t* const* pass, const size_t* passlens, size_t n,
+                           const uint8_t* salt, size_t saltlen,
+                           uint32_t iterations, uint8_t* out, size_t outlen);
+
+
+#endif /* #ifndef _PBKDF2_H_ */
@@ -22,11 +22,67 @@
  *
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
 #include "sha1.h"
+#include "sha1_internal.h"
+
+#ifdef SHA1_X86
+#include <cpuid.h>
+#endif
 
 /* Local Function Prototyptes */
+static void     _absorb(struct sha1*, const uint8_t* message_array, size_t length);
 static void     _pad_block(struct sha1*);
-static void     _process_block(struct sha1*);
+static void     _process_block(uint32_t Intermediate_Hash[5], const uint8_t* block);
+static void     _compress_scalar(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks);
+static int      _resolve(void);
+
+/*
+ * Block compression backends, fastest first.  The first one whose CPU
+ * features are all present is used, unless the environment variable
+ * SHA1_BACKEND names another supported one (e.g. SHA1_BACKEND=scalar).
+ */
+static const struct
+{
+  const char*      name;
+  sha1_compress_fn compress;
+  unsigned         features;
+} _backends[] =
+{
+#ifdef SHA1_X86
+  { "shani",  sha1_compress_shani, SHA1_CPU_SHANI | SHA1_CPU_SSE41 | SHA1_CPU_SSSE3 },
+  { "avx2",   sha1_compress_avx2,  SHA1_CPU_AVX2 | SHA1_CPU_SSSE3                   },
+  { "ssse3",  sha1_compress_ssse3, SHA1_CPU_SSSE3                                   },
+#endif
+  { "scalar", _compress_scalar,    0                                                },
+};
+
+#define NBACKENDS (sizeof(_backends) / sizeof(*_backends))
+
+/*
+ * Index of the backend in use, -1 until the first compression resolves
+ * it.  Published with release / acquire atomics, as threads may hash for
+ * the first time concurrently.
+ */
+static int _current = -1;
+
+static inline int _backend(void)
+{
+  int i = __atomic_load_n(&_current, __ATOMIC_ACQUIRE);
+
+  return __builtin_expect(i < 0, 0) ? _resolve() : i;
+}
+
+/* All single-stream compressions go through here, so that SHA1_STATS sees every block */
+static inline void _compress_blocks(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks)
+{
+  const int i = _backend();
+
+  _backends[i].compress(Intermediate_Hash, blocks, nblocks);
+  SHA1_STATS_BLOCKS((unsigned)i, nblocks);
+}
 
 /* SHA1 circular left shift */
 static uint32_t _circular_shift(const uint32_t nbits, const uint32_t word)
@@ -56,8 +112,7 @@ int sha1_reset(struct sha1* context)
     return shaNull;
   }
 
-  context->Length_Low           = 0;
-  context->Length_High          = 0;
+  context->Length               = 0;
   context->Message_Block_Index  = 0;
 
   context->Intermediate_Hash[0] = 0x67452301;
@@ -71,6 +126,47 @@ int sha1_reset(struct sha1* context)
   return shaSuccess;
 }
 
+/*
+ * sha1_clone
+ *
+ * Description:
+ *     This function will copy the SHA1-context src, including a partial
+ *     block not yet compressed, into dst.  Both can then be continued
+ *     independently, e.g. with different endings of a message whose
+ *     common beginning was hashed once into src.  Only the buffered
+ *     octets of the message block are copied.
+ *
+ * Parameters:
+ *     dst: [out]
+ *         The context to overwrite.
+ *     src: [in]
+ *         The context to copy.
+ *
+ * Returns:
+ *     sha Error Code.
+ *
+ */
+int sha1_clone(struct sha1* dst, const struct sha1* src)
+{
+  uint32_t i;
+
+  if ((dst == 0) || (src == 0))
+  {
+    return shaNull;
+  }
+
+  for (i = 0; i < 5; ++i)
+  {
+    dst->Intermediate_Hash[i] = src->Intermediate_Hash[i];
+  }
+  memcpy(dst->Message_Block, src->Message_Block, src->Message_Block_Index);
+  dst->Length              = src->Length;
+  dst->Message_Block_Index = src->Message_Block_Index;
+  dst->flags               = src->flags;
+
+  return shaSuccess;
+}
+
 /*
  * sha1_result
  *
@@ -109,13 +205,9 @@ int sha1_result(struct sha1* context, uint8_t Message_Digest[SHA1HashSize])
   {
     _pad_block(context);
 
-    for (i = 0; i < 64; ++i)
-    {
-      /* message may be sensitive, clear it out */
-      context->Message_Block[i] = 0;
-    }
-    context->Length_Low = 0;    /* and clear length */
-    context->Length_High = 0;
+    /* message may be sensitive, clear it out */
+    memset(context->Message_Block, 0, sizeof(context->Message_Block));
+    context->Length = 0;        /* and clear length */
     context->flags |= FLAG_COMPUTED;
   }
 
@@ -127,6 +219,52 @@ int sha1_result(struct sha1* context, uint8_t Message_Digest[SHA1HashSize])
   return shaSuccess;
 }
 
+/*
+ * Add 'length' octets to the message without touching the bit counter:
+ * only octets that complete a partially filled block are copied, whole
+ * blocks are compressed straight from the caller's buffer.
+ */
+static void _absorb(struct sha1* context, const uint8_t* message_array, size_t length)
+{
+  size_t fill;
+
+  /* Top up a partially filled block first */
+  if (context->Message_Block_Index != 0)
+  {
+    fill = 64 - context->Message_Block_Index;
+    if (fill > length)
+    {
+      fill = length;
+    }
+    memcpy(&context->Message_Block[context->Message_Block_Index], message_array, fill);
+    context->Message_Block_Index += (uint16_t)fill;
+    message_array += fill;
+    length -= fill;
+
+    if (context->Message_Block_Index == 64)
+    {
+      _compress_blocks(context->Intermediate_Hash, context->Message_Block, 1);
+      context->Message_Block_Index = 0;
+    }
+  }
+
+  /* Whole blocks are compressed straight from the caller's buffer */
+  if (length >= 64)
+  {
+    _compress_blocks(context->Intermediate_Hash, message_array, length / 64);
+    message_array += length & ~(size_t)63;
+    length &= 63;
+  }
+
+  /* Buffer the tail */
+  if (length != 0)
+  {
+    memcpy(context->Message_Block, message_array, length);
+    context->Message_Block_Index = (uint16_t)length;
+  }
+
+}
+
 /*
  *  sha1_input
  *
@@ -147,8 +285,11 @@ int sha1_result(struct sha1* context, uint8_t Message_Digest[SHA1HashSize])
  *      sha Error Code.
  *
  */
-int sha1_input(struct sha1* context, const uint8_t* message_array, unsigned length)
+int sha1_input(struct sha1* context, const uint8_t* message_array, size_t length)
 {
+  uint64_t room;
+  int      corrupted = 0;
+
   if (length == 0)
   {
     return shaSuccess;
@@ -171,32 +312,119 @@ int sha1_input(struct sha1* context, const uint8_t* message_array, unsigned leng
     return shaStateError;
   }
 
-  while (    (length != 0)
-          && (context->flags == 0))
+  /*
+   * The bit counter is checked once per call instead of once per byte:
+   * only the octets that still fit below 2^64 bits are accepted, the
+   * context is flagged as corrupted once the counter wraps around.
+   */
+  room = (0 - context->Length) >> 3;
+  if (    (room != 0)
+       && (length >= room))
   {
-    context->Message_Block[context->Message_Block_Index] = (*message_array);
+    length = (size_t)room;
+    corrupted = 1;
+  }
+  context->Length += ((uint64_t)length) << 3;
+  SHA1_STATS_INPUT(length);
 
-    context->Message_Block_Index += 1;
-    context->Length_Low += 8;
+  _absorb(context, message_array, length);
 
-    if (context->Length_Low == 0)
-    {
-      context->Length_High += 1;
+  if (corrupted)
+  {
+    /* Message is too long */
+    context->flags |= FLAG_CORRUPTED;
+  }
 
-      if (context->Length_High == 0)
-      {
-        /* Message is too long */
-        context->flags |= FLAG_CORRUPTED;
-      }
-    }
+  return shaSuccess;
+}
 
-    if (context->Message_Block_Index == 64)
+/*
+ *  sha1_inputv
+ *
+ *  Description:
+ *      This function accepts the next portion of the message as a
+ *      list of buffers, hashed as if they had been concatenated.
+ *      Only the octets of a block that straddles two buffers are
+ *      copied; whole blocks inside a buffer are compressed in place.
+ *
+ *  Parameters:
+ *      context: [in/out]
+ *          The SHA context to update
+ *      iov: [in]
+ *          The buffers, in message order.
+ *      iovcnt: [in]
+ *          The number of buffers.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha1_inputv(struct sha1* context, const struct iovec* iov, int iovcnt)
+{
+  uint64_t room;
+  uint64_t total = 0;
+  size_t   length;
+  int      corrupted = 0;
+  int      i;
+
+  if (    (context == 0)
+       || ((iov == 0) && (iovcnt > 0)))
+  {
+    return shaNull;
+  }
+
+  if (iovcnt < 0)
+  {
+    return shaBadParam;
+  }
+
+  for (i = 0; i < iovcnt; ++i)
+  {
+    if ((iov[i].iov_base == 0) && (iov[i].iov_len != 0))
     {
-      _process_block(context);
+      return shaNull;
     }
+    total += iov[i].iov_len;
+  }
+
+  if (total == 0)
+  {
+    return shaSuccess;
+  }
+
+  if ((context->flags & FLAG_COMPUTED) != 0)
+  {
+    context->flags |= FLAG_CORRUPTED;
+    return shaStateError;
+  }
+
+  if ((context->flags & FLAG_CORRUPTED) != 0)
+  {
+    return shaStateError;
+  }
 
-    message_array += 1;
-    length -= 1;
+  /* One bit counter update for all buffers, overflow as in sha1_input() */
+  room = (0 - context->Length) >> 3;
+  if (    (room != 0)
+       && (total >= room))
+  {
+    total = room;
+    corrupted = 1;
+  }
+  context->Length += total << 3;
+  SHA1_STATS_INPUT(total);
+
+  for (i = 0; total != 0; ++i)
+  {
+    length = (iov[i].iov_len < total) ? iov[i].iov_len : (size_t)total;
+    _absorb(context, (const uint8_t*)iov[i].iov_base, length);
+    total -= length;
+  }
+
+  if (corrupted)
+  {
+    /* Message is too long */
+    context->flags |= FLAG_CORRUPTED;
   }
 
   return shaSuccess;
@@ -206,236 +434,202 @@ int sha1_input(struct sha1* context, const uint8_t* message_array, unsigned leng
  *  _process_block
  *
  *  Description:
- *      This function will process the next 512 bits of the message
- *      stored in the Message_Block array.
+ *      This function will process the next 512 bits of the message,
+ *      either from the Message_Block array or directly from the
+ *      caller's buffer.
+ *
+ *      Two compile-time profiles are provided:
+ *
+ *        fast (default)  all 80 rounds unrolled; the five working
+ *                        variables are renamed from round to round
+ *                        instead of being moved (E = D; D = C; ...).
+ *        small           -DSHA1_SMALL: one loop over the 80 rounds,
+ *                        for targets where code size matters most.
+ *
+ *      Both keep only the last 16 words of the message schedule in W,
+ *      computing W[t] for t >= 16 in place as the rounds need it.
  *
  *  Parameters:
- *      None.
+ *      Intermediate_Hash: [in/out]
+ *          The running message digest.
+ *      block: [in]
+ *          64 octets of message to compress.
  *
  *  Returns:
  *      Nothing.
  *
  *  Comments:
-
  *      Many of the variable names in this code, especially the
  *      single character names, were used because those were the
  *      names used in the publication.
  *
- *
  */
-#if 0 // original code
-static void _process_block(struct sha1 *context)
+
+/* Constants defined in SHA-1 */
+#define K0  0x5A827999
+#define K1  0x6ED9EBA1
+#define K2  0x8F1BBCDC
+#define K3  0xCA62C1D6
+
+/* Round functions: Ch for rounds 0..19, Parity for 20..39 and 60..79, Maj for 40..59 */
+#define F_CH(B, C, D)   ((D) ^ ((B) & ((C) ^ (D))))
+#define F_PAR(B, C, D)  ((B) ^ (C) ^ (D))
+#define F_MAJ(B, C, D)  (((B) & (C)) | ((D) & ((B) | (C))))
+
+/* W[t] from the 16-word window holding W[t-16] .. W[t-1] */
+#define SCHEDULE(t)     (W[(t) & 0x0f] = _circular_shift(1, W[((t) + 13) & 0x0f] ^ W[((t) + 8) & 0x0f] ^ W[((t) + 2) & 0x0f] ^ W[(t) & 0x0f]))
+
+#ifndef SHA1_SMALL
+
+/* word t of the schedule, t a constant: the branch folds away */
+#define WORD(t)         (((t) < 16) ? W[(t) & 0x0f] : SCHEDULE(t))
+
+/* one round: the caller rotates the roles of A .. E instead of moving them */
+#define ROUND(A, B, C, D, E, F, K, t)                                     \
+  do {                                                                    \
+    E += _circular_shift(5, A) + F(B, C, D) + (K) + WORD(t);              \
+    B  = _circular_shift(30, B);                                          \
+  } while (0)
+
+/* five rounds, after which every variable is back in its own role */
+#define ROUNDS5(F, K, t)                                                  \
+  do {                                                                    \
+    ROUND(A, B, C, D, E, F, K, (t) + 0);                                  \
+    ROUND(E, A, B, C, D, F, K, (t) + 1);                                  \
+    ROUND(D, E, A, B, C, F, K, (t) + 2);                                  \
+    ROUND(C, D, E, A, B, F, K, (t) + 3);                                  \
+    ROUND(B, C, D, E, A, F, K, (t) + 4);                                  \
+  } while (0)
+
+static void _process_block(uint32_t Intermediate_Hash[5], const uint8_t* block)
 {
-  const uint32_t K[] = /* Constants defined in SHA-1 */
-  {
-    0x5A827999,
-    0x6ED9EBA1,
-    0x8F1BBCDC,
-    0xCA62C1D6
-  };
-  uint32_t t;                 /* Loop counter                */
-  uint32_t temp;              /* Temporary word value        */
-  uint32_t W[80];             /* Word sequence               */
-  uint32_t A, B, C, D, E;     /* Word buffers                */
+  uint32_t W[16];                    /* Word sequence, last 16 words */
+  uint32_t A, B, C, D, E;            /* Word buffers                 */
+  uint32_t t;                        /* Loop counter                 */
 
   /*
-   *  Initialize the first 16 words in the array W
+   * Initialize the first 16 words in the array W
    */
   for (t = 0; t < 16; ++t)
   {
-    W[t]  = context->Message_Block[(t * 4) + 0] << 24;
-    W[t] |= context->Message_Block[(t * 4) + 1] << 16;
-    W[t] |= context->Message_Block[(t * 4) + 2] << 8;
-    W[t] |= context->Message_Block[(t * 4) + 3] << 0;
+    W[t]  = ((uint32_t)block[t * 4 + 0]) << 24;
+    W[t] |= ((uint32_t)block[t * 4 + 1]) << 16;
+    W[t] |= ((uint32_t)block[t * 4 + 2]) << 8;
+    W[t] |= ((uint32_t)block[t * 4 + 3]) << 0;
   }
 
-  for (t = 16; t < 80; ++t)
-  {
-    W[t] = _circular_shift(1, W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16]);
-  }
+  A = Intermediate_Hash[0];
+  B = Intermediate_Hash[1];
+  C = Intermediate_Hash[2];
+  D = Intermediate_Hash[3];
+  E = Intermediate_Hash[4];
+
+  ROUNDS5(F_CH,  K0,  0);  ROUNDS5(F_CH,  K0,  5);  ROUNDS5(F_CH,  K0, 10);  ROUNDS5(F_CH,  K0, 15);
+  ROUNDS5(F_PAR, K1, 20);  ROUNDS5(F_PAR, K1, 25);  ROUNDS5(F_PAR, K1, 30);  ROUNDS5(F_PAR, K1, 35);
+  ROUNDS5(F_MAJ, K2, 40);  ROUNDS5(F_MAJ, K2, 45);  ROUNDS5(F_MAJ, K2, 50);  ROUNDS5(F_MAJ, K2, 55);
+  ROUNDS5(F_PAR, K3, 60);  ROUNDS5(F_PAR, K3, 65);  ROUNDS5(F_PAR, K3, 70);  ROUNDS5(F_PAR, K3, 75);
+
+  Intermediate_Hash[0] += A;
+  Intermediate_Hash[1] += B;
+  Intermediate_Hash[2] += C;
+  Intermediate_Hash[3] += D;
+  Intermediate_Hash[4] += E;
+}
 
-  A = context->Intermediate_Hash[0];
-  B = context->Intermediate_Hash[1];
-  C = context->Intermediate_Hash[2];
-  D = context->Intermediate_Hash[3];
-  E = context->Intermediate_Hash[4];
+#undef WORD
+#undef ROUND
+#undef ROUNDS5
 
-  for (t = 0; t < 20; ++t)
-  {
-    temp =  _circular_shift(5, A) +
-            ((B & C) | ((~B) & D)) + E + W[t] + K[0];
-    E = D;
-    D = C;
-    C = _circular_shift(30, B);
-    B = A;
-    A = temp;
-  }
+#else /* SHA1_SMALL */
 
-  for (; t < 40; ++t)
-  {
-    temp = _circular_shift(5, A) + (B ^ C ^ D) + E + W[t] + K[1];
-    E = D;
-    D = C;
-    C = _circular_shift(30, B);
-    B = A;
-    A = temp;
-  }
+static void _process_block(uint32_t Intermediate_Hash[5], const uint8_t* block)
+{
+  uint32_t W[16];                    /* Word sequence, last 16 words */
+  uint32_t A, B, C, D, E;            /* Word buffers                 */
+  uint32_t temp;                     /* Temporary word value         */
+  uint32_t t;                        /* Loop counter                 */
 
-  for (; t < 60; ++t)
+  /*
+   * Initialize the first 16 words in the array W
+   */
+  for (t = 0; t < 16; ++t)
   {
-    temp = _circular_shift(5, A) +
-           ((B & C) | (B & D) | (C & D)) + E + W[t] + K[2];
-    E = D;
-    D = C;
-    C = _circular_shift(30, B);
-    B = A;
-    A = temp;
+    W[t]  = ((uint32_t)block[t * 4 + 0]) << 24;
+    W[t] |= ((uint32_t)block[t * 4 + 1]) << 16;
+    W[t] |= ((uint32_t)block[t * 4 + 2]) << 8;
+    W[t] |= ((uint32_t)block[t * 4 + 3]) << 0;
   }
 
-  for (; t < 80; ++t)
-  {
-    temp = _circular_shift(5, A) + (B ^ C ^ D) + E + W[t] + K[3];
-    E = D;
-    D = C;
-    C = _circular_shift(30, B);
-    B = A;
-    A = temp;
-  }
+  A = Intermediate_Hash[0];
+  B = Intermediate_Hash[1];
+  C = Intermediate_Hash[2];
+  D = Intermediate_Hash[3];
+  E = Intermediate_Hash[4];
 
-  context->Intermediate_Hash[0] += A;
-  context->Intermediate_Hash[1] += B;
-  context->Intermediate_Hash[2] += C;
-  context->Intermediate_Hash[3] += D;
-  context->Intermediate_Hash[4] += E;
-
-  context->Message_Block_Index = 0;
-}
-
-#else
-
-//#define METHOD2
-  void _process_block(struct sha1 *context)
+  for (t = 0; t < 80; ++t)
   {
-    const uint32_t K[] =             /* Constants defined in SHA-1 */
+    if (t >= 16)
     {
-      0x5A827999,
-      0x6ED9EBA1,
-      0x8F1BBCDC,
-      0xCA62C1D6
-    };
-    uint8_t       t;                 /* Loop counter                */
-    uint32_t      temp;              /* Temporary word value        */
-#ifdef METHOD2
-    uint8_t       s;
-    uint32_t      W[16];
-#else
-    uint32_t      W[80];             /* Word sequence               */
-#endif
-    uint32_t      A, B, C, D, E;     /* Word buffers                */
-
-   /*
-    * Initialize the first 16 words in the array W
-    */
-   for (t = 0; t < 16; ++t)
-   {
-      W[t]  = ((uint32_t)context->Message_Block[t * 4 + 0]) << 24;
-      W[t] |= ((uint32_t)context->Message_Block[t * 4 + 1]) << 16;
-      W[t] |= ((uint32_t)context->Message_Block[t * 4 + 2]) << 8;
-      W[t] |= ((uint32_t)context->Message_Block[t * 4 + 3]) << 0;
+      SCHEDULE(t);
     }
 
-#ifndef METHOD2
-    for (t = 16; t < 80; ++t)
+    if (t < 20)
     {
-      W[t] = _circular_shift(1, (W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16]));
+      temp = F_CH(B, C, D) + K0;
     }
-#endif
-
-    A = context->Intermediate_Hash[0];
-    B = context->Intermediate_Hash[1];
-    C = context->Intermediate_Hash[2];
-    D = context->Intermediate_Hash[3];
-    E = context->Intermediate_Hash[4];
-
-    for (t = 0; t < 20; ++t)
+    else if (t < 40)
     {
-#ifdef METHOD2
-      s = t & 0x0f;
-      if (t >= 16)
-      {
-	W[s] = _circular_shift(1, (W[(s + 13) & 0x0f] ^ W[(s + 8) & 0x0f] ^ W[(s + 2) & 0x0f] ^ W[s]));
-      }
-      temp =  _circular_shift(5, A) + ((B & C) | ((~B) & D)) + E + W[s] + K[0];
-#else
-      temp =  _circular_shift(5, A) + ((B & C) | ((~B) & D)) + E + W[t] + K[0];
-#endif
-      E = D;
-      D = C;
-      C = _circular_shift(30, B);
-      B = A;
-      A = temp;
+      temp = F_PAR(B, C, D) + K1;
     }
-
-    for (t = 20; t < 40; ++t)
+    else if (t < 60)
     {
-#ifdef METHOD2
-      s = (t & 0x0f);
-      W[s] = _circular_shift(1, (W[(s + 13) & 0x0f] ^ W[(s + 8) & 0x0f] ^ W[(s + 2) & 0x0f] ^ W[s]));
-      temp = _circular_shift(5, A) + (B ^ C ^ D) + E + W[s] + K[1];
-#else
-      temp = _circular_shift(5, A) + (B ^ C ^ D) + E + W[t] + K[1];
-#endif
-      E = D;
-      D = C;
-      C = _circular_shift(30, B);
-      B = A;
-      A = temp;
+      temp = F_MAJ(B, C, D) + K2;
     }
-
-    for (t = 40; t < 60; ++t)
+    else
     {
-#ifdef METHOD2
-      s = (t & 0x0f);
-      W[s] = _circular_shift(1, (W[(s + 13) & 0x0f] ^ W[(s + 8) & 0x0f] ^ W[(s + 2) & 0x0f] ^ W[s]));
-      temp = _circular_shift(5, A) + ((B & C) | (B & D) | (C & D)) + E + W[s] + K[2];
-#else
-      temp = _circular_shift(5, A) + ((B & C) | (B & D) | (C & D)) + E + W[t] + K[2];
-#endif
-      E = D;
-      D = C;
-      C = _circular_shift(30, B);
-      B = A;
-      A = temp;
+      temp = F_PAR(B, C, D) + K3;
     }
+    temp += _circular_shift(5, A) + E + W[t & 0x0f];
 
-    for (t = 60; t < 80; ++t)
-    {
-#ifdef METHOD2
-      s = (t & 0x0f);
-      W[s] = _circular_shift(1, (W[(s + 13) & 0x0f] ^ W[(s + 8) & 0x0f] ^ W[(s + 2) & 0x0f] ^ W[s]));
-      temp = _circular_shift(5, A) + (B ^ C ^ D) + E + W[s] + K[3];
-#else
-      temp = _circular_shift(5, A) + (B ^ C ^ D) + E + W[t] + K[3];
-#endif
-      E = D;
-      D = C;
-      C = _circular_shift(30, B);
-      B = A;
-      A = temp;
-    }
+    E = D;
+    D = C;
+    C = _circular_shift(30, B);
+    B = A;
+    A = temp;
+  }
 
-    context->Intermediate_Hash[0] += A;
-    context->Intermediate_Hash[1] += B;
-    context->Intermediate_Hash[2] += C;
-    context->Intermediate_Hash[3] += D;
-    context->Intermediate_Hash[4] += E;
+  Intermediate_Hash[0] += A;
+  Intermediate_Hash[1] += B;
+  Intermediate_Hash[2] += C;
+  Intermediate_Hash[3] += D;
+  Intermediate_Hash[4] += E;
+}
 
-    context->Message_Block_Index = 0;
-  }
+#endif /* SHA1_SMALL */
 
-#endif
+#undef K0
+#undef K1
+#undef K2
+#undef K3
+#undef F_CH
+#undef F_PAR
+#undef F_MAJ
+#undef SCHEDULE
 
 
+/* Store a message length in bits as the big-endian last 8 octets of a block */
+static void _store_length(uint8_t* block, uint64_t bits)
+{
+  block[56] = (uint8_t)(bits >> 56);
+  block[57] = (uint8_t)(bits >> 48);
+  block[58] = (uint8_t)(bits >> 40);
+  block[59] = (uint8_t)(bits >> 32);
+  block[60] = (uint8_t)(bits >> 24);
+  block[61] = (uint8_t)(bits >> 16);
+  block[62] = (uint8_t)(bits >>  8);
+  block[63] = (uint8_t)(bits >>  0);
+}
+
 /*
  *  _pad_block
  *
@@ -460,59 +654,277 @@ static void _process_block(struct sha1 *context)
  */
 static void _pad_block(struct sha1* context)
 {
+  uint16_t index = context->Message_Block_Index;
+
   /*
    * Check to see if the current message block is too small to hold
    * the initial padding bits and length.  If so, we will pad the
    * block, process it, and then continue padding into a second
-   * block.
+   * block.  The zero runs are written with memset, a word at a time.
    */
-  if (context->Message_Block_Index > 55)
+  context->Message_Block[index++] = 0x80;
+  if (index > 56)
   {
-    context->Message_Block[context->Message_Block_Index] = 0x80;
-    context->Message_Block_Index += 1;
+    memset(context->Message_Block + index, 0, 64 - index);
+    _compress_blocks(context->Intermediate_Hash, context->Message_Block, 1);
+    index = 0;
+  }
+  memset(context->Message_Block + index, 0, 56 - index);
 
-    while (context->Message_Block_Index < 64)
+  /*
+   * Store the message length as the last 8 bytes
+   */
+  _store_length(context->Message_Block, context->Length);
+
+  _compress_blocks(context->Intermediate_Hash, context->Message_Block, 1);
+  context->Message_Block_Index = 0;
+}
+
+/*
+ *  sha1_digest_block
+ *
+ *  Description:
+ *      Finishes a message whose remaining 'len' <= 55 octets fit one
+ *      block together with the padding, continuing from 'state' after
+ *      'prefix' octets (a multiple of 64): the padded block is built
+ *      directly, without a context, and compressed once.  msg may be
+ *      0 when len is 0; the block is cleared afterwards.
+ *
+ */
+void sha1_digest_block(const uint32_t state[5], uint64_t prefix, const uint8_t* msg, size_t len, uint8_t digest[SHA1HashSize])
+{
+  uint32_t block[16];               /* padding template, zeroed a word at a time */
+  uint32_t H[5];
+  uint8_t* p = (uint8_t*)block;
+  uint32_t i;
+
+  for (i = 0; i < 16; ++i)
+  {
+    block[i] = 0;
+  }
+  for (i = 0; i < 5; ++i)
+  {
+    H[i] = state[i];
+  }
+
+  if (len != 0)
+  {
+    memcpy(p, msg, len);
+  }
+  p[len] = 0x80;
+  _store_length(p, (prefix + len) << 3);
+
+  _compress_blocks(H, p, 1);
+
+  /* message may be sensitive, clear it out */
+  sha_clear(block, sizeof(block));
+
+  for (i = 0; i < 5; ++i)
+  {
+    digest[4 * i + 0] = (uint8_t)(H[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(H[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(H[i] >>  8);
+    digest[4 * i + 3] = (uint8_t)(H[i] >>  0);
+  }
+}
+
+
+
+/*
+ *  _compress_scalar
+ *
+ *  Description:
+ *      Portable backend: runs _process_block over consecutive blocks.
+ *
+ */
+static void _compress_scalar(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks)
+{
+  while (nblocks != 0)
+  {
+    _process_block(Intermediate_Hash, blocks);
+    blocks  += 64;
+    nblocks -= 1;
+  }
+}
+
+/*
+ *  sha1_compress
+ *
+ *  Description:
+ *      Compresses whole blocks with the backend in use, for the other
+ *      modules of the library.
+ *
+ */
+void sha1_compress(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks)
+{
+  _compress_blocks(Intermediate_Hash, blocks, nblocks);
+}
+
+void sha1_compress_uncounted(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks)
+{
+  _backends[_backend()].compress(Intermediate_Hash, blocks, nblocks);
+}
+
+/*
+ *  sha1_cpu_features
+ *
+ *  Description:
+ *      Reports the SHA1_CPU_* features of the CPU we are running on.
+ *
+ */
+unsigned sha1_cpu_features(void)
+{
+  unsigned features = 0;
+#ifdef SHA1_X86
+  unsigned eax, ebx, ecx, edx;
+
+  unsigned xcr0 = 0;
+
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+  {
+    if (ecx & (1u <<  9)) features |= SHA1_CPU_SSSE3;
+    if (ecx & (1u << 19)) features |= SHA1_CPU_SSE41;
+    if (ecx & (1u << 27))
     {
-      context->Message_Block[context->Message_Block_Index] = 0;
-      context->Message_Block_Index += 1;
+      /* OSXSAVE: ask the OS which register files it saves on context switches */
+      __asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+      xcr0 = eax;
     }
+  }
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+  {
+    if (ebx & (1u << 29)) features |= SHA1_CPU_SHANI;
+    if (((xcr0 & 0x06) == 0x06) && (ebx & (1u <<  5))) features |= SHA1_CPU_AVX2;
+    if (((xcr0 & 0xE6) == 0xE6) && (ebx & (1u << 16))) features |= SHA1_CPU_AVX512;
+  }
+#endif
+  return features;
+}
 
-    _process_block(context);
+/* Index of the backend called 'name', or of the best supported one if name is 0 */
+static int _find_backend(const char* name)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
 
-    while (context->Message_Block_Index < 56)
+  for (i = 0; i < NBACKENDS; ++i)
+  {
+    if (    ((_backends[i].features & features) == _backends[i].features)
+         && (    (name == 0)
+              || (strcmp(name, _backends[i].name) == 0)))
     {
-      context->Message_Block[context->Message_Block_Index] = 0;
-      context->Message_Block_Index += 1;
+      return (int)i;
     }
   }
-  else
+  return -1;
+}
+
+/*
+ *  _resolve
+ *
+ *  Description:
+ *      Picks the backend on first use and publishes its index.
+ *
+ */
+static int _resolve(void)
+{
+  const char* name = getenv("SHA1_BACKEND");
+  int i = -1;
+
+  if (name != 0)
+  {
+    i = _find_backend(name);
+  }
+  if (i < 0)
   {
-    context->Message_Block[context->Message_Block_Index] = 0x80;
-    context->Message_Block_Index += 1;
+    i = _find_backend(0);
+  }
+
+  __atomic_store_n(&_current, i, __ATOMIC_RELEASE);
+  return i;
+}
+
+/*
+ *  sha1_backend
+ *
+ *  Description:
+ *      Name of the block compression backend in use.
+ *
+ */
+const char* sha1_backend(void)
+{
+  return _backends[_backend()].name;
+}
+
+/*
+ *  sha1_backend_at
+ *
+ *  Description:
+ *      Enumerates the backends that are compiled in and supported by
+ *      this CPU, fastest first.  Returns 0 past the last one.
+ *
+ */
+const char* sha1_backend_at(unsigned index)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
 
-    while (context->Message_Block_Index < 56)
+  for (i = 0; i < NBACKENDS; ++i)
+  {
+    if ((_backends[i].features & features) == _backends[i].features)
     {
-      context->Message_Block[context->Message_Block_Index] = 0;
-      context->Message_Block_Index += 1;
+      if (index == 0)
+      {
+        return _backends[i].name;
+      }
+      index -= 1;
     }
   }
+  return 0;
+}
 
-  /*
-   * Store the message length as the last 8 bytes
-   */
-  context->Message_Block[56] = context->Length_High >> 24;
-  context->Message_Block[57] = context->Length_High >> 16;
-  context->Message_Block[58] = context->Length_High >>  8;
-  context->Message_Block[59] = context->Length_High >>  0;
-  context->Message_Block[60] = context->Length_Low  >> 24;
-  context->Message_Block[61] = context->Length_Low  >> 16;
-  context->Message_Block[62] = context->Length_Low  >>  8;
-  context->Message_Block[63] = context->Length_Low  >>  0;
-
-  _process_block(context);
+/*
+ *  sha1_backend_name
+ *
+ *  Description:
+ *      Name of compiled-in backend number 'index', whether or not the
+ *      CPU supports it, for the SHA1_STATS per-backend counters.
+ *      Returns 0 past the last one.
+ *
+ */
+const char* sha1_backend_name(unsigned index)
+{
+  return (index < NBACKENDS) ? _backends[index].name : 0;
 }
 
+/*
+ *  sha1_set_backend
+ *
+ *  Description:
+ *      Forces a backend by name, e.g. "scalar".  Meant for tests and
+ *      benchmarks; do not switch while other threads are hashing.
+ *
+ *  Returns:
+ *      sha Error Code, shaBadParam if the backend is unknown or not
+ *      supported by this CPU.
+ *
+ */
+int sha1_set_backend(const char* name)
+{
+  int i;
 
+  if (name == 0)
+  {
+    return shaNull;
+  }
 
+  i = _find_backend(name);
+  if (i < 0)
+  {
+    return shaBadParam;
+  }
 
+  __atomic_store_n(&_current, i, __ATOMIC_RELEASE);
+  return shaSuccess;
+}
 
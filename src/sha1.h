@@ -17,6 +17,7 @@
 #ifndef _SHA1_H_
 #define _SHA1_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define SHA1HashSize 20
@@ -26,7 +27,8 @@ enum
   shaSuccess = 0,
   shaNull,            /* Null pointer parameter */
   shaInputTooLong,    /* input data too long */
-  shaStateError       /* called Input after Result */
+  shaStateError,      /* called Input after Result */
+  shaBadParam         /* passed a bad parameter */
 };
 
 #define FLAG_COMPUTED   1
@@ -39,8 +41,7 @@ struct sha1
 {
   uint8_t  Message_Block[64];       /* 512-bit message blocks         */
   uint32_t Intermediate_Hash[5];    /* Message Digest                 */
-  uint32_t Length_Low;              /* Message length in bits         */
-  uint32_t Length_High;             /* Message length in bits         */
+  uint64_t Length;                  /* Message length in bits         */
   uint16_t Message_Block_Index;     /* Index into message block array */
   uint8_t  flags;
 };
@@ -50,10 +51,41 @@ struct sha1
 /* 
  * Public API
  */
+struct iovec;                       /* <sys/uio.h> */
+
 int sha1_reset (struct sha1* context);
-int sha1_input (struct sha1* context, const uint8_t* message_array, unsigned length);
+int sha1_clone (struct sha1* dst, const struct sha1* src);
+int sha1_input (struct sha1* context, const uint8_t* message_array, size_t length);
+int sha1_inputv(struct sha1* context, const struct iovec* iov, int iovcnt);
 int sha1_result(struct sha1* context, uint8_t Message_Digest[SHA1HashSize]);
 
+/*
+ * Block compression backend selection.  The fastest backend supported by
+ * the CPU is picked automatically; SHA1_BACKEND=<name> in the environment
+ * overrides it (e.g. SHA1_BACKEND=scalar).
+ */
+const char* sha1_backend    (void);
+const char* sha1_backend_at (unsigned index);
+int         sha1_set_backend(const char* name);
+
+/*
+ * Multi-buffer hashing of n independent messages, one message per SIMD
+ * lane (16 lanes with AVX-512, 8 with AVX2, serial fallback otherwise).
+ * SHA1_MB_BACKEND=<name> in the environment overrides the kernel choice.
+ */
+int         sha1_multi(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*digests)[SHA1HashSize]);
+const char* sha1_mb_backend    (void);
+const char* sha1_mb_backend_at (unsigned index);
+int         sha1_mb_set_backend(const char* name);
+
+/*
+ * Multi-buffer hashing of n messages prefix || msgs[i] that share a
+ * prefix already fed to a context with sha1_input(): the prefix is not
+ * compressed again, only the suffixes are.  The context is not changed.
+ */
+int         sha1_multi_from(const struct sha1* prefix, const uint8_t* const* msgs, const size_t* lens, size_t n,
+                            uint8_t (*digests)[SHA1HashSize]);
+
 
 
 #endif /* #ifndef _SHA1_H_ */
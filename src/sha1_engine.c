@@ -0,0 +1,306 @@
+/*
+ *  sha1_engine.c
+ *
+ *  Description:
+ *      Work-stealing thread pool for batches of SHA-1 / HMAC-SHA1 jobs,
+ *      see sha1_engine.h.
+ *
+ *      Every worker owns a contiguous range [head, tail) of job indices.
+ *      The owner takes small chunks from the head; an idle worker locks
+ *      a victim and takes the upper half of its range from the tail.
+ *      Work is never added, so once every range is empty all jobs have
+ *      been handed out and the workers exit.
+ *
+ *      Each worker's state sits in its own cache line(s) so owners
+ *      updating their heads do not invalidate each other.
+ *
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_engine.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#define CACHE_LINE   64
+#define GRAIN        8                  /* jobs an owner takes at a time */
+
+struct _worker_state
+{
+  pthread_mutex_t  lock;
+  size_t           head;
+  size_t           tail;
+  pthread_t        thread;
+  unsigned         id;
+  int              started;
+  struct _engine*  engine;
+};
+
+union _worker
+{
+  struct _worker_state s;
+  char pad[((sizeof(struct _worker_state) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE];
+};
+
+struct _engine
+{
+  struct sha1_job* jobs;
+  union _worker*   workers;
+  unsigned         nworkers;
+  unsigned         flags;
+};
+
+
+static void _run_job(struct sha1_job* job)
+{
+  struct sha1 ctx;
+
+  if (job->type == sha1JobHmac)
+  {
+    hmac_sha1(job->key, job->keysize, job->msg, job->msgsize, job->output);
+  }
+  else
+  {
+    sha1_reset(&ctx);
+    sha1_input(&ctx, job->msg, job->msgsize);
+    sha1_result(&ctx, job->output);
+  }
+}
+
+/* Take up to GRAIN jobs from the front of our own range */
+static int _take(struct _worker_state* w, size_t* begin, size_t* end)
+{
+  int found = 0;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->head < w->tail)
+  {
+    *begin = w->head;
+    *end   = (w->tail - w->head > GRAIN) ? (w->head + GRAIN) : w->tail;
+    w->head = *end;
+    found = 1;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return found;
+}
+
+/* Move the upper half of a victim's range into our own (empty) range */
+static int _steal(struct _engine* e, struct _worker_state* self)
+{
+  struct _worker_state* v;
+  size_t begin = 0, end = 0;
+  unsigned i;
+
+  for (i = 1; (i < e->nworkers) && (begin == end); ++i)
+  {
+    v = &e->workers[(self->id + i) % e->nworkers].s;
+
+    pthread_mutex_lock(&v->lock);
+    if (v->head < v->tail)
+    {
+      end     = v->tail;
+      v->tail = v->tail - (v->tail - v->head + 1) / 2;
+      begin   = v->tail;
+    }
+    pthread_mutex_unlock(&v->lock);
+  }
+
+  if (begin == end)
+  {
+    return 0;
+  }
+
+  /* Only one lock is ever held at a time; the stolen jobs belong to no range in between */
+  pthread_mutex_lock(&self->lock);
+  self->head = begin;
+  self->tail = end;
+  pthread_mutex_unlock(&self->lock);
+
+  return 1;
+}
+
+#ifdef __linux__
+/*
+ * Pin worker 'id' to the id-th CPU (modulo their number) the process is
+ * allowed to run on, so that cpusets and taskset masks are respected.
+ * Pinning is a hint: if it fails the worker runs unpinned.
+ */
+static void _pin(unsigned id)
+{
+  cpu_set_t allowed, set;
+  unsigned  k;
+  int       cpu, count;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+  {
+    return;
+  }
+  count = CPU_COUNT(&allowed);
+  if (count <= 1)
+  {
+    return;
+  }
+
+  k = id % (unsigned)count;
+  for (cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+  {
+    if (CPU_ISSET(cpu, &allowed))
+    {
+      if (k == 0)
+      {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        return;
+      }
+      k -= 1;
+    }
+  }
+}
+#endif
+
+static void* _worker_main(void* arg)
+{
+  struct _worker_state* w = (struct _worker_state*)arg;
+  struct _engine* e = w->engine;
+  size_t begin, end;
+
+#ifdef __linux__
+  /* the calling thread (worker 0) keeps the affinity it came with */
+  if ((e->flags & SHA1_ENGINE_PIN_CORES) && (w->id != 0))
+  {
+    _pin(w->id);
+  }
+#endif
+
+  for (;;)
+  {
+    while (_take(w, &begin, &end))
+    {
+      for (; begin < end; ++begin)
+      {
+        _run_job(&e->jobs[begin]);
+      }
+    }
+    if (!_steal(e, w))
+    {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ *  sha1_engine_run
+ *
+ *  Description:
+ *      Runs n jobs on a pool of worker threads; the calling thread is
+ *      worker 0.  Workers that fail to start are simply robbed by the
+ *      others, so the call completes even if no thread can be created.
+ *
+ */
+int sha1_engine_run(struct sha1_job* jobs, size_t n, unsigned nthreads, unsigned flags)
+{
+  struct _engine e;
+  size_t per, i;
+  long ncpu;
+  void* mem;
+
+  if (n == 0)
+  {
+    return shaSuccess;
+  }
+
+  if (jobs == 0)
+  {
+    return shaNull;
+  }
+
+  for (i = 0; i < n; ++i)
+  {
+    if (    (jobs[i].output == 0)
+         || ((jobs[i].msg == 0) && (jobs[i].msgsize != 0))
+         || ((jobs[i].type == sha1JobHmac) && (jobs[i].key == 0) && (jobs[i].keysize != 0)))
+    {
+      return shaNull;
+    }
+    if ((jobs[i].type != sha1JobHash) && (jobs[i].type != sha1JobHmac))
+    {
+      return shaBadParam;
+    }
+  }
+
+  if (nthreads == 0)
+  {
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (ncpu > 0) ? (unsigned)ncpu : 1;
+  }
+  if (nthreads > n)
+  {
+    nthreads = (unsigned)n;
+  }
+
+  if (posix_memalign(&mem, CACHE_LINE, nthreads * sizeof(union _worker)) != 0)
+  {
+    /* no memory for the pool, do it here */
+    for (i = 0; i < n; ++i)
+    {
+      _run_job(&jobs[i]);
+    }
+    return shaSuccess;
+  }
+
+  e.jobs     = jobs;
+  e.workers  = (union _worker*)mem;
+  e.nworkers = nthreads;
+  e.flags    = flags;
+
+  /* Even initial split, stealing evens out the rest */
+  per = n / nthreads;
+  for (i = 0; i < nthreads; ++i)
+  {
+    memset(&e.workers[i], 0, sizeof(union _worker));
+    pthread_mutex_init(&e.workers[i].s.lock, 0);
+    e.workers[i].s.head   = i * per;
+    e.workers[i].s.tail   = (i == nthreads - 1) ? n : (i + 1) * per;
+    e.workers[i].s.id     = (unsigned)i;
+    e.workers[i].s.engine = &e;
+  }
+
+  for (i = 1; i < nthreads; ++i)
+  {
+    e.workers[i].s.started = (pthread_create(&e.workers[i].s.thread, 0, _worker_main, &e.workers[i].s) == 0);
+  }
+
+  _worker_main(&e.workers[0].s);
+
+  for (i = 1; i < nthreads; ++i)
+  {
+    if (e.workers[i].s.started)
+    {
+      pthread_join(e.workers[i].s.thread, 0);
+    }
+  }
+
+  for (i = 0; i < nthreads; ++i)
+  {
+    pthread_mutex_destroy(&e.workers[i].s.lock);
+  }
+  free(mem);
+
+  return shaSuccess;
+}
+
@@ -0,0 +1,54 @@
+/*
+ *  sha1_engine.h
+ *
+ *  Description:
+ *      Optional multi-threaded engine for large batches of SHA-1 and
+ *      HMAC-SHA1 jobs.  Jobs are split evenly over worker threads up
+ *      front; a worker that runs out steals half of the remaining jobs
+ *      of another one, so uneven message sizes still keep every core
+ *      busy.
+ *
+ *      Needs POSIX threads (build with -pthread).
+ *
+ */
+
+#ifndef _SHA1_ENGINE_H_
+#define _SHA1_ENGINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum
+{
+  sha1JobHash = 0,      /* output = SHA1(msg)      */
+  sha1JobHmac           /* output = HMAC(key, msg) */
+};
+
+/* pin worker thread i to the i-th allowed CPU, except the caller (Linux only, ignored elsewhere) */
+#define SHA1_ENGINE_PIN_CORES  1
+
+/*
+ * One unit of work
+ */
+struct sha1_job
+{
+  int            type;              /* sha1JobHash or sha1JobHmac     */
+  const uint8_t* key;               /* HMAC key, unused for hashing   */
+  size_t         keysize;
+  const uint8_t* msg;
+  size_t         msgsize;
+  uint8_t*       output;            /* 20 bytes                       */
+};
+
+/*
+ * Run n jobs on 'nthreads' threads (0 = one per online CPU), the calling
+ * thread included.  Returns once all jobs are done.
+ *
+ * Returns sha Error Code: shaNull for missing buffers, shaBadParam for an
+ * unknown job type; no job is run in either case.
+ */
+int sha1_engine_run(struct sha1_job* jobs, size_t n, unsigned nthreads, unsigned flags);
+
+
+#endif /* #ifndef _SHA1_ENGINE_H_ */
+
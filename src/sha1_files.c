@@ -0,0 +1,930 @@
+/*
+ *  sha1_files.c
+ *
+ *  Description:
+ *      Pipelined hashing of many files, see sha1_files.h.
+ *
+ *      The calling thread is the submitter: it opens files, cuts them
+ *      into chunk-sized read requests and hands those to the reader, a
+ *      raw io_uring (no liburing needed) or, as fallback, a few threads
+ *      calling pread().  Every request owns one buffer of the pool, so
+ *      the pool size bounds both the memory and the reads in flight.
+ *
+ *      Reads of one file may complete out of order; finished requests
+ *      park in the file's window of WINDOW slots until every earlier
+ *      chunk has been hashed.  A file with its next chunk ready sits on
+ *      the run queue, and the hashing threads take whole files off it,
+ *      so the chunks of a file are fed to sha1_input() in order by one
+ *      thread at a time while different files hash in parallel.
+ *
+ *      All bookkeeping is under one mutex; it is held only to move a
+ *      request or a file between lists, never while reading or hashing.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_files.h"
+
+#define WINDOW       8              /* reads in flight or parked per file      */
+#define MAX_OPEN     256            /* files open at a time                    */
+#define MAX_BUFFERS  4096           /* bound on reads in flight (ring entries) */
+#define IO_THREADS   8              /* pread() threads of the fallback reader  */
+
+struct _file;
+
+/* One chunk read, owning one buffer of the pool */
+struct _req
+{
+  struct _file* file;
+  uint8_t*      buf;
+  uint64_t      off;
+  uint32_t      len;
+  uint32_t      done;               /* octets read so far, short reads are resumed */
+  uint32_t      seq;                /* chunk number within the file                */
+  struct iovec  iov;
+  struct _req*  next;
+};
+
+struct _file
+{
+  size_t        index;              /* into paths / digests / errors */
+  int           fd;
+  int           error;
+  uint64_t      size;
+  uint64_t      submit_off;         /* next octet to request         */
+  uint32_t      submit_seq;         /* next chunk to request         */
+  uint32_t      hash_seq;           /* next chunk to hash            */
+  unsigned      outstanding;        /* requests not yet released     */
+  int           busy;               /* a hashing thread owns it      */
+  int           queued;             /* on the run queue              */
+  struct _req*  ready[WINDOW];      /* read, waiting for hash_seq    */
+  struct sha1          sha;
+  struct hmac_sha1_ctx hmac;
+  struct _file* next;
+};
+
+struct _uring
+{
+  int                   fd;
+  unsigned*             sq_head;
+  unsigned*             sq_tail;
+  unsigned*             sq_mask;
+  unsigned*             sq_array;
+  unsigned*             cq_head;
+  unsigned*             cq_tail;
+  unsigned*             cq_mask;
+  struct io_uring_sqe*  sqes;
+  struct io_uring_cqe*  cqes;
+  void*                 sq_ptr;
+  void*                 cq_ptr;
+  size_t                sq_size;
+  size_t                cq_size;
+  size_t                sqes_size;
+  unsigned              pending;    /* pushed, not yet passed to io_uring_enter() */
+  unsigned              inflight;   /* passed to the kernel, not yet completed    */
+};
+
+struct _scan
+{
+  const char* const*          paths;
+  size_t                      n;
+  const struct hmac_sha1_key* key;
+  uint8_t                     (*digests)[SHA1HashSize];
+  int*                        errors;
+
+  pthread_mutex_t  lock;
+  pthread_cond_t   work_cv;         /* run queue not empty, or stop   */
+  pthread_cond_t   submit_cv;       /* buffer or file slot released   */
+  pthread_cond_t   io_cv;           /* read queue not empty, or stop  */
+
+  struct _req*     free_reqs;
+  struct _req*     io_head;         /* fallback reader's queue        */
+  struct _req*     io_tail;
+  struct _file*    free_files;
+  struct _file*    run_head;
+  struct _file*    run_tail;
+  struct _file*    active[MAX_OPEN];
+  unsigned         nactive;
+  unsigned         rr;              /* round robin start in active[]  */
+  size_t           next_path;
+  size_t           retired;
+  int              stop;
+};
+
+static const char* _backend = 0;
+
+
+/* BEGIN io_uring */
+
+static int _uring_setup(unsigned entries, struct io_uring_params* p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int _uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, 0, 0);
+}
+
+static void _uring_exit(struct _uring* u)
+{
+  if (u->sqes != 0)
+  {
+    munmap(u->sqes, u->sqes_size);
+  }
+  if ((u->cq_ptr != 0) && (u->cq_ptr != u->sq_ptr))
+  {
+    munmap(u->cq_ptr, u->cq_size);
+  }
+  if (u->sq_ptr != 0)
+  {
+    munmap(u->sq_ptr, u->sq_size);
+  }
+  close(u->fd);
+}
+
+/* Set up a ring for 'entries' requests in flight; returns 0 or -1 */
+static int _uring_init(struct _uring* u, unsigned entries)
+{
+  struct io_uring_params p;
+  void* m;
+
+  memset(u, 0, sizeof(*u));
+  memset(&p, 0, sizeof(p));
+  u->fd = _uring_setup(entries, &p);
+  if (u->fd < 0)
+  {
+    return -1;
+  }
+
+  u->sq_size   = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_size   = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    u->sq_size = u->cq_size = (u->sq_size > u->cq_size) ? u->sq_size : u->cq_size;
+  }
+
+  m = mmap(0, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if (m == MAP_FAILED)
+  {
+    _uring_exit(u);
+    return -1;
+  }
+  u->sq_ptr = m;
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    u->cq_ptr = u->sq_ptr;
+  }
+  else
+  {
+    m = mmap(0, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    if (m == MAP_FAILED)
+    {
+      _uring_exit(u);
+      return -1;
+    }
+    u->cq_ptr = m;
+  }
+
+  m = mmap(0, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if (m == MAP_FAILED)
+  {
+    _uring_exit(u);
+    return -1;
+  }
+  u->sqes = m;
+
+  u->sq_head  = (unsigned*)((char*)u->sq_ptr + p.sq_off.head);
+  u->sq_tail  = (unsigned*)((char*)u->sq_ptr + p.sq_off.tail);
+  u->sq_mask  = (unsigned*)((char*)u->sq_ptr + p.sq_off.ring_mask);
+  u->sq_array = (unsigned*)((char*)u->sq_ptr + p.sq_off.array);
+  u->cq_head  = (unsigned*)((char*)u->cq_ptr + p.cq_off.head);
+  u->cq_tail  = (unsigned*)((char*)u->cq_ptr + p.cq_off.tail);
+  u->cq_mask  = (unsigned*)((char*)u->cq_ptr + p.cq_off.ring_mask);
+  u->cqes     = (struct io_uring_cqe*)((char*)u->cq_ptr + p.cq_off.cqes);
+
+  return 0;
+}
+
+/* Queue the (rest of the) read of r; the ring never holds more than the pool */
+static void _uring_push(struct _uring* u, struct _req* r)
+{
+  unsigned tail = *u->sq_tail;
+  unsigned i = tail & *u->sq_mask;
+  struct io_uring_sqe* sqe = &u->sqes[i];
+
+  r->iov.iov_base = r->buf + r->done;
+  r->iov.iov_len  = r->len - r->done;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode    = IORING_OP_READV;
+  sqe->fd        = r->file->fd;
+  sqe->addr      = (uint64_t)(uintptr_t)&r->iov;
+  sqe->len       = 1;
+  sqe->off       = r->off + r->done;
+  sqe->user_data = (uint64_t)(uintptr_t)r;
+
+  u->sq_array[i] = i;
+  __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  u->pending += 1;
+}
+
+/*
+ * Submit what was pushed, optionally waiting for one completion.  Returns
+ * 0, also when the kernel asks us to reap completions first, or -errno.
+ */
+static int _uring_submit(struct _uring* u, int wait)
+{
+  int rc;
+
+  for (;;)
+  {
+    rc = _uring_enter(u->fd, u->pending, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+    if (rc >= 0)
+    {
+      u->pending  -= (unsigned)rc;
+      u->inflight += (unsigned)rc;
+      return 0;
+    }
+    if ((errno == EAGAIN) || (errno == EBUSY))
+    {
+      return 0;
+    }
+    if (errno != EINTR)
+    {
+      return -errno;
+    }
+  }
+}
+
+/* END io_uring */
+
+
+static void _file_reset(const struct _scan* s, struct _file* f)
+{
+  if (s->key != 0)
+  {
+    hmac_sha1_init_key(&f->hmac, s->key);
+  }
+  else
+  {
+    sha1_reset(&f->sha);
+  }
+}
+
+static void _file_update(const struct _scan* s, struct _file* f, const uint8_t* p, uint32_t n)
+{
+  if (s->key != 0)
+  {
+    hmac_sha1_update(&f->hmac, p, n);
+  }
+  else
+  {
+    sha1_input(&f->sha, p, n);
+  }
+}
+
+static void _file_result(const struct _scan* s, struct _file* f, uint8_t* out)
+{
+  if (s->key != 0)
+  {
+    hmac_sha1_final(&f->hmac, out);
+  }
+  else
+  {
+    sha1_result(&f->sha, out);
+  }
+}
+
+/* Lock held: give a request's buffer back to the pool */
+static void _release(struct _scan* s, struct _req* r)
+{
+  r->file->outstanding -= 1;
+  r->next = s->free_reqs;
+  s->free_reqs = r;
+  pthread_cond_signal(&s->submit_cv);
+}
+
+/* Lock held: report and recycle the file once nothing refers to it any more */
+static void _maybe_retire(struct _scan* s, struct _file* f)
+{
+  unsigned i;
+
+  if (    (f->outstanding != 0)
+       || f->busy
+       || f->queued
+       || ((f->error == 0) && (f->submit_off != f->size)))
+  {
+    return;
+  }
+
+  if (f->fd >= 0)
+  {
+    close(f->fd);
+  }
+  s->errors[f->index] = f->error;
+  if (f->error == 0)
+  {
+    _file_result(s, f, s->digests[f->index]);
+  }
+
+  for (i = 0; i < s->nactive; ++i)
+  {
+    if (s->active[i] == f)
+    {
+      s->active[i] = s->active[--s->nactive];
+      break;
+    }
+  }
+  f->next = s->free_files;
+  s->free_files = f;
+  s->retired += 1;
+  pthread_cond_signal(&s->submit_cv);
+}
+
+/* Lock held: the file failed, drop whatever it has parked */
+static void _fail(struct _scan* s, struct _file* f, int error)
+{
+  unsigned i;
+
+  if (f->error == 0)
+  {
+    f->error = error;
+  }
+  for (i = 0; i < WINDOW; ++i)
+  {
+    if (f->ready[i] != 0)
+    {
+      _release(s, f->ready[i]);
+      f->ready[i] = 0;
+    }
+  }
+  _maybe_retire(s, f);
+}
+
+/* Lock held: a read finished with 'res' = its length or -errno */
+static void _complete(struct _scan* s, struct _req* r, int res)
+{
+  struct _file* f = r->file;
+
+  if ((res < 0) || (f->error != 0))
+  {
+    _release(s, r);
+    _fail(s, f, (res < 0) ? -res : f->error);
+    return;
+  }
+
+  f->ready[r->seq % WINDOW] = r;
+  if ((r->seq == f->hash_seq) && !f->busy && !f->queued)
+  {
+    f->queued = 1;
+    f->next = 0;
+    if (s->run_tail != 0)
+    {
+      s->run_tail->next = f;
+    }
+    else
+    {
+      s->run_head = f;
+    }
+    s->run_tail = f;
+    pthread_cond_signal(&s->work_cv);
+  }
+}
+
+/* Hashing thread: take a file with its next chunk ready, hash all chunks that are in order */
+static void* _hash_main(void* arg)
+{
+  struct _scan* s = (struct _scan*)arg;
+  struct _file* f;
+  struct _req*  r;
+
+  pthread_mutex_lock(&s->lock);
+  for (;;)
+  {
+    while ((s->run_head == 0) && !s->stop)
+    {
+      pthread_cond_wait(&s->work_cv, &s->lock);
+    }
+    if (s->run_head == 0)
+    {
+      break;
+    }
+
+    f = s->run_head;
+    s->run_head = f->next;
+    if (s->run_head == 0)
+    {
+      s->run_tail = 0;
+    }
+    f->queued = 0;
+    f->busy = 1;
+
+    while (    (f->error == 0)
+            && ((r = f->ready[f->hash_seq % WINDOW]) != 0))
+    {
+      f->ready[f->hash_seq % WINDOW] = 0;
+      f->hash_seq += 1;
+      pthread_mutex_unlock(&s->lock);
+
+      _file_update(s, f, r->buf, r->len);
+
+      pthread_mutex_lock(&s->lock);
+      _release(s, r);
+    }
+
+    f->busy = 0;
+    _maybe_retire(s, f);
+  }
+  pthread_mutex_unlock(&s->lock);
+
+  return 0;
+}
+
+/* Read all of a request with pread(); returns its length or -errno */
+static int _read_full(struct _req* r)
+{
+  ssize_t n;
+
+  while (r->done < r->len)
+  {
+    n = pread(r->file->fd, r->buf + r->done, r->len - r->done, (off_t)(r->off + r->done));
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -errno;
+    }
+    if (n == 0)
+    {
+      return -EIO;                  /* the file shrank */
+    }
+    r->done += (uint32_t)n;
+  }
+  return (int)r->len;
+}
+
+/* Fallback reader thread */
+static void* _io_main(void* arg)
+{
+  struct _scan* s = (struct _scan*)arg;
+  struct _req*  r;
+  int res;
+
+  pthread_mutex_lock(&s->lock);
+  for (;;)
+  {
+    while ((s->io_head == 0) && !s->stop)
+    {
+      pthread_cond_wait(&s->io_cv, &s->lock);
+    }
+    if (s->io_head == 0)
+    {
+      break;
+    }
+
+    r = s->io_head;
+    s->io_head = r->next;
+    if (s->io_head == 0)
+    {
+      s->io_tail = 0;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    res = _read_full(r);
+
+    pthread_mutex_lock(&s->lock);
+    _complete(s, r, res);
+  }
+  pthread_mutex_unlock(&s->lock);
+
+  return 0;
+}
+
+/* Open files while there are free slots, outside the lock except for the lists */
+static void _open_more(struct _scan* s)
+{
+  struct stat st;
+  struct _file* f;
+  size_t i;
+  int fd, error;
+
+  pthread_mutex_lock(&s->lock);
+  while ((s->next_path < s->n) && (s->free_files != 0))
+  {
+    f = s->free_files;
+    s->free_files = f->next;
+    i = s->next_path++;
+    pthread_mutex_unlock(&s->lock);
+
+    error = 0;
+    fd = open(s->paths[i], O_RDONLY | O_CLOEXEC);
+    if ((fd < 0) || (fstat(fd, &st) != 0))
+    {
+      error = errno;
+    }
+    else if (!S_ISREG(st.st_mode))
+    {
+      error = EINVAL;
+    }
+    else
+    {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    memset(f, 0, sizeof(*f));
+    f->index = i;
+    f->fd    = fd;
+    f->error = error;
+    f->size  = (error == 0) ? (uint64_t)st.st_size : 0;
+    _file_reset(s, f);
+
+    pthread_mutex_lock(&s->lock);
+    s->active[s->nactive++] = f;
+    _maybe_retire(s, f);            /* failed to open, or empty */
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
+/* Lock held: cut requests for the open files, round robin, while buffers last */
+static struct _req* _issue(struct _scan* s, unsigned* count)
+{
+  struct _req *list = 0, **tail = &list;
+  struct _file* f;
+  struct _req* r;
+  uint64_t left;
+  unsigned k;
+
+  *count = 0;
+  for (k = 0; (k < s->nactive) && (s->free_reqs != 0); ++k)
+  {
+    f = s->active[(s->rr + k) % s->nactive];
+    while (    (s->free_reqs != 0)
+            && (f->error == 0)
+            && (f->submit_off < f->size)
+            && (f->submit_seq - f->hash_seq < WINDOW))
+    {
+      r = s->free_reqs;
+      s->free_reqs = r->next;
+
+      left = f->size - f->submit_off;
+      r->file = f;
+      r->off  = f->submit_off;
+      r->len  = (left < SHA1_FILES_CHUNK) ? (uint32_t)left : SHA1_FILES_CHUNK;
+      r->done = 0;
+      r->seq  = f->submit_seq++;
+      f->submit_off += r->len;
+      f->outstanding += 1;
+
+      r->next = 0;
+      *tail = r;
+      tail = &r->next;
+      *count += 1;
+    }
+  }
+  s->rr += 1;
+
+  return list;
+}
+
+/* Lock held: reap io_uring completions, resuming short reads */
+static void _reap(struct _scan* s, struct _uring* u)
+{
+  unsigned head = *u->cq_head;
+  struct io_uring_cqe* cqe;
+  struct _req* r;
+  int res;
+
+  while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+  {
+    cqe = &u->cqes[head & *u->cq_mask];
+    r = (struct _req*)(uintptr_t)cqe->user_data;
+    res = cqe->res;
+    head += 1;
+    u->inflight -= 1;
+
+    if (res > 0)
+    {
+      r->done += (uint32_t)res;
+      if (r->done < r->len)
+      {
+        _uring_push(u, r);
+        continue;
+      }
+      res = (int)r->len;
+    }
+    else if (res == 0)
+    {
+      res = -EIO;                   /* the file shrank */
+    }
+    _complete(s, r, res);
+  }
+  __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Submitter loop.  Returns 0, or -errno if io_uring failed for good;
+ * then requests may still be in the kernel's hands and their buffers
+ * must not be freed.
+ */
+static int _submit_main(struct _scan* s, struct _uring* u)
+{
+  struct _req *list, *r;
+  unsigned count;
+  int rc;
+
+  for (;;)
+  {
+    _open_more(s);
+
+    pthread_mutex_lock(&s->lock);
+    if (s->retired == s->n)
+    {
+      pthread_mutex_unlock(&s->lock);
+      return 0;
+    }
+
+    list = _issue(s, &count);
+    if (    (count == 0)
+         && ((u == 0) || ((u->inflight + u->pending) == 0))
+         && ((s->next_path == s->n) || (s->free_files == 0)))
+    {
+      /* everything is with the readers or the hashing threads */
+      pthread_cond_wait(&s->submit_cv, &s->lock);
+      pthread_mutex_unlock(&s->lock);
+      continue;
+    }
+
+    if (u == 0)
+    {
+      if (list != 0)
+      {
+        for (r = list; r->next != 0; r = r->next)
+        {
+        }
+        if (s->io_tail != 0)
+        {
+          s->io_tail->next = list;
+        }
+        else
+        {
+          s->io_head = list;
+        }
+        s->io_tail = r;
+        pthread_cond_broadcast(&s->io_cv);
+      }
+      pthread_mutex_unlock(&s->lock);
+      continue;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    for (r = list; r != 0; r = r->next)
+    {
+      _uring_push(u, r);
+    }
+    rc = _uring_submit(u, (count == 0) && (u->pending == 0) && (u->inflight != 0));
+    if (rc < 0)
+    {
+      return rc;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    _reap(s, u);
+    pthread_mutex_unlock(&s->lock);
+  }
+}
+
+
+/*
+ *  sha1_files_backend
+ *
+ *  Description:
+ *      Reader picked on first use: io_uring if the kernel lets us set up
+ *      a ring, else threads.  SHA1_IO_BACKEND=io_uring|threads in the
+ *      environment overrides the choice.
+ *
+ */
+const char* sha1_files_backend(void)
+{
+  struct io_uring_params p;
+  const char* backend = __atomic_load_n(&_backend, __ATOMIC_ACQUIRE);
+  const char* name;
+  int fd;
+
+  if (backend == 0)
+  {
+    /* threads racing here probe the same kernel and agree */
+    name = getenv("SHA1_IO_BACKEND");
+    if ((name != 0) && (strcmp(name, "threads") == 0))
+    {
+      backend = "threads";
+    }
+    else
+    {
+      memset(&p, 0, sizeof(p));
+      fd = _uring_setup(1, &p);
+      backend = (fd >= 0) ? "io_uring" : "threads";
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+    }
+    __atomic_store_n(&_backend, backend, __ATOMIC_RELEASE);
+  }
+  return backend;
+}
+
+
+/*
+ *  sha1_files_hash
+ *
+ *  Description:
+ *      Digests of n files, see sha1_files.h.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha1_files_hash(const char* const* paths, size_t n, const struct hmac_sha1_key* key,
+                    uint8_t (*digests)[SHA1HashSize], int* errors,
+                    unsigned nthreads, size_t membytes)
+{
+  struct _scan   s;
+  struct _uring  ring;
+  struct _uring* u = 0;
+  struct _req*   reqs;
+  struct _file*  files;
+  pthread_t      threads[256 + IO_THREADS];
+  unsigned       nbuf, nopen, nhash, nio, started, i;
+  uint8_t*       pool;
+  size_t         j;
+  long           ncpu;
+  int            rc;
+
+  if (n == 0)
+  {
+    return shaSuccess;
+  }
+
+  if (    (paths == 0)
+       || (digests == 0)
+       || (errors == 0))
+  {
+    return shaNull;
+  }
+  for (j = 0; j < n; ++j)
+  {
+    if (paths[j] == 0)
+    {
+      return shaNull;
+    }
+  }
+
+  if (membytes == 0)
+  {
+    membytes = SHA1_FILES_MEMORY;
+  }
+  nbuf = (membytes / SHA1_FILES_CHUNK < MAX_BUFFERS) ? (unsigned)(membytes / SHA1_FILES_CHUNK) : MAX_BUFFERS;
+  if (nbuf == 0)
+  {
+    nbuf = 1;
+  }
+  nopen = (2 * nbuf < MAX_OPEN) ? 2 * nbuf : MAX_OPEN;
+
+  if (nthreads == 0)
+  {
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (ncpu > 0) ? (unsigned)ncpu : 1;
+  }
+  nhash = (nthreads < 256) ? nthreads : 256;
+
+  if (posix_memalign((void**)&pool, 4096, (size_t)nbuf * SHA1_FILES_CHUNK) != 0)
+  {
+    return shaBadParam;
+  }
+  reqs  = calloc(nbuf, sizeof(*reqs));
+  files = calloc(nopen, sizeof(*files));
+  if ((reqs == 0) || (files == 0))
+  {
+    free(reqs);
+    free(files);
+    free(pool);
+    return shaBadParam;
+  }
+
+  memset(&s, 0, sizeof(s));
+  s.paths   = paths;
+  s.n       = n;
+  s.key     = key;
+  s.digests = digests;
+  s.errors  = errors;
+  pthread_mutex_init(&s.lock, 0);
+  pthread_cond_init(&s.work_cv, 0);
+  pthread_cond_init(&s.submit_cv, 0);
+  pthread_cond_init(&s.io_cv, 0);
+
+  for (i = 0; i < nbuf; ++i)
+  {
+    reqs[i].buf  = pool + (size_t)i * SHA1_FILES_CHUNK;
+    reqs[i].next = s.free_reqs;
+    s.free_reqs  = &reqs[i];
+  }
+  for (i = 0; i < nopen; ++i)
+  {
+    files[i].next = s.free_files;
+    s.free_files  = &files[i];
+  }
+
+  if (    (strcmp(sha1_files_backend(), "io_uring") == 0)
+       && (_uring_init(&ring, nbuf) == 0))
+  {
+    u = &ring;
+  }
+  nio = (u == 0) ? IO_THREADS : 0;
+
+  /* at least one hashing thread, and all readers unless io_uring does the reading */
+  started = 0;
+  for (i = 0; i < nhash; ++i)
+  {
+    started += (pthread_create(&threads[started], 0, _hash_main, &s) == 0);
+  }
+  rc = (started != 0) ? 0 : -EAGAIN;
+  for (i = 0; (i < nio) && (rc == 0); ++i)
+  {
+    if (pthread_create(&threads[started], 0, _io_main, &s) == 0)
+    {
+      started += 1;
+    }
+    else
+    {
+      rc = -EAGAIN;
+    }
+  }
+
+  if (rc == 0)
+  {
+    rc = _submit_main(&s, u);
+  }
+
+  pthread_mutex_lock(&s.lock);
+  s.stop = 1;
+  pthread_cond_broadcast(&s.work_cv);
+  pthread_cond_broadcast(&s.io_cv);
+  pthread_mutex_unlock(&s.lock);
+  for (i = 0; i < started; ++i)
+  {
+    pthread_join(threads[i], 0);
+  }
+
+  if (rc < 0)
+  {
+    /* the files still open, and those never opened, fail with the reader's error */
+    for (i = 0; i < s.nactive; ++i)
+    {
+      errors[s.active[i]->index] = -rc;
+      if (s.active[i]->fd >= 0)
+      {
+        close(s.active[i]->fd);
+      }
+    }
+    for (j = s.next_path; j < n; ++j)
+    {
+      errors[j] = -rc;
+    }
+  }
+
+  if (u != 0)
+  {
+    _uring_exit(u);
+  }
+  if ((u == 0) || (u->inflight == 0))
+  {
+    free(pool);
+  }
+  pthread_cond_destroy(&s.io_cv);
+  pthread_cond_destroy(&s.submit_cv);
+  pthread_cond_destroy(&s.work_cv);
+  pthread_mutex_destroy(&s.lock);
+  free(files);
+  free(reqs);
+
+  return shaSuccess;
+}
@@ -0,0 +1,54 @@
+/*
+ *  sha1_files.h
+ *
+ *  Description:
+ *      Pipelined SHA-1 / HMAC-SHA1 of many files: reads are queued in
+ *      batches through io_uring (or a pool of reader threads where
+ *      io_uring is not available) while worker threads hash the buffers
+ *      that have arrived, so disk and CPU stay busy at the same time.
+ *
+ *      Buffer memory is bounded: files are read in fixed-size chunks from
+ *      a pool of at most 'membytes' octets, and a chunk returns to the
+ *      pool as soon as it has been hashed.
+ *
+ *      Linux only; needs POSIX threads (build with -pthread).
+ *
+ */
+
+#ifndef _SHA1_FILES_H_
+#define _SHA1_FILES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha1.h"
+#include "hmac.h"
+
+#define SHA1_FILES_CHUNK    (256u << 10)    /* octets per read                       */
+#define SHA1_FILES_MEMORY   (32u << 20)     /* default bound on buffer memory        */
+
+/*
+ * Hash the regular files paths[0 .. n-1]: digests[i] receives SHA1(file)
+ * or, when key is not 0, HMAC-SHA1(key, file).  Each file is hashed up
+ * to the size it had when it was opened.
+ *
+ * errors[i] is set to 0, or to the errno of the failure for that file
+ * (EINVAL if it is not a regular file, EIO if it shrank while being
+ * read); digests[i] is left alone for failed files.
+ *
+ * nthreads hashing threads (0 = one per online CPU) and at most membytes
+ * of buffers (0 = SHA1_FILES_MEMORY, at least one chunk).
+ * SHA1_IO_BACKEND=io_uring|threads in the environment forces the reader.
+ *
+ * Returns sha Error Code: shaNull for missing arrays, shaBadParam if the
+ * buffers cannot be allocated; no file is read in either case.  If no
+ * thread can be started every file fails with EAGAIN.
+ */
+int sha1_files_hash(const char* const* paths, size_t n, const struct hmac_sha1_key* key,
+                    uint8_t (*digests)[SHA1HashSize], int* errors,
+                    unsigned nthreads, size_t membytes);
+
+/* "io_uring" or "threads": the reader sha1_files_hash() will use */
+const char* sha1_files_backend(void);
+
+
+#endif /* #ifndef _SHA1_FILES_H_ */
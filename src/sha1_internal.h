@@ -0,0 +1,235 @@
+/*
+ *  sha1_internal.h
+ *
+ *  Description:
+ *      Interface between sha1.c and the optional block compression
+ *      backends.  Not part of the public API.
+ *
+ *      A backend compresses 'nblocks' consecutive 64-octet blocks into
+ *      the running Intermediate_Hash.  sha1.c picks the fastest one the
+ *      CPU supports the first time a block is compressed.
+ *
+ */
+
+#ifndef _SHA1_INTERNAL_H_
+#define _SHA1_INTERNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * x86 backends need GCC/clang function-level target attributes, so the
+ * library still builds with plain -O2 and no -m flags.  Define
+ * SHA1_NO_SIMD to build the portable code only.
+ */
+#if    (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__GNUC__) || defined(__clang__)) \
+    && !defined(SHA1_NO_SIMD)
+#define SHA1_X86 1
+#endif
+
+typedef void (*sha1_compress_fn)(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks);
+
+/* CPU features relevant to the backends */
+#define SHA1_CPU_SSSE3   0x01
+#define SHA1_CPU_SSE41   0x02
+#define SHA1_CPU_SHANI   0x04
+#define SHA1_CPU_AVX2    0x08
+#define SHA1_CPU_AVX512  0x10           /* AVX-512F, with OS support for the ZMM state */
+
+unsigned sha1_cpu_features(void);
+
+/* Compress whole blocks with the single-stream backend in use */
+void sha1_compress(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks);
+
+/* The same, not counted by SHA1_STATS: for the serial multi-buffer kernel, counted as a kernel */
+void sha1_compress_uncounted(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks);
+
+/*
+ * Digest of the last len <= 55 octets of a message, continuing from
+ * 'state' after 'prefix' octets (a multiple of 64): builds the one
+ * padded block directly and compresses it once.
+ */
+void sha1_digest_block(const uint32_t state[5], uint64_t prefix, const uint8_t* msg, size_t len, uint8_t digest[20]);
+
+/* Name of compiled-in backend 'index' (supported or not), 0 past the last */
+const char* sha1_backend_name(unsigned index);
+
+/*
+ * SHA1_STATS hooks (see sha1_stats.h): per-thread counters of the hot
+ * paths.  Without SHA1_STATS they expand to nothing.
+ */
+struct sha1_mb_kernel;
+
+#ifdef SHA1_STATS
+void     sha1_stats_input(uint64_t length);
+void     sha1_stats_blocks(unsigned backend, size_t nblocks);
+void     sha1_stats_mb_blocks(const struct sha1_mb_kernel* kernel, size_t nblocks);
+void     sha1_stats_hmac(size_t length, uint64_t ns);
+uint64_t sha1_stats_now(void);
+
+#define SHA1_STATS_INPUT(length)               sha1_stats_input(length)
+#define SHA1_STATS_BLOCKS(backend, nblocks)    sha1_stats_blocks(backend, nblocks)
+#define SHA1_STATS_MB_BLOCKS(kernel, nblocks)  sha1_stats_mb_blocks(kernel, nblocks)
+#else
+#define SHA1_STATS_INPUT(length)               ((void)0)
+#define SHA1_STATS_BLOCKS(backend, nblocks)    ((void)0)
+#define SHA1_STATS_MB_BLOCKS(kernel, nblocks)  ((void)0)
+#endif
+
+#ifdef SHA1_X86
+void sha1_compress_shani(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks);
+void sha1_compress_avx2 (uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks);
+void sha1_compress_ssse3(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks);
+#endif
+
+
+/*
+ * Multi-buffer kernels compress one block in each of 'lanes' independent
+ * messages.  The state is kept structure-of-arrays: word i of lane l is
+ * state[i * lanes + l].  Lanes whose bit is clear in 'mask' are left
+ * untouched; their block pointer must still be readable.
+ */
+typedef void (*sha1_mb_compress_fn)(uint32_t* state, const uint8_t* const* blocks, uint32_t mask);
+
+struct sha1_mb_kernel
+{
+  const char*         name;
+  unsigned            lanes;
+  sha1_mb_compress_fn compress;
+  unsigned            features;         /* SHA1_CPU_* features needed */
+};
+
+#define SHA1_MB_MAX_LANES 16
+
+/* Multi-buffer kernel in use (SHA1_MB_BACKEND=<name> overrides the choice) */
+const struct sha1_mb_kernel* sha1_mb_kernel(void);
+
+/* Name of compiled-in SHA-1 kernel 'index' (supported or not), 0 past the last */
+const char* sha1_mb_kernel_name(unsigned index);
+
+/* Index of a SHA-1 kernel in that list, -1 for any other kernel (e.g. SHA-256) */
+int sha1_mb_kernel_index(const struct sha1_mb_kernel* kernel);
+
+/*
+ * One call of a multi-buffer kernel.  Every caller goes through here,
+ * so that SHA1_STATS sees the blocks of all active lanes.
+ */
+static inline void sha_mb_compress(const struct sha1_mb_kernel* kernel, uint32_t* state,
+                                   const uint8_t* const* blocks, uint32_t mask)
+{
+  kernel->compress(state, blocks, mask);
+  SHA1_STATS_MB_BLOCKS(kernel, (size_t)__builtin_popcount(mask));
+}
+
+#ifdef SHA1_X86
+void sha1_mb_compress_avx2  (uint32_t* state, const uint8_t* const* blocks, uint32_t mask);
+void sha1_mb_compress_avx512(uint32_t* state, const uint8_t* const* blocks, uint32_t mask);
+#endif
+
+/*
+ * Hash n messages through the multi-buffer kernel.  Every message is
+ * hashed as head || msgs[i], continuing from 'iv' after 'prefix' octets
+ * (a multiple of 64) were already absorbed into it.  iv == 0 means the
+ * standard SHA-1 initial value.
+ */
+void sha1_mb_hash(const uint32_t iv[5], uint64_t prefix,
+                  const uint8_t* head, size_t headlen,
+                  const uint8_t* const* msgs, const size_t* lens, size_t n,
+                  uint8_t (*digests)[20]);
+
+/*
+ * The scheduler behind sha1_mb_hash(), for any hash with 64-octet blocks,
+ * Merkle-Damgard padding and 'words' big-endian state words (SHA-256
+ * uses it with 8).  Digests are written back to back, 4 * words octets
+ * each.
+ */
+void sha_mb_hash(const struct sha1_mb_kernel* kernel, unsigned words, const uint32_t* iv, uint64_t prefix,
+                 const uint8_t* head, size_t headlen,
+                 const uint8_t* const* msgs, const size_t* lens, size_t n,
+                 uint8_t* digests);
+
+/* Parameter checks shared by the sha*_multi() entry points: sha Error Code */
+int sha_mb_check(const uint8_t* const* msgs, const size_t* lens, size_t n, const void* digests);
+
+/* Clear a stack buffer that held message or key material; not removed as a dead store */
+static inline void sha_clear(void* p, size_t n)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  /* a plain memset, kept by telling the compiler the memory is read afterwards */
+  memset(p, 0, n);
+  __asm__ __volatile__("" : : "r"(p) : "memory");
+#else
+  volatile uint8_t* q = (volatile uint8_t*)p;
+
+  while (n != 0)
+  {
+    q[--n] = 0;
+  }
+#endif
+}
+
+
+/* Big-endian words, as the hashes and the modes built on them store them */
+static inline void sha_put32(uint8_t* p, uint32_t w)
+{
+  p[0] = (uint8_t)(w >> 24);
+  p[1] = (uint8_t)(w >> 16);
+  p[2] = (uint8_t)(w >> 8);
+  p[3] = (uint8_t)(w);
+}
+
+static inline uint32_t sha_get32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* one 64-bit store where the byte order is known at compile time */
+static inline void sha_put64(uint8_t* p, uint64_t v)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+  v = __builtin_bswap64(v);
+  memcpy(p, &v, sizeof(v));
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  memcpy(p, &v, sizeof(v));
+#else
+  sha_put32(p, (uint32_t)(v >> 32));
+  sha_put32(p + 4, (uint32_t)v);
+#endif
+}
+
+static inline uint64_t sha_get64(const uint8_t* p)
+{
+  return ((uint64_t)sha_get32(p) << 32) | sha_get32(p + 4);
+}
+
+/* 1 if the n octets at a and b are equal; does not branch on the contents */
+static inline int sha_equal(const uint8_t* a, const uint8_t* b, size_t n)
+{
+  uint8_t diff = 0;
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+  {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+/*
+ * Lay out the final block of a message whose last 'len' <= 55 octets
+ * go at the start of it, after 'prefix' octets (a multiple of 64): the
+ * message octets 0 .. len-1 are left for the caller to write.  For
+ * kernels that compress the same block shape many times; a single
+ * block goes through sha1_digest_block().
+ */
+static inline void sha_pad_block(uint8_t block[64], size_t len, uint64_t prefix)
+{
+  block[len] = 0x80;
+  memset(block + len + 1, 0, 55 - len);
+  sha_put64(block + 56, (prefix + len) << 3);
+}
+
+#endif /* #ifndef _SHA1_INTERNAL_H_ */
+
@@ -0,0 +1,473 @@
+/*
+ *  sha1_keys.c
+ *
+ *  Description:
+ *      Lock-free lookup of precomputed HMAC-SHA1 keys, see sha1_keys.h.
+ *
+ *      Entries live in a chained hash table.  An entry is immutable once
+ *      published except for its chain link and its LRU stamp.  Writers
+ *      (put, remove, loads on a miss) take one mutex and change the
+ *      table with single atomic pointer stores; readers walk the chains
+ *      without locking.
+ *
+ *      Reclamation is epoch based.  A reader announces itself by
+ *      writing the current epoch into a free reader slot before it
+ *      touches the table, and clears the slot when done.  A writer that
+ *      unlinks an entry bumps the epoch and tags the entry with the new
+ *      value E.  A reader that announced E or later started after the
+ *      unlink and cannot reach the entry, so the entry is freed once no
+ *      slot holds an epoch below E.  All table and slot accesses on
+ *      both sides are sequentially consistent, which is what makes
+ *      "the slot was clear" imply "the reader will see the unlink".
+ *
+ *      Eviction is approximate LRU: a clock advances on every insert and
+ *      lookups stamp their entry with it.  A full registry evicts the
+ *      oldest stamp among a few entries sampled round robin.
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_keys.h"
+#include "sha1_internal.h"
+
+#define CACHE_LINE    64
+#define EVICT_SAMPLE  16                /* entries compared per eviction */
+
+struct _entry
+{
+  uint64_t              id;
+  struct hmac_sha1_key  key;
+  struct _entry*        next;           /* chain link, read by lookups      */
+  uint64_t              used;           /* clock value of the last lookup   */
+  uint64_t              retired;        /* epoch tag once unlinked          */
+  struct _entry*        free_next;      /* retired list, writers only       */
+};
+
+/* one reader slot per cache line: 0 = free, else the epoch its reader announced */
+union _slot
+{
+  uint64_t epoch;
+  char pad[CACHE_LINE];
+};
+
+struct sha1_keys
+{
+  union _slot         slots[SHA1_KEYS_READERS];
+  struct _entry**     buckets;
+  size_t              mask;
+  size_t              capacity;
+  size_t              count;
+  sha1_keys_load_fn   load;
+  void*               arg;
+  pthread_mutex_t     lock;
+  uint64_t            epoch;
+  uint64_t            clock;
+  size_t              cursor;           /* next bucket sampled for eviction */
+  struct _entry*      retired;          /* unlinked, waiting for readers    */
+};
+
+/* per-thread starting slot, handed out round robin on first use (0 = not yet) */
+static __thread unsigned _hint;
+static unsigned          _next_hint;
+
+
+/* Claim a reader slot and announce the current epoch in it */
+static union _slot* _enter(struct sha1_keys* keys)
+{
+  unsigned i, tries;
+  uint64_t expected, epoch;
+
+  if (_hint == 0)
+  {
+    _hint = __atomic_add_fetch(&_next_hint, 1, __ATOMIC_RELAXED);
+  }
+  i = _hint;
+
+  for (tries = 0; ; ++tries)
+  {
+    i %= SHA1_KEYS_READERS;
+    expected = 0;
+    epoch = __atomic_load_n(&keys->epoch, __ATOMIC_SEQ_CST);
+    if (    (__atomic_load_n(&keys->slots[i].epoch, __ATOMIC_RELAXED) == 0)
+         && __atomic_compare_exchange_n(&keys->slots[i].epoch, &expected, epoch, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+      return &keys->slots[i];
+    }
+    i += 1;
+    if ((tries % SHA1_KEYS_READERS) == SHA1_KEYS_READERS - 1)
+    {
+      /* more readers than slots: let one of them finish */
+      sched_yield();
+    }
+  }
+}
+
+static void _leave(union _slot* slot)
+{
+  __atomic_store_n(&slot->epoch, 0, __ATOMIC_RELEASE);
+}
+
+static size_t _bucket(const struct sha1_keys* keys, uint64_t id)
+{
+  return (size_t)((id * 0x9E3779B97F4A7C15ull) >> 32) & keys->mask;
+}
+
+/* Link pointing at entry 'id' (or at the end of its chain), for writers */
+static struct _entry** _find(struct sha1_keys* keys, uint64_t id)
+{
+  struct _entry** link = &keys->buckets[_bucket(keys, id)];
+  struct _entry* e;
+
+  while ((e = *link) != 0)
+  {
+    if (e->id == id)
+    {
+      break;
+    }
+    link = &e->next;
+  }
+  return link;
+}
+
+/* Clear the key material and free an entry */
+static void _free_entry(struct _entry* e)
+{
+  sha_clear(&e->key, sizeof(e->key));
+  free(e);
+}
+
+/* Free retired entries that no running lookup can still reach */
+static void _reclaim(struct sha1_keys* keys)
+{
+  struct _entry** link = &keys->retired;
+  struct _entry* e;
+  uint64_t oldest = UINT64_MAX, epoch;
+  unsigned i;
+
+  if (keys->retired == 0)
+  {
+    return;
+  }
+
+  for (i = 0; i < SHA1_KEYS_READERS; ++i)
+  {
+    epoch = __atomic_load_n(&keys->slots[i].epoch, __ATOMIC_SEQ_CST);
+    if ((epoch != 0) && (epoch < oldest))
+    {
+      oldest = epoch;
+    }
+  }
+
+  while ((e = *link) != 0)
+  {
+    if (e->retired <= oldest)
+    {
+      *link = e->free_next;
+      _free_entry(e);
+    }
+    else
+    {
+      link = &e->free_next;
+    }
+  }
+}
+
+/* Unlink the entry *link points at and queue it for freeing */
+static void _unlink(struct sha1_keys* keys, struct _entry** link, struct _entry* replacement)
+{
+  struct _entry* e = *link;
+
+  __atomic_store_n(link, replacement, __ATOMIC_SEQ_CST);
+  e->retired   = __atomic_add_fetch(&keys->epoch, 1, __ATOMIC_SEQ_CST);
+  e->free_next = keys->retired;
+  keys->retired = e;
+}
+
+/* Evict the least recently used of a few entries sampled round robin */
+static void _evict(struct sha1_keys* keys)
+{
+  struct _entry** victim = 0;
+  struct _entry** link;
+  struct _entry* e;
+  size_t scanned = 0, sampled = 0;
+
+  while ((sampled < EVICT_SAMPLE) && (scanned <= keys->mask))
+  {
+    for (link = &keys->buckets[keys->cursor]; (e = *link) != 0; link = &e->next)
+    {
+      if (    (victim == 0)
+           || (__atomic_load_n(&e->used, __ATOMIC_RELAXED) < __atomic_load_n(&(*victim)->used, __ATOMIC_RELAXED)))
+      {
+        victim = link;
+      }
+      sampled += 1;
+    }
+    keys->cursor = (keys->cursor + 1) & keys->mask;
+    scanned += 1;
+  }
+
+  if (victim != 0)
+  {
+    _unlink(keys, victim, (*victim)->next);
+    __atomic_store_n(&keys->count, keys->count - 1, __ATOMIC_RELAXED);
+  }
+}
+
+/* Publish key 'id'; called with the lock held */
+static int _publish(struct sha1_keys* keys, uint64_t id, const struct hmac_sha1_key* key)
+{
+  struct _entry** link;
+  struct _entry* e;
+  uint64_t clock;
+
+  e = malloc(sizeof(*e));
+  if (e == 0)
+  {
+    return shaBadParam;
+  }
+
+  clock = __atomic_load_n(&keys->clock, __ATOMIC_RELAXED) + 1;
+  __atomic_store_n(&keys->clock, clock, __ATOMIC_RELAXED);
+
+  e->id   = id;
+  e->key  = *key;
+  e->used = clock;
+
+  link = _find(keys, id);
+  if (*link != 0)
+  {
+    /* rotation: the new entry takes the old one's place in the chain */
+    e->next = (*link)->next;
+    _unlink(keys, link, e);
+  }
+  else
+  {
+    if (keys->count >= keys->capacity)
+    {
+      _evict(keys);
+      link = _find(keys, id);
+    }
+    e->next = 0;
+    __atomic_store_n(link, e, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&keys->count, keys->count + 1, __ATOMIC_RELAXED);
+  }
+
+  _reclaim(keys);
+  return shaSuccess;
+}
+
+
+/*
+ *  sha1_keys_create
+ *
+ *  Description:
+ *      Allocates an empty registry, see sha1_keys.h.
+ *
+ */
+struct sha1_keys* sha1_keys_create(size_t capacity, sha1_keys_load_fn load, void* arg)
+{
+  struct sha1_keys* keys;
+  size_t nbuckets = 16;
+
+  if (capacity == 0)
+  {
+    return 0;
+  }
+
+  while ((nbuckets < capacity) && (nbuckets < ((size_t)1 << 30)))
+  {
+    nbuckets <<= 1;
+  }
+
+  if (posix_memalign((void**)&keys, CACHE_LINE, sizeof(*keys)) != 0)
+  {
+    return 0;
+  }
+  memset(keys, 0, sizeof(*keys));
+
+  keys->buckets = calloc(nbuckets, sizeof(*keys->buckets));
+  if (keys->buckets == 0)
+  {
+    free(keys);
+    return 0;
+  }
+
+  keys->mask     = nbuckets - 1;
+  keys->capacity = capacity;
+  keys->load     = load;
+  keys->arg      = arg;
+  keys->epoch    = 1;
+  pthread_mutex_init(&keys->lock, 0);
+
+  return keys;
+}
+
+/*
+ *  sha1_keys_destroy
+ *
+ *  Description:
+ *      Frees the registry with all its entries, see sha1_keys.h.
+ *
+ */
+void sha1_keys_destroy(struct sha1_keys* keys)
+{
+  struct _entry* e;
+  size_t i;
+
+  if (keys == 0)
+  {
+    return;
+  }
+
+  for (i = 0; i <= keys->mask; ++i)
+  {
+    while ((e = keys->buckets[i]) != 0)
+    {
+      keys->buckets[i] = e->next;
+      _free_entry(e);
+    }
+  }
+  while ((e = keys->retired) != 0)
+  {
+    keys->retired = e->free_next;
+    _free_entry(e);
+  }
+
+  pthread_mutex_destroy(&keys->lock);
+  free(keys->buckets);
+  free(keys);
+}
+
+/*
+ *  sha1_keys_put
+ *
+ *  Description:
+ *      Computes the midstates of a key and publishes them under 'id',
+ *      see sha1_keys.h.
+ *
+ */
+int sha1_keys_put(struct sha1_keys* keys, uint64_t id, const uint8_t* key, size_t keysize)
+{
+  struct hmac_sha1_key midstates;
+  int err;
+
+  if ((keys == 0) || ((key == 0) && (keysize != 0)))
+  {
+    return shaNull;
+  }
+
+  hmac_sha1_key_init(&midstates, key, keysize);
+
+  pthread_mutex_lock(&keys->lock);
+  err = _publish(keys, id, &midstates);
+  pthread_mutex_unlock(&keys->lock);
+
+  sha_clear(&midstates, sizeof(midstates));
+  return err;
+}
+
+/*
+ *  sha1_keys_get
+ *
+ *  Description:
+ *      Looks up key 'id' without locking, falling back to the loader
+ *      under the lock on a miss, see sha1_keys.h.
+ *
+ */
+int sha1_keys_get(struct sha1_keys* keys, uint64_t id, struct hmac_sha1_key* key)
+{
+  union _slot* slot;
+  struct _entry* e;
+  struct _entry** link;
+  uint64_t clock;
+  int err = shaBadParam;
+
+  if ((keys == 0) || (key == 0))
+  {
+    return shaNull;
+  }
+
+  slot = _enter(keys);
+  e = __atomic_load_n(&keys->buckets[_bucket(keys, id)], __ATOMIC_SEQ_CST);
+  while ((e != 0) && (e->id != id))
+  {
+    e = __atomic_load_n(&e->next, __ATOMIC_SEQ_CST);
+  }
+  if (e != 0)
+  {
+    *key = e->key;
+    /* only write the shared stamp when it changes */
+    clock = __atomic_load_n(&keys->clock, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&e->used, __ATOMIC_RELAXED) != clock)
+    {
+      __atomic_store_n(&e->used, clock, __ATOMIC_RELAXED);
+    }
+  }
+  _leave(slot);
+
+  if (e != 0)
+  {
+    return shaSuccess;
+  }
+  if (keys->load == 0)
+  {
+    return shaBadParam;
+  }
+
+  pthread_mutex_lock(&keys->lock);
+  link = _find(keys, id);
+  if (*link != 0)
+  {
+    /* another thread loaded it meanwhile */
+    *key = (*link)->key;
+    err = shaSuccess;
+  }
+  else if (keys->load(keys->arg, id, key) == 0)
+  {
+    err = _publish(keys, id, key);
+  }
+  pthread_mutex_unlock(&keys->lock);
+
+  return err;
+}
+
+/*
+ *  sha1_keys_remove
+ *
+ *  Description:
+ *      Unlinks key 'id', see sha1_keys.h.
+ *
+ */
+int sha1_keys_remove(struct sha1_keys* keys, uint64_t id)
+{
+  struct _entry** link;
+  int err = shaBadParam;
+
+  if (keys == 0)
+  {
+    return shaNull;
+  }
+
+  pthread_mutex_lock(&keys->lock);
+  link = _find(keys, id);
+  if (*link != 0)
+  {
+    _unlink(keys, link, (*link)->next);
+    __atomic_store_n(&keys->count, keys->count - 1, __ATOMIC_RELAXED);
+    _reclaim(keys);
+    err = shaSuccess;
+  }
+  pthread_mutex_unlock(&keys->lock);
+
+  return err;
+}
+
+size_t sha1_keys_count(const struct sha1_keys* keys)
+{
+  return (keys == 0) ? 0 : __atomic_load_n(&keys->count, __ATOMIC_RELAXED);
+}
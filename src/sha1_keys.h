@@ -0,0 +1,84 @@
+/*
+ *  sha1_keys.h
+ *
+ *  Description:
+ *      Shared registry of precomputed HMAC-SHA1 keys (see
+ *      hmac_sha1_key_init()) looked up by a 64-bit key id, for servers
+ *      that authenticate every request with one of many keys.
+ *
+ *      Lookups take no lock: they copy the midstates out of an entry
+ *      that is never modified once published.  Adding, rotating or
+ *      removing a key replaces the entry with a single atomic store,
+ *      so a reader sees either the old key or the new one, never a mix.
+ *      Replaced entries are freed once every lookup that might still be
+ *      reading them has finished (epoch based reclamation).
+ *
+ *      The registry holds at most 'capacity' keys.  When it is full, a
+ *      new key evicts an entry that has not been looked up recently
+ *      (approximate LRU).  Evicted keys come back on their next lookup
+ *      through the optional loader, which is the only place where key
+ *      padding and midstate work happen after a key's first use.
+ *
+ *      Needs POSIX threads (build with -pthread).
+ *
+ */
+
+#ifndef _SHA1_KEYS_H_
+#define _SHA1_KEYS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hmac.h"
+
+#define SHA1_KEYS_READERS   128     /* lookups that can run at the same time */
+
+struct sha1_keys;
+
+/*
+ * Called on a lookup miss to fetch key 'id', e.g. from a key store:
+ * fills in 'key' with hmac_sha1_key_init() and returns 0, or returns
+ * nonzero if there is no such key.  Calls are serialized.
+ */
+typedef int (*sha1_keys_load_fn)(void* arg, uint64_t id, struct hmac_sha1_key* key);
+
+/*
+ * Create a registry for up to 'capacity' keys, with an optional loader
+ * (load may be 0).  Returns 0 if out of memory or capacity is 0.
+ */
+struct sha1_keys* sha1_keys_create(size_t capacity, sha1_keys_load_fn load, void* arg);
+
+/* Free the registry; no lookup may be running */
+void sha1_keys_destroy(struct sha1_keys* keys);
+
+/*
+ * Publish key 'id', replacing any previous key with that id (rotation).
+ * The midstates are computed before anything is locked.
+ *
+ * Returns sha Error Code: shaNull for missing arguments, shaBadParam if
+ * out of memory.
+ */
+int sha1_keys_put(struct sha1_keys* keys, uint64_t id, const uint8_t* key, size_t keysize);
+
+/*
+ * Copy the midstates of key 'id' to 'key', loading it first if it is not
+ * in the registry and there is a loader.  Lock free unless the key has
+ * to be loaded.
+ *
+ * Returns sha Error Code: shaNull for missing arguments, shaBadParam if
+ * there is no such key.
+ */
+int sha1_keys_get(struct sha1_keys* keys, uint64_t id, struct hmac_sha1_key* key);
+
+/*
+ * Withdraw key 'id'.  Lookups that already started may still return it.
+ *
+ * Returns sha Error Code: shaNull for a missing registry, shaBadParam if
+ * there is no such key.
+ */
+int sha1_keys_remove(struct sha1_keys* keys, uint64_t id);
+
+/* Number of keys held */
+size_t sha1_keys_count(const struct sha1_keys* keys);
+
+
+#endif /* #ifndef _SHA1_KEYS_H_ */
@@ -0,0 +1,479 @@
+/*
+ *  sha1_mb.c
+ *
+ *  Description:
+ *      Multi-buffer SHA-1: hashes many independent messages at once by
+ *      giving each one a lane of a SIMD kernel (16 lanes with AVX-512,
+ *      8 with AVX2).  SHA-1 cannot be parallelized within one message,
+ *      but throughput over many short messages scales with the lanes.
+ *
+ *      The scheduler below feeds every lane one block per kernel call.
+ *      Whole blocks are read straight from the caller's buffers; only
+ *      blocks that contain padding (or that straddle the shared head and
+ *      the message) are assembled in a per-lane staging block.  When a
+ *      message is done its lane is refilled with the next one, and lanes
+ *      without work are masked out.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sha1.h"
+#include "sha1_internal.h"
+
+static void _mb_compress_serial(uint32_t* state, const uint8_t* const* blocks, uint32_t mask);
+
+/* Multi-buffer kernels, widest first */
+static const struct sha1_mb_kernel _kernels[] =
+{
+#ifdef SHA1_X86
+  { "avx512", 16, sha1_mb_compress_avx512, SHA1_CPU_AVX512 },
+  { "avx2",    8, sha1_mb_compress_avx2,   SHA1_CPU_AVX2   },
+#endif
+  { "serial",  4, _mb_compress_serial,     0               },
+};
+
+#define NKERNELS (sizeof(_kernels) / sizeof(*_kernels))
+
+static const struct sha1_mb_kernel* _kernel = 0;
+
+static const uint32_t _sha1_iv[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+/* Readable block for lanes that are masked out */
+static const uint8_t _idle_block[64] = { 0 };
+
+
+/*
+ *  _mb_compress_serial
+ *
+ *  Description:
+ *      Fallback kernel without SIMD lanes: compresses the active lanes
+ *      one after the other with the single-stream backend.  SHA1_STATS
+ *      counts these blocks for the kernel, not for the backend.
+ *
+ */
+static void _mb_compress_serial(uint32_t* state, const uint8_t* const* blocks, uint32_t mask)
+{
+  uint32_t H[5];
+  unsigned l, i;
+
+  for (l = 0; l < 4; ++l)
+  {
+    if (mask & (1u << l))
+    {
+      for (i = 0; i < 5; ++i)
+      {
+        H[i] = state[i * 4 + l];
+      }
+      sha1_compress_uncounted(H, blocks[l], 1);
+      for (i = 0; i < 5; ++i)
+      {
+        state[i * 4 + l] = H[i];
+      }
+    }
+  }
+}
+
+/* Index of the kernel called 'name', or of the widest supported one if name is 0 */
+static int _find_kernel(const char* name)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
+
+  for (i = 0; i < NKERNELS; ++i)
+  {
+    if (    ((_kernels[i].features & features) == _kernels[i].features)
+         && (    (name == 0)
+              || (strcmp(name, _kernels[i].name) == 0)))
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/*
+ *  sha1_mb_kernel
+ *
+ *  Description:
+ *      Kernel in use, picked on first use.  SHA1_MB_BACKEND=<name> in
+ *      the environment overrides the choice.
+ *
+ */
+const struct sha1_mb_kernel* sha1_mb_kernel(void)
+{
+  const struct sha1_mb_kernel* kernel = __atomic_load_n(&_kernel, __ATOMIC_ACQUIRE);
+  const char* name;
+  int i = -1;
+
+  if (kernel == 0)
+  {
+    /* threads racing here pick the same kernel, or one set meanwhile */
+    name = getenv("SHA1_MB_BACKEND");
+    if (name != 0)
+    {
+      i = _find_kernel(name);
+    }
+    if (i < 0)
+    {
+      i = _find_kernel(0);
+    }
+    kernel = &_kernels[i];
+    __atomic_store_n(&_kernel, kernel, __ATOMIC_RELEASE);
+  }
+  return kernel;
+}
+
+const char* sha1_mb_backend(void)
+{
+  return sha1_mb_kernel()->name;
+}
+
+const char* sha1_mb_backend_at(unsigned index)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
+
+  for (i = 0; i < NKERNELS; ++i)
+  {
+    if ((_kernels[i].features & features) == _kernels[i].features)
+    {
+      if (index == 0)
+      {
+        return _kernels[i].name;
+      }
+      index -= 1;
+    }
+  }
+  return 0;
+}
+
+const char* sha1_mb_kernel_name(unsigned index)
+{
+  return (index < NKERNELS) ? _kernels[index].name : 0;
+}
+
+int sha1_mb_kernel_index(const struct sha1_mb_kernel* kernel)
+{
+  unsigned i;
+
+  for (i = 0; i < NKERNELS; ++i)
+  {
+    if (kernel == &_kernels[i])
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+int sha1_mb_set_backend(const char* name)
+{
+  int i;
+
+  if (name == 0)
+  {
+    return shaNull;
+  }
+
+  i = _find_kernel(name);
+  if (i < 0)
+  {
+    return shaBadParam;
+  }
+
+  __atomic_store_n(&_kernel, &_kernels[i], __ATOMIC_RELEASE);
+  return shaSuccess;
+}
+
+
+/*
+ * Per-lane progress through head || msg || padding
+ */
+struct _lane
+{
+  size_t         job;                   /* message index                    */
+  const uint8_t* msg;
+  size_t         len;                   /* message length                   */
+  size_t         block;                 /* next block to compress           */
+  size_t         nblocks;               /* blocks including padding         */
+  uint8_t        staged[64];            /* assembled block when needed      */
+};
+
+/* Assemble block 'b' of head || msg || padding */
+static void _stage_block(struct _lane* lane, const uint8_t* head, size_t headlen, uint64_t prefix)
+{
+  uint64_t total = (uint64_t)headlen + lane->len;
+  uint64_t start = (uint64_t)lane->block * 64;
+  uint64_t bits;
+  size_t   i = 0;
+  size_t   n;
+
+  memset(lane->staged, 0, 64);
+
+  /* head part */
+  if (start < headlen)
+  {
+    n = headlen - (size_t)start;
+    if (n > 64)
+    {
+      n = 64;
+    }
+    memcpy(lane->staged, head + start, n);
+    i = n;
+  }
+
+  /* message part */
+  if ((i < 64) && (start + i < total))
+  {
+    n = (size_t)(total - (start + i));
+    if (n > 64 - i)
+    {
+      n = 64 - i;
+    }
+    memcpy(lane->staged + i, lane->msg + (start + i - headlen), n);
+    i += n;
+  }
+
+  /* padding */
+  if ((i < 64) && (start + i == total))
+  {
+    lane->staged[i] = 0x80;
+  }
+  if (lane->block == lane->nblocks - 1)
+  {
+    bits = (prefix + total) << 3;
+    for (i = 0; i < 8; ++i)
+    {
+      lane->staged[56 + i] = (uint8_t)(bits >> (8 * (7 - i)));
+    }
+  }
+}
+
+/*
+ *  sha_mb_hash
+ *
+ *  Description:
+ *      Runs n messages through a multi-buffer kernel, see
+ *      sha1_internal.h.
+ *
+ */
+void sha_mb_hash(const struct sha1_mb_kernel* kernel, unsigned words, const uint32_t* iv, uint64_t prefix,
+                 const uint8_t* head, size_t headlen,
+                 const uint8_t* const* msgs, const size_t* lens, size_t n,
+                 uint8_t* digests)
+{
+  const unsigned lanes = kernel->lanes;
+  struct _lane   lane[SHA1_MB_MAX_LANES];
+  const uint8_t* blocks[SHA1_MB_MAX_LANES];
+  uint32_t       state[8 * SHA1_MB_MAX_LANES];
+  uint32_t       active = 0;
+  size_t         next = 0;
+  uint64_t       start;
+  uint8_t*       digest;
+  unsigned       l, i;
+
+  for (l = 0; l < lanes; ++l)
+  {
+    blocks[l] = _idle_block;
+  }
+
+  for (;;)
+  {
+    /* (Re)fill idle lanes */
+    for (l = 0; (l < lanes) && (next < n); ++l)
+    {
+      if ((active & (1u << l)) == 0)
+      {
+        lane[l].job     = next;
+        lane[l].msg     = msgs[next];
+        lane[l].len     = lens[next];
+        lane[l].block   = 0;
+        lane[l].nblocks = (size_t)((headlen + lane[l].len + 8) / 64) + 1;
+        for (i = 0; i < words; ++i)
+        {
+          state[i * lanes + l] = iv[i];
+        }
+        active |= (1u << l);
+        next += 1;
+      }
+    }
+
+    if (active == 0)
+    {
+      break;
+    }
+
+    /* Point every active lane at its next block */
+    for (l = 0; l < lanes; ++l)
+    {
+      if (active & (1u << l))
+      {
+        start = (uint64_t)lane[l].block * 64;
+        if (    (start >= headlen)
+             && (start + 64 <= headlen + lane[l].len))
+        {
+          blocks[l] = lane[l].msg + (start - headlen);
+        }
+        else
+        {
+          _stage_block(&lane[l], head, headlen, prefix);
+          blocks[l] = lane[l].staged;
+        }
+      }
+      else
+      {
+        blocks[l] = _idle_block;
+      }
+    }
+
+    sha_mb_compress(kernel, state, blocks, active);
+
+    /* Retire lanes whose message is complete */
+    for (l = 0; l < lanes; ++l)
+    {
+      if (active & (1u << l))
+      {
+        lane[l].block += 1;
+        if (lane[l].block == lane[l].nblocks)
+        {
+          digest = digests + lane[l].job * words * 4;
+          for (i = 0; i < words * 4; ++i)
+          {
+            digest[i] = (uint8_t)(state[(i >> 2) * lanes + l] >> (8 * (3 - (i & 0x03))));
+          }
+          active &= ~(1u << l);
+        }
+      }
+    }
+  }
+}
+
+void sha1_mb_hash(const uint32_t iv[5], uint64_t prefix,
+                  const uint8_t* head, size_t headlen,
+                  const uint8_t* const* msgs, const size_t* lens, size_t n,
+                  uint8_t (*digests)[20])
+{
+  sha_mb_hash(sha1_mb_kernel(), 5, (iv != 0) ? iv : _sha1_iv, prefix, head, headlen, msgs, lens, n, (uint8_t*)digests);
+}
+
+
+/*
+ *  sha_mb_check
+ *
+ *  Description:
+ *      Checks the arrays handed to sha1_multi() and friends: every
+ *      message with a nonzero length needs a buffer.
+ *
+ */
+int sha_mb_check(const uint8_t* const* msgs, const size_t* lens, size_t n, const void* digests)
+{
+  size_t i;
+
+  if (n == 0)
+  {
+    return shaSuccess;
+  }
+
+  if (    (msgs == 0)
+       || (lens == 0)
+       || (digests == 0))
+  {
+    return shaNull;
+  }
+
+  for (i = 0; i < n; ++i)
+  {
+    if ((msgs[i] == 0) && (lens[i] != 0))
+    {
+      return shaNull;
+    }
+  }
+
+  return shaSuccess;
+}
+
+/*
+ *  sha1_multi
+ *
+ *  Description:
+ *      Computes the SHA-1 digest of n independent messages, spreading
+ *      them over the lanes of the multi-buffer kernel.
+ *
+ *  Parameters:
+ *      msgs: [in]
+ *          Pointers to the messages.
+ *      lens: [in]
+ *          Message lengths in octets.
+ *      n: [in]
+ *          Number of messages.
+ *      digests: [out]
+ *          n digests of SHA1HashSize octets.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha1_multi(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*digests)[SHA1HashSize])
+{
+  int err = sha_mb_check(msgs, lens, n, digests);
+
+  if ((err == shaSuccess) && (n != 0))
+  {
+    sha1_mb_hash(0, 0, 0, 0, msgs, lens, n, digests);
+  }
+
+  return err;
+}
+
+/*
+ *  sha1_multi_from
+ *
+ *  Description:
+ *      Computes SHA-1(P || msgs[i]) for n suffixes of one prefix P that
+ *      has already been fed to 'prefix' with sha1_input().  The whole
+ *      blocks of P are not compressed again: every lane starts from the
+ *      prefix's Intermediate_Hash, with its buffered partial block as a
+ *      shared head.  The prefix context is left untouched.
+ *
+ *  Parameters:
+ *      prefix: [in]
+ *          Context holding the prefix, not yet finished by sha1_result().
+ *      msgs: [in]
+ *          Pointers to the suffixes.
+ *      lens: [in]
+ *          Suffix lengths in octets.
+ *      n: [in]
+ *          Number of suffixes.
+ *      digests: [out]
+ *          n digests of SHA1HashSize octets.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha1_multi_from(const struct sha1* prefix, const uint8_t* const* msgs, const size_t* lens, size_t n,
+                    uint8_t (*digests)[SHA1HashSize])
+{
+  int err;
+
+  if (prefix == 0)
+  {
+    return shaNull;
+  }
+
+  if ((prefix->flags & (FLAG_COMPUTED | FLAG_CORRUPTED)) != 0)
+  {
+    return shaStateError;
+  }
+
+  err = sha_mb_check(msgs, lens, n, digests);
+  if ((err == shaSuccess) && (n != 0))
+  {
+    sha1_mb_hash(prefix->Intermediate_Hash, (prefix->Length >> 3) - prefix->Message_Block_Index,
+                 prefix->Message_Block, prefix->Message_Block_Index, msgs, lens, n, digests);
+  }
+
+  return err;
+}
+
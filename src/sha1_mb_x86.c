@@ -0,0 +1,204 @@
+/*
+ *  sha1_mb_x86.c
+ *
+ *  Description:
+ *      Multi-buffer SHA-1 compression kernels: one 32-bit SIMD lane per
+ *      message, 8 lanes with AVX2 and 16 with AVX-512F.  The rounds are
+ *      the plain FIPS 180-1 ones, applied to a vector of A..E values;
+ *      see sha1_mb.c for the scheduler that feeds the lanes.
+ *
+ *      Every lane's block is loaded as rows of eight words and transposed
+ *      so that vector W[t] holds word t of all lanes.  The W[16] ring is
+ *      updated in place from round 16 on, and A..E are renamed through
+ *      five round invocations instead of being shuffled with moves.
+ *
+ */
+
+#include "sha1_internal.h"
+
+#ifdef SHA1_X86
+
+#include <immintrin.h>
+#include "sha_mb_x86.h"
+
+#define K0 0x5A827999
+#define K1 0x6ED9EBA1
+#define K2 0x8F1BBCDC
+#define K3 0xCA62C1D6
+
+
+/*
+ * AVX2, 8 lanes
+ */
+#define ROL256(x, n)     _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define CH256(b, c, d)   _mm256_xor_si256(_mm256_and_si256((b), _mm256_xor_si256((c), (d))), (d))
+#define PAR256(b, c, d)  _mm256_xor_si256(_mm256_xor_si256((b), (c)), (d))
+#define MAJ256(b, c, d)  _mm256_or_si256(_mm256_and_si256((b), (c)), _mm256_and_si256(_mm256_or_si256((b), (c)), (d)))
+
+#define ROUND256(a, b, c, d, e, F, k, t)                                                \
+  do                                                                                    \
+  {                                                                                     \
+    if ((t) >= 16)                                                                      \
+    {                                                                                   \
+      W[(t) & 15] = ROL256(_mm256_xor_si256(_mm256_xor_si256(W[((t) - 3) & 15], W[((t) - 8) & 15]), \
+                                            _mm256_xor_si256(W[((t) - 14) & 15], W[(t) & 15])), 1); \
+    }                                                                                   \
+    e = _mm256_add_epi32(e, _mm256_add_epi32(ROL256(a, 5), F(b, c, d)));                \
+    e = _mm256_add_epi32(e, _mm256_add_epi32(W[(t) & 15], k));                          \
+    b = ROL256(b, 30);                                                                  \
+  } while (0)
+
+#define ROUNDS256x5(F, k, t)                  \
+  do                                          \
+  {                                           \
+    ROUND256(A, B, C, D, E, F, k, (t) + 0);   \
+    ROUND256(E, A, B, C, D, F, k, (t) + 1);   \
+    ROUND256(D, E, A, B, C, F, k, (t) + 2);   \
+    ROUND256(C, D, E, A, B, F, k, (t) + 3);   \
+    ROUND256(B, C, D, E, A, F, k, (t) + 4);   \
+  } while (0)
+
+__attribute__((target("avx2")))
+void sha1_mb_compress_avx2(uint32_t* state, const uint8_t* const* blocks, uint32_t mask)
+{
+  const __m256i lane_bits = _mm256_set_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  __m256i W[16];
+  __m256i A, B, C, D, E, k, m;
+  __m256i* S = (__m256i*)state;
+  unsigned t;
+
+  _load8(&W[0], blocks, 0);
+  _load8(&W[8], blocks, 1);
+
+  A = _mm256_loadu_si256(&S[0]);
+  B = _mm256_loadu_si256(&S[1]);
+  C = _mm256_loadu_si256(&S[2]);
+  D = _mm256_loadu_si256(&S[3]);
+  E = _mm256_loadu_si256(&S[4]);
+
+  k = _mm256_set1_epi32(K0);
+  for (t = 0; t < 20; t += 5)
+  {
+    ROUNDS256x5(CH256, k, t);
+  }
+  k = _mm256_set1_epi32(K1);
+  for (; t < 40; t += 5)
+  {
+    ROUNDS256x5(PAR256, k, t);
+  }
+  k = _mm256_set1_epi32(K2);
+  for (; t < 60; t += 5)
+  {
+    ROUNDS256x5(MAJ256, k, t);
+  }
+  k = _mm256_set1_epi32(K3);
+  for (; t < 80; t += 5)
+  {
+    ROUNDS256x5(PAR256, k, t);
+  }
+
+  /* Add to the running hash in active lanes only */
+  m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)mask), lane_bits), lane_bits);
+  _mm256_storeu_si256(&S[0], _mm256_add_epi32(_mm256_loadu_si256(&S[0]), _mm256_and_si256(A, m)));
+  _mm256_storeu_si256(&S[1], _mm256_add_epi32(_mm256_loadu_si256(&S[1]), _mm256_and_si256(B, m)));
+  _mm256_storeu_si256(&S[2], _mm256_add_epi32(_mm256_loadu_si256(&S[2]), _mm256_and_si256(C, m)));
+  _mm256_storeu_si256(&S[3], _mm256_add_epi32(_mm256_loadu_si256(&S[3]), _mm256_and_si256(D, m)));
+  _mm256_storeu_si256(&S[4], _mm256_add_epi32(_mm256_loadu_si256(&S[4]), _mm256_and_si256(E, m)));
+
+  /* -Os builds do not insert this, and legacy SSE code after dirty upper halves is slow */
+  _mm256_zeroupper();
+}
+
+
+/*
+ * AVX-512F, 16 lanes: rotates and the boolean functions map to single
+ * vprold / vpternlogd instructions, and lane masking to a masked add.
+ */
+#define ROL512(x, n)     _mm512_rol_epi32((x), (n))
+#define CH512(b, c, d)   _mm512_ternarylogic_epi32((b), (c), (d), 0xCA)
+#define PAR512(b, c, d)  _mm512_ternarylogic_epi32((b), (c), (d), 0x96)
+#define MAJ512(b, c, d)  _mm512_ternarylogic_epi32((b), (c), (d), 0xE8)
+
+#define ROUND512(a, b, c, d, e, F, k, t)                                                \
+  do                                                                                    \
+  {                                                                                     \
+    if ((t) >= 16)                                                                      \
+    {                                                                                   \
+      W[(t) & 15] = ROL512(_mm512_ternarylogic_epi32(W[((t) - 3) & 15], W[((t) - 8) & 15], \
+                                                     _mm512_xor_si512(W[((t) - 14) & 15], W[(t) & 15]), 0x96), 1); \
+    }                                                                                   \
+    e = _mm512_add_epi32(e, _mm512_add_epi32(ROL512(a, 5), F(b, c, d)));                \
+    e = _mm512_add_epi32(e, _mm512_add_epi32(W[(t) & 15], k));                          \
+    b = ROL512(b, 30);                                                                  \
+  } while (0)
+
+#define ROUNDS512x5(F, k, t)                  \
+  do                                          \
+  {                                           \
+    ROUND512(A, B, C, D, E, F, k, (t) + 0);   \
+    ROUND512(E, A, B, C, D, F, k, (t) + 1);   \
+    ROUND512(D, E, A, B, C, F, k, (t) + 2);   \
+    ROUND512(C, D, E, A, B, F, k, (t) + 3);   \
+    ROUND512(B, C, D, E, A, F, k, (t) + 4);   \
+  } while (0)
+
+__attribute__((target("avx512f,avx2")))
+void sha1_mb_compress_avx512(uint32_t* state, const uint8_t* const* blocks, uint32_t mask)
+{
+  const __mmask16 m = (__mmask16)mask;
+  __m256i lo[8], hi[8];
+  __m512i W[16];
+  __m512i A, B, C, D, E, k;
+  __m512i* S = (__m512i*)state;
+  unsigned t, h;
+
+  /* Lanes 0-7 and 8-15 are transposed separately and joined per word */
+  for (h = 0; h < 2; ++h)
+  {
+    _load8(lo, &blocks[0], h);
+    _load8(hi, &blocks[8], h);
+    for (t = 0; t < 8; ++t)
+    {
+      W[8 * h + t] = _mm512_inserti64x4(_mm512_castsi256_si512(lo[t]), hi[t], 1);
+    }
+  }
+
+  A = _mm512_loadu_si512(&S[0]);
+  B = _mm512_loadu_si512(&S[1]);
+  C = _mm512_loadu_si512(&S[2]);
+  D = _mm512_loadu_si512(&S[3]);
+  E = _mm512_loadu_si512(&S[4]);
+
+  k = _mm512_set1_epi32(K0);
+  for (t = 0; t < 20; t += 5)
+  {
+    ROUNDS512x5(CH512, k, t);
+  }
+  k = _mm512_set1_epi32(K1);
+  for (; t < 40; t += 5)
+  {
+    ROUNDS512x5(PAR512, k, t);
+  }
+  k = _mm512_set1_epi32(K2);
+  for (; t < 60; t += 5)
+  {
+    ROUNDS512x5(MAJ512, k, t);
+  }
+  k = _mm512_set1_epi32(K3);
+  for (; t < 80; t += 5)
+  {
+    ROUNDS512x5(PAR512, k, t);
+  }
+
+  /* Add to the running hash in active lanes only */
+  _mm512_storeu_si512(&S[0], _mm512_mask_add_epi32(_mm512_loadu_si512(&S[0]), m, _mm512_loadu_si512(&S[0]), A));
+  _mm512_storeu_si512(&S[1], _mm512_mask_add_epi32(_mm512_loadu_si512(&S[1]), m, _mm512_loadu_si512(&S[1]), B));
+  _mm512_storeu_si512(&S[2], _mm512_mask_add_epi32(_mm512_loadu_si512(&S[2]), m, _mm512_loadu_si512(&S[2]), C));
+  _mm512_storeu_si512(&S[3], _mm512_mask_add_epi32(_mm512_loadu_si512(&S[3]), m, _mm512_loadu_si512(&S[3]), D));
+  _mm512_storeu_si512(&S[4], _mm512_mask_add_epi32(_mm512_loadu_si512(&S[4]), m, _mm512_loadu_si512(&S[4]), E));
+
+  _mm256_zeroupper();
+}
+
+#endif /* SHA1_X86 */
+
@@ -0,0 +1,102 @@
+/*
+ *  sha1_shani.c
+ *
+ *  Description:
+ *      SHA-1 block compression using the Intel SHA extensions
+ *      (sha1rnds4, sha1nexte, sha1msg1, sha1msg2).
+ *
+ *      Each sha1rnds4 performs four rounds on the packed ABCD state;
+ *      E is carried in the top lane of a second register and folded
+ *      into the next four schedule words by sha1nexte.  The message
+ *      schedule is produced four words at a time by sha1msg1/sha1msg2,
+ *      running a few groups ahead of the rounds that consume it.
+ *
+ *      Only selected at run time when CPUID reports SHA, SSSE3 and
+ *      SSE4.1 support.
+ *
+ */
+
+#include "sha1_internal.h"
+
+#ifdef SHA1_X86
+
+#include <immintrin.h>
+
+/*
+ * Four rounds, group 'g' (rounds 4g .. 4g+3) for g >= 1.  Ea holds E for
+ * this group, Eb receives ABCD to derive E for the next one.  M[g & 3]
+ * holds W[4g .. 4g+3]; the other message registers are advanced only
+ * while their result is still needed by a later group.
+ */
+#define ROUNDS4(g, Ea, Eb, Mg, Mg1, Mg2, Mg3)                           \
+  do                                                                    \
+  {                                                                     \
+    Ea = _mm_sha1nexte_epu32(Ea, Mg);                                   \
+    Eb = ABCD;                                                          \
+    if ((g) >= 3 && (g) <= 18) { Mg1 = _mm_sha1msg2_epu32(Mg1, Mg); }   \
+    ABCD = _mm_sha1rnds4_epu32(ABCD, Ea, (g) / 5);                      \
+    if ((g) <= 16) { Mg3 = _mm_sha1msg1_epu32(Mg3, Mg); }               \
+    if ((g) >= 2 && (g) <= 17) { Mg2 = _mm_xor_si128(Mg2, Mg); }        \
+  } while (0)
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void sha1_compress_shani(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks)
+{
+  const __m128i BSWAP = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+  __m128i M0, M1, M2, M3;
+
+  ABCD = _mm_loadu_si128((const __m128i*)Intermediate_Hash);
+  ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+  E0   = _mm_set_epi32((int)Intermediate_Hash[4], 0, 0, 0);
+
+  while (nblocks != 0)
+  {
+    ABCD_SAVE = ABCD;
+    E0_SAVE   = E0;
+
+    M0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks +  0)), BSWAP);
+    M1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16)), BSWAP);
+    M2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 32)), BSWAP);
+    M3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 48)), BSWAP);
+
+    /* Rounds 0-3: E is added directly, there is no previous A to rotate */
+    E0   = _mm_add_epi32(E0, M0);
+    E1   = ABCD;
+    ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+    ROUNDS4( 1, E1, E0, M1, M2, M3, M0);
+    ROUNDS4( 2, E0, E1, M2, M3, M0, M1);
+    ROUNDS4( 3, E1, E0, M3, M0, M1, M2);
+    ROUNDS4( 4, E0, E1, M0, M1, M2, M3);
+    ROUNDS4( 5, E1, E0, M1, M2, M3, M0);
+    ROUNDS4( 6, E0, E1, M2, M3, M0, M1);
+    ROUNDS4( 7, E1, E0, M3, M0, M1, M2);
+    ROUNDS4( 8, E0, E1, M0, M1, M2, M3);
+    ROUNDS4( 9, E1, E0, M1, M2, M3, M0);
+    ROUNDS4(10, E0, E1, M2, M3, M0, M1);
+    ROUNDS4(11, E1, E0, M3, M0, M1, M2);
+    ROUNDS4(12, E0, E1, M0, M1, M2, M3);
+    ROUNDS4(13, E1, E0, M1, M2, M3, M0);
+    ROUNDS4(14, E0, E1, M2, M3, M0, M1);
+    ROUNDS4(15, E1, E0, M3, M0, M1, M2);
+    ROUNDS4(16, E0, E1, M0, M1, M2, M3);
+    ROUNDS4(17, E1, E0, M1, M2, M3, M0);
+    ROUNDS4(18, E0, E1, M2, M3, M0, M1);
+    ROUNDS4(19, E1, E0, M3, M0, M1, M2);
+
+    /* Add this block's result to the running hash */
+    E0   = _mm_sha1nexte_epu32(E0, E0_SAVE);
+    ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+
+    blocks  += 64;
+    nblocks -= 1;
+  }
+
+  ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+  _mm_storeu_si128((__m128i*)Intermediate_Hash, ABCD);
+  Intermediate_Hash[4] = (uint32_t)_mm_extract_epi32(E0, 3);
+}
+
+#endif /* SHA1_X86 */
+
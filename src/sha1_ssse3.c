@@ -0,0 +1,228 @@
+/*
+ *  sha1_ssse3.c
+ *
+ *  Description:
+ *      SHA-1 block compression with a vectorized message schedule, for
+ *      x86 CPUs without the SHA extensions.
+ *
+ *      The rounds themselves stay scalar, but the big-endian loads are
+ *      done with pshufb and W[16..79] is computed four words at a time:
+ *
+ *        t < 32:   W[t] = rol1(W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16])
+ *                  the fourth word depends on the first one of the same
+ *                  vector and is patched afterwards;
+ *        t >= 32:  W[t] = rol2(W[t-6] ^ W[t-16] ^ W[t-28] ^ W[t-32])
+ *                  which has no dependency inside a vector.
+ *
+ *      W[t] + K is written to a small buffer four rounds ahead of the
+ *      round that reads it, so the vector and scalar work interleave.
+ *
+ *      The AVX2 variant computes the schedules of two consecutive blocks
+ *      in the two 128-bit halves of a ymm register: the second block's
+ *      schedule is ready by the time the first block's rounds are done.
+ *
+ */
+
+#include "sha1_internal.h"
+
+#ifdef SHA1_X86
+
+#include <immintrin.h>
+
+#define K0 0x5A827999
+#define K1 0x6ED9EBA1
+#define K2 0x8F1BBCDC
+#define K3 0xCA62C1D6
+
+#define ROL(x, n)     (((x) << (n)) | ((x) >> (32 - (n))))
+#define F1(b, c, d)   ((((c) ^ (d)) & (b)) ^ (d))
+#define F2(b, c, d)   ((b) ^ (c) ^ (d))
+#define F3(b, c, d)   (((b) & (c)) | (((b) | (c)) & (d)))
+
+#define R(a, b, c, d, e, F, t)                          \
+  do                                                    \
+  {                                                     \
+    e += ROL(a, 5) + F(b, c, d) + wk[t];                \
+    b  = ROL(b, 30);                                    \
+  } while (0)
+
+/*
+ * Twenty rounds starting at round 't', with the schedule for the group of
+ * four rounds 16 positions ahead computed before each group.  A..E are
+ * renamed through the five round invocations instead of being moved.
+ */
+#define ROUNDS20(F, t, SCHED)                                                   \
+  do                                                                            \
+  {                                                                             \
+    SCHED((t) / 4 + 4);                                                         \
+    R(A, B, C, D, E, F, (t) +  0); R(E, A, B, C, D, F, (t) +  1);               \
+    R(D, E, A, B, C, F, (t) +  2); R(C, D, E, A, B, F, (t) +  3);               \
+    SCHED((t) / 4 + 5);                                                         \
+    R(B, C, D, E, A, F, (t) +  4); R(A, B, C, D, E, F, (t) +  5);               \
+    R(E, A, B, C, D, F, (t) +  6); R(D, E, A, B, C, F, (t) +  7);               \
+    SCHED((t) / 4 + 6);                                                         \
+    R(C, D, E, A, B, F, (t) +  8); R(B, C, D, E, A, F, (t) +  9);               \
+    R(A, B, C, D, E, F, (t) + 10); R(E, A, B, C, D, F, (t) + 11);               \
+    SCHED((t) / 4 + 7);                                                         \
+    R(D, E, A, B, C, F, (t) + 12); R(C, D, E, A, B, F, (t) + 13);               \
+    R(B, C, D, E, A, F, (t) + 14); R(A, B, C, D, E, F, (t) + 15);               \
+    SCHED((t) / 4 + 8);                                                         \
+    R(E, A, B, C, D, F, (t) + 16); R(D, E, A, B, C, F, (t) + 17);               \
+    R(C, D, E, A, B, F, (t) + 18); R(B, C, D, E, A, F, (t) + 19);               \
+  } while (0)
+
+#define ROUNDS80(SCHED)                                 \
+  do                                                    \
+  {                                                     \
+    A = Intermediate_Hash[0];                           \
+    B = Intermediate_Hash[1];                           \
+    C = Intermediate_Hash[2];                           \
+    D = Intermediate_Hash[3];                           \
+    E = Intermediate_Hash[4];                           \
+    ROUNDS20(F1,  0, SCHED);                            \
+    ROUNDS20(F2, 20, SCHED);                            \
+    ROUNDS20(F3, 40, SCHED);                            \
+    ROUNDS20(F2, 60, SCHED);                            \
+    Intermediate_Hash[0] += A;                          \
+    Intermediate_Hash[1] += B;                          \
+    Intermediate_Hash[2] += C;                          \
+    Intermediate_Hash[3] += D;                          \
+    Intermediate_Hash[4] += E;                          \
+  } while (0)
+
+#define NO_SCHED(g)   do { } while (0)
+
+
+/*
+ * SSSE3: one block, W[4g .. 4g+3] in V[g]
+ */
+#define SCHED128(g)                                                                             \
+  do                                                                                            \
+  {                                                                                             \
+    if ((g) < 20)                                                                               \
+    {                                                                                           \
+      __m128i x, y;                                                                             \
+      if ((g) < 8)                                                                              \
+      {                                                                                         \
+        x = _mm_xor_si128(_mm_xor_si128(V[((g) - 4) & 31], _mm_alignr_epi8(V[((g) - 3) & 31], V[((g) - 4) & 31], 8)), \
+                          _mm_xor_si128(V[((g) - 2) & 31], _mm_srli_si128(V[((g) - 1) & 31], 4))); \
+        x = _mm_or_si128(_mm_slli_epi32(x, 1), _mm_srli_epi32(x, 31));                          \
+        y = _mm_slli_si128(x, 12);                                                              \
+        x = _mm_xor_si128(x, _mm_or_si128(_mm_slli_epi32(y, 1), _mm_srli_epi32(y, 31)));        \
+      }                                                                                         \
+      else                                                                                      \
+      {                                                                                         \
+        x = _mm_xor_si128(_mm_xor_si128(V[((g) - 8) & 31], V[((g) - 7) & 31]),                  \
+                          _mm_xor_si128(V[((g) - 4) & 31], _mm_alignr_epi8(V[((g) - 1) & 31], V[((g) - 2) & 31], 8))); \
+        x = _mm_or_si128(_mm_slli_epi32(x, 2), _mm_srli_epi32(x, 30));                          \
+      }                                                                                         \
+      V[(g) & 31] = x;                                                                          \
+      _mm_storeu_si128((__m128i*)&wk[4 * (g)], _mm_add_epi32(x, _mm_set1_epi32((int)Kg[(g) / 5]))); \
+    }                                                                                           \
+  } while (0)
+
+__attribute__((target("ssse3")))
+void sha1_compress_ssse3(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks)
+{
+  static const uint32_t Kg[4] = { K0, K1, K2, K3 };
+  const __m128i BSWAP = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  uint32_t A, B, C, D, E;
+  uint32_t wk[80];
+  __m128i  V[32];
+  unsigned g;
+
+  while (nblocks != 0)
+  {
+    for (g = 0; g < 4; ++g)
+    {
+      V[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16 * g)), BSWAP);
+      _mm_storeu_si128((__m128i*)&wk[4 * g], _mm_add_epi32(V[g], _mm_set1_epi32(K0)));
+    }
+
+    ROUNDS80(SCHED128);
+
+    blocks  += 64;
+    nblocks -= 1;
+  }
+}
+
+
+/*
+ * AVX2: two blocks, W[4g .. 4g+3] of the first block in the low half of
+ * V[g] and of the second block in the high half
+ */
+#define SCHED256(g)                                                                             \
+  do                                                                                            \
+  {                                                                                             \
+    if ((g) < 20)                                                                               \
+    {                                                                                           \
+      __m256i x, y;                                                                             \
+      if ((g) < 8)                                                                              \
+      {                                                                                         \
+        x = _mm256_xor_si256(_mm256_xor_si256(V[((g) - 4) & 31], _mm256_alignr_epi8(V[((g) - 3) & 31], V[((g) - 4) & 31], 8)), \
+                             _mm256_xor_si256(V[((g) - 2) & 31], _mm256_srli_si256(V[((g) - 1) & 31], 4))); \
+        x = _mm256_or_si256(_mm256_slli_epi32(x, 1), _mm256_srli_epi32(x, 31));                 \
+        y = _mm256_slli_si256(x, 12);                                                           \
+        x = _mm256_xor_si256(x, _mm256_or_si256(_mm256_slli_epi32(y, 1), _mm256_srli_epi32(y, 31))); \
+      }                                                                                         \
+      else                                                                                      \
+      {                                                                                         \
+        x = _mm256_xor_si256(_mm256_xor_si256(V[((g) - 8) & 31], V[((g) - 7) & 31]),            \
+                             _mm256_xor_si256(V[((g) - 4) & 31], _mm256_alignr_epi8(V[((g) - 1) & 31], V[((g) - 2) & 31], 8))); \
+        x = _mm256_or_si256(_mm256_slli_epi32(x, 2), _mm256_srli_epi32(x, 30));                 \
+      }                                                                                         \
+      V[(g) & 31] = x;                                                                          \
+      x = _mm256_add_epi32(x, _mm256_set1_epi32((int)Kg[(g) / 5]));                             \
+      _mm_storeu_si128((__m128i*)&wk[4 * (g)],  _mm256_castsi256_si128(x));                     \
+      _mm_storeu_si128((__m128i*)&wk2[4 * (g)], _mm256_extracti128_si256(x, 1));                \
+    }                                                                                           \
+  } while (0)
+
+__attribute__((target("avx2")))
+void sha1_compress_avx2(uint32_t Intermediate_Hash[5], const uint8_t* blocks, size_t nblocks)
+{
+  static const uint32_t Kg[4] = { K0, K1, K2, K3 };
+  const __m256i BSWAP = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  uint32_t A, B, C, D, E;
+  uint32_t wk1[80], wk2[80];
+  uint32_t* wk;
+  __m256i  V[32];
+  __m256i  x;
+  unsigned g;
+
+  while (nblocks >= 2)
+  {
+    for (g = 0; g < 4; ++g)
+    {
+      x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(blocks + 16 * g))),
+                                  _mm_loadu_si128((const __m128i*)(blocks + 64 + 16 * g)), 1);
+      V[g] = _mm256_shuffle_epi8(x, BSWAP);
+      x = _mm256_add_epi32(V[g], _mm256_set1_epi32(K0));
+      _mm_storeu_si128((__m128i*)&wk1[4 * g], _mm256_castsi256_si128(x));
+      _mm_storeu_si128((__m128i*)&wk2[4 * g], _mm256_extracti128_si256(x, 1));
+    }
+
+    /* First block's rounds, both schedules computed alongside */
+    wk = wk1;
+    ROUNDS80(SCHED256);
+
+    /* Second block's schedule is complete */
+    wk = wk2;
+    ROUNDS80(NO_SCHED);
+
+    blocks  += 128;
+    nblocks -= 2;
+  }
+
+  /* -Os builds do not insert this, and legacy SSE code after dirty upper halves is slow */
+  _mm256_zeroupper();
+
+  if (nblocks != 0)
+  {
+    sha1_compress_ssse3(Intermediate_Hash, blocks, nblocks);
+  }
+}
+
+#endif /* SHA1_X86 */
+
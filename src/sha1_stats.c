@@ -0,0 +1,282 @@
+/*
+ *  sha1_stats.c
+ *
+ *  Description:
+ *      Counters behind sha1_stats.h, compiled in with -DSHA1_STATS.
+ *
+ *      Every thread that hashes gets its own block of counters on first
+ *      use, linked into a global list.  Only the owning thread writes
+ *      it, with relaxed atomic loads and stores (no locked read-modify-
+ *      write), so the hot paths pay a few plain adds.  A snapshot takes
+ *      the list mutex and reads all blocks.  When a thread exits, its
+ *      counts are folded into a retired total and the block is freed.
+ *
+ *      sha1_stats_reset() does not write other threads' blocks: it
+ *      records the current totals as a baseline that snapshots
+ *      subtract.
+ *
+ */
+
+#include <string.h>
+#include "sha1.h"
+#include "sha1_internal.h"
+#include "sha1_stats.h"
+
+#ifdef SHA1_STATS
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct _counters
+{
+  uint64_t input_calls;
+  uint64_t input_bytes;
+  uint64_t input_sizes[SHA1_STATS_BUCKETS];
+  uint64_t blocks[SHA1_STATS_BACKENDS];
+  uint64_t mb_blocks[SHA1_STATS_BACKENDS];
+  uint64_t hmac_calls;
+  uint64_t hmac_bytes;
+  uint64_t hmac_sizes[SHA1_STATS_BUCKETS];
+  uint64_t hmac_ns[SHA1_STATS_BUCKETS];
+};
+
+#define NCOUNTERS (sizeof(struct _counters) / sizeof(uint64_t))
+
+struct _thread
+{
+  struct _counters  counters;
+  struct _thread*   next;
+};
+
+static pthread_mutex_t  _lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t   _once = PTHREAD_ONCE_INIT;
+static pthread_key_t    _key;
+static struct _thread*  _threads;       /* live threads, under _lock        */
+static struct _counters _retired;       /* exited threads, under _lock      */
+static struct _counters _baseline;      /* totals at the last reset         */
+
+static __thread struct _thread* _mine;
+
+
+/* single writer: a plain add, published with a relaxed store */
+static inline void _add(uint64_t* counter, uint64_t value)
+{
+  __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+/* log2 bucket: 0 for 0, else 1 + index of the highest set bit */
+static inline unsigned _bucket(uint64_t value)
+{
+  return (value == 0) ? 0 : 64 - (unsigned)__builtin_clzll(value);
+}
+
+static void _sum(struct _counters* total, const struct _counters* c)
+{
+  uint64_t*       t = (uint64_t*)total;
+  const uint64_t* s = (const uint64_t*)c;
+  size_t i;
+
+  for (i = 0; i < NCOUNTERS; ++i)
+  {
+    t[i] += __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+  }
+}
+
+/* thread exit: fold the counts into _retired and drop the block */
+static void _detach(void* arg)
+{
+  struct _thread*  thread = arg;
+  struct _thread** p;
+
+  pthread_mutex_lock(&_lock);
+  for (p = &_threads; *p != 0; p = &(*p)->next)
+  {
+    if (*p == thread)
+    {
+      *p = thread->next;
+      break;
+    }
+  }
+  _sum(&_retired, &thread->counters);
+  pthread_mutex_unlock(&_lock);
+
+  _mine = 0;
+  free(thread);
+}
+
+static void _init(void)
+{
+  pthread_key_create(&_key, _detach);
+}
+
+/* first use on this thread: allocate and register its counters */
+static struct _thread* _attach(void)
+{
+  struct _thread* thread;
+
+  pthread_once(&_once, _init);
+  thread = calloc(1, sizeof(*thread));
+  if (thread == 0)
+  {
+    return 0;
+  }
+
+  pthread_mutex_lock(&_lock);
+  thread->next = _threads;
+  _threads = thread;
+  pthread_mutex_unlock(&_lock);
+
+  pthread_setspecific(_key, thread);
+  _mine = thread;
+  return thread;
+}
+
+static inline struct _counters* _local(void)
+{
+  struct _thread* thread = _mine;
+
+  if (__builtin_expect(thread == 0, 0))
+  {
+    thread = _attach();
+    if (thread == 0)
+    {
+      return 0;
+    }
+  }
+  return &thread->counters;
+}
+
+/* totals of all threads, exited or not, under _lock */
+static void _total(struct _counters* total)
+{
+  struct _thread* thread;
+
+  *total = _retired;
+  for (thread = _threads; thread != 0; thread = thread->next)
+  {
+    _sum(total, &thread->counters);
+  }
+}
+
+
+void sha1_stats_input(uint64_t length)
+{
+  struct _counters* c = _local();
+
+  if (c != 0)
+  {
+    _add(&c->input_calls, 1);
+    _add(&c->input_bytes, length);
+    _add(&c->input_sizes[_bucket(length)], 1);
+  }
+}
+
+void sha1_stats_blocks(unsigned backend, size_t nblocks)
+{
+  struct _counters* c = _local();
+
+  if (    (c != 0)
+       && (backend < SHA1_STATS_BACKENDS))
+  {
+    _add(&c->blocks[backend], nblocks);
+  }
+}
+
+void sha1_stats_mb_blocks(const struct sha1_mb_kernel* kernel, size_t nblocks)
+{
+  struct _counters* c = _local();
+  int k = sha1_mb_kernel_index(kernel);
+
+  if (    (c != 0)
+       && (k >= 0)
+       && (k < SHA1_STATS_BACKENDS))
+  {
+    _add(&c->mb_blocks[k], nblocks);
+  }
+}
+
+void sha1_stats_hmac(size_t length, uint64_t ns)
+{
+  struct _counters* c = _local();
+
+  if (c != 0)
+  {
+    _add(&c->hmac_calls, 1);
+    _add(&c->hmac_bytes, length);
+    _add(&c->hmac_sizes[_bucket(length)], 1);
+    _add(&c->hmac_ns[_bucket(ns)], 1);
+  }
+}
+
+uint64_t sha1_stats_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+
+int sha1_stats_snapshot(struct sha1_stats* stats)
+{
+  struct _counters total;
+  uint64_t*       t = (uint64_t*)&total;
+  const uint64_t* b = (const uint64_t*)&_baseline;
+  size_t i;
+
+  if (stats == 0)
+  {
+    return shaNull;
+  }
+
+  pthread_mutex_lock(&_lock);
+  _total(&total);
+  for (i = 0; i < NCOUNTERS; ++i)
+  {
+    t[i] -= b[i];
+  }
+  pthread_mutex_unlock(&_lock);
+
+  stats->input_calls = total.input_calls;
+  stats->input_bytes = total.input_bytes;
+  memcpy(stats->input_sizes, total.input_sizes, sizeof(stats->input_sizes));
+  for (i = 0; i < SHA1_STATS_BACKENDS; ++i)
+  {
+    stats->backends[i] = sha1_backend_name((unsigned)i);
+    stats->blocks[i]   = total.blocks[i];
+    stats->mb_kernels[i] = sha1_mb_kernel_name((unsigned)i);
+    stats->mb_blocks[i]  = total.mb_blocks[i];
+  }
+  stats->hmac_calls = total.hmac_calls;
+  stats->hmac_bytes = total.hmac_bytes;
+  memcpy(stats->hmac_sizes, total.hmac_sizes, sizeof(stats->hmac_sizes));
+  memcpy(stats->hmac_ns,    total.hmac_ns,    sizeof(stats->hmac_ns));
+
+  return shaSuccess;
+}
+
+void sha1_stats_reset(void)
+{
+  pthread_mutex_lock(&_lock);
+  _total(&_baseline);
+  pthread_mutex_unlock(&_lock);
+}
+
+#else /* SHA1_STATS */
+
+int sha1_stats_snapshot(struct sha1_stats* stats)
+{
+  if (stats == 0)
+  {
+    return shaNull;
+  }
+  memset(stats, 0, sizeof(*stats));
+  return shaBadParam;
+}
+
+void sha1_stats_reset(void)
+{
+}
+
+#endif /* SHA1_STATS */
@@ -0,0 +1,64 @@
+/*
+ *  sha1_stats.h
+ *
+ *  Description:
+ *      Optional instrumentation of the SHA-1 hot paths: calls and
+ *      octets through sha1_input(), blocks compressed per single-stream
+ *      backend and per multi-buffer kernel, and calls, octets and
+ *      latency of hmac_sha1() / hmac_sha1_with_key(), with log2
+ *      histograms of message sizes and latencies.
+ *
+ *      A block is counted once: the serial multi-buffer kernel runs on
+ *      the single-stream backend, but its blocks count for the kernel.
+ *
+ *      Compiled in only with -DSHA1_STATS (for every source file of the
+ *      library).  Without it the hooks are empty macros and
+ *      sha1_stats_snapshot() reports shaBadParam.
+ *
+ *      Counters are kept per thread, so hashing threads never write
+ *      shared memory; a snapshot adds up all threads, including those
+ *      that have exited.
+ *
+ */
+
+#ifndef _SHA1_STATS_H_
+#define _SHA1_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA1_STATS_BUCKETS   65     /* bucket 0: value 0, bucket i: [2^(i-1), 2^i) */
+#define SHA1_STATS_BACKENDS  8
+
+struct sha1_stats
+{
+  uint64_t    input_calls;                      /* sha1_input() calls               */
+  uint64_t    input_bytes;
+  uint64_t    input_sizes[SHA1_STATS_BUCKETS];  /* octets per sha1_input() call     */
+
+  const char* backends[SHA1_STATS_BACKENDS];    /* compiled-in backends, 0 past the end */
+  uint64_t    blocks[SHA1_STATS_BACKENDS];      /* blocks compressed by backends[i] */
+
+  const char* mb_kernels[SHA1_STATS_BACKENDS];  /* compiled-in multi-buffer kernels, 0 past the end */
+  uint64_t    mb_blocks[SHA1_STATS_BACKENDS];   /* lane blocks compressed by mb_kernels[i] */
+
+  uint64_t    hmac_calls;                       /* hmac_sha1() and hmac_sha1_with_key() */
+  uint64_t    hmac_bytes;
+  uint64_t    hmac_sizes[SHA1_STATS_BUCKETS];   /* message octets per call          */
+  uint64_t    hmac_ns[SHA1_STATS_BUCKETS];      /* nanoseconds per call             */
+};
+
+/*
+ * Sum of the counters of all threads.  Counts of threads that are
+ * hashing at the time may be a few calls behind.
+ *
+ * Returns sha Error Code: shaNull for a missing buffer, shaBadParam if
+ * the library was built without SHA1_STATS (stats is zeroed).
+ */
+int sha1_stats_snapshot(struct sha1_stats* stats);
+
+/* Zero all counters */
+void sha1_stats_reset(void);
+
+
+#endif /* #ifndef _SHA1_STATS_H_ */
@@ -0,0 +1,402 @@
+/*
+ *  sha1_tree.c
+ *
+ *  Description:
+ *      HMAC-SHA1 tree mode and its manifest, see sha1_tree.h.
+ *
+ *      Chunks are handed out one at a time from a shared counter: a
+ *      chunk is large (SHA1_TREE_CHUNK suggests 1 MB), so the atomic
+ *      increment is noise and no thread idles while another still has
+ *      a backlog.  Nodes and the root are single-block MACs of 41 and 37
+ *      octets, cheap next to the chunks, and are computed on the calling
+ *      thread afterwards.
+ *
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_tree.h"
+#include "sha1_internal.h"
+
+#define TAG_LEAF    0x00
+#define TAG_NODE    0x01
+#define TAG_ROOT    0x02
+
+#define HASH_ID     1                   /* manifest hash field: HMAC-SHA1 */
+
+static const uint8_t _magic[8] = { 'H', 'M', 'A', 'C', 'T', 'R', 'E', 'E' };
+
+struct _tree_job
+{
+  const struct hmac_sha1_key* key;
+  const uint8_t*              data;
+  uint64_t                    length;
+  uint64_t                    chunk_size;
+  size_t                      count;
+  uint8_t                   (*leaves)[SHA1HashSize];
+  size_t                      next;     /* next chunk to MAC, atomic */
+};
+
+
+/* octets in chunk 'index' */
+static size_t _chunk_len(uint64_t length, uint64_t chunk_size, uint64_t index)
+{
+  uint64_t start = index * chunk_size;
+
+  return (size_t)((length - start < chunk_size) ? (length - start) : chunk_size);
+}
+
+/* top of the tree over leaves[0 .. n-1], n >= 1 */
+static void _top(const struct hmac_sha1_key* key, const uint8_t (*leaves)[SHA1HashSize], size_t n,
+                 uint8_t top[SHA1HashSize])
+{
+  uint8_t msg[1 + 2 * SHA1HashSize];
+  size_t k;
+
+  if (n == 1)
+  {
+    memcpy(top, leaves[0], SHA1HashSize);
+    return;
+  }
+
+  k = 1;
+  while (2 * k < n)
+  {
+    k *= 2;
+  }
+
+  msg[0] = TAG_NODE;
+  _top(key, leaves, k, msg + 1);
+  _top(key, leaves + k, n - k, msg + 1 + SHA1HashSize);
+  hmac_sha1_with_key(key, msg, sizeof(msg), top);
+}
+
+static void* _worker_main(void* arg)
+{
+  struct _tree_job* job = arg;
+  size_t i;
+
+  while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->count)
+  {
+    sha1_tree_leaf(job->key, i, job->data + i * job->chunk_size,
+                   _chunk_len(job->length, job->chunk_size, i), job->leaves[i]);
+  }
+  return 0;
+}
+
+
+/*
+ *  sha1_tree_count
+ *
+ *  Description:
+ *      Number of chunks, an empty object has one.
+ *
+ */
+size_t sha1_tree_count(uint64_t length, uint64_t chunk_size)
+{
+  uint64_t n;
+
+  if (    (chunk_size == 0)
+       || ((chunk_size & 63) != 0))
+  {
+    return 0;
+  }
+
+  n = (length == 0) ? 1 : (length - 1) / chunk_size + 1;
+  if (n > (SIZE_MAX - SHA1_TREE_HEADER) / SHA1HashSize)
+  {
+    return 0;
+  }
+  return (size_t)n;
+}
+
+/*
+ *  sha1_tree_leaf
+ *
+ *  Description:
+ *      HMAC of the leaf prefix and index followed by the chunk, without
+ *      copying the chunk.
+ *
+ */
+int sha1_tree_leaf(const struct hmac_sha1_key* key, uint64_t index, const uint8_t* chunk, size_t len,
+                   uint8_t tag[SHA1HashSize])
+{
+  uint8_t head[9];
+  struct iovec iov[2];
+
+  if (    (key == 0)
+       || (tag == 0)
+       || ((chunk == 0) && (len != 0)))
+  {
+    return shaNull;
+  }
+
+  head[0] = TAG_LEAF;
+  sha_put64(head + 1, index);
+  iov[0].iov_base = head;
+  iov[0].iov_len  = sizeof(head);
+  iov[1].iov_base = (void*)chunk;
+  iov[1].iov_len  = len;
+
+  return hmac_sha1v(key, iov, (len != 0) ? 2 : 1, tag);
+}
+
+/*
+ *  sha1_tree_root
+ *
+ *  Description:
+ *      Combines the leaf tags into the root tag.
+ *
+ */
+int sha1_tree_root(const struct hmac_sha1_key* key, uint64_t length, uint64_t chunk_size,
+                   const uint8_t (*leaves)[SHA1HashSize], uint8_t root[SHA1HashSize])
+{
+  uint8_t msg[1 + 8 + 8 + SHA1HashSize];
+  size_t n;
+
+  if (    (key == 0)
+       || (leaves == 0)
+       || (root == 0))
+  {
+    return shaNull;
+  }
+
+  n = sha1_tree_count(length, chunk_size);
+  if (n == 0)
+  {
+    return shaBadParam;
+  }
+
+  msg[0] = TAG_ROOT;
+  sha_put64(msg + 1, length);
+  sha_put64(msg + 9, chunk_size);
+  _top(key, leaves, n, msg + 17);
+  hmac_sha1_with_key(key, msg, sizeof(msg), root);
+
+  return shaSuccess;
+}
+
+/*
+ *  sha1_tree_mac
+ *
+ *  Description:
+ *      MACs the chunks on a pool of threads, then combines them.
+ *
+ */
+int sha1_tree_mac(const struct hmac_sha1_key* key, const uint8_t* data, uint64_t length, uint64_t chunk_size,
+                  unsigned nthreads, uint8_t (*leaves)[SHA1HashSize], uint8_t root[SHA1HashSize])
+{
+  struct _tree_job job;
+  pthread_t* threads;
+  int*       started;
+  long       ncpu;
+  unsigned   i;
+  int        err;
+
+  if (    (key == 0)
+       || (root == 0)
+       || ((data == 0) && (length != 0)))
+  {
+    return shaNull;
+  }
+
+  job.count = sha1_tree_count(length, chunk_size);
+  if (    (job.count == 0)
+       || (length > SIZE_MAX))
+  {
+    return shaBadParam;
+  }
+
+  job.key        = key;
+  job.data       = data;
+  job.length     = length;
+  job.chunk_size = chunk_size;
+  job.leaves     = (leaves != 0) ? leaves : malloc(job.count * SHA1HashSize);
+  job.next       = 0;
+  if (job.leaves == 0)
+  {
+    return shaBadParam;
+  }
+
+  if (nthreads == 0)
+  {
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (ncpu > 0) ? (unsigned)ncpu : 1;
+  }
+  if (nthreads > job.count)
+  {
+    nthreads = (unsigned)job.count;
+  }
+
+  /* if there is no memory for the pool, the calling thread does it all */
+  threads = malloc(nthreads * sizeof(pthread_t));
+  started = malloc(nthreads * sizeof(int));
+  if (    (threads == 0)
+       || (started == 0))
+  {
+    nthreads = 1;
+  }
+  for (i = 1; i < nthreads; ++i)
+  {
+    started[i] = (pthread_create(&threads[i], 0, _worker_main, &job) == 0);
+  }
+
+  _worker_main(&job);
+
+  for (i = 1; i < nthreads; ++i)
+  {
+    if (started[i])
+    {
+      pthread_join(threads[i], 0);
+    }
+  }
+  free(threads);
+  free(started);
+
+  err = sha1_tree_root(key, length, chunk_size, (const uint8_t (*)[SHA1HashSize])job.leaves, root);
+  if (leaves == 0)
+  {
+    free(job.leaves);
+  }
+  return err;
+}
+
+/*
+ *  sha1_tree_manifest_size
+ *
+ *  Description:
+ *      Header plus one tag per chunk.
+ *
+ */
+size_t sha1_tree_manifest_size(uint64_t length, uint64_t chunk_size)
+{
+  size_t n = sha1_tree_count(length, chunk_size);
+
+  return (n == 0) ? 0 : SHA1_TREE_HEADER + n * SHA1HashSize;
+}
+
+/*
+ *  sha1_tree_manifest_write
+ *
+ *  Description:
+ *      Serializes the header, root and leaf tags, big-endian.
+ *
+ */
+int sha1_tree_manifest_write(uint8_t* manifest, uint64_t length, uint64_t chunk_size,
+                             const uint8_t (*leaves)[SHA1HashSize], const uint8_t root[SHA1HashSize])
+{
+  size_t n;
+
+  if (    (manifest == 0)
+       || (leaves == 0)
+       || (root == 0))
+  {
+    return shaNull;
+  }
+
+  n = sha1_tree_count(length, chunk_size);
+  if (n == 0)
+  {
+    return shaBadParam;
+  }
+
+  memcpy(manifest, _magic, sizeof(_magic));
+  memset(manifest + 8, 0, 8);
+  manifest[11] = SHA1_TREE_VERSION;
+  manifest[15] = HASH_ID;
+  sha_put64(manifest + 16, length);
+  sha_put64(manifest + 24, chunk_size);
+  memcpy(manifest + 32, root, SHA1HashSize);
+  memcpy(manifest + SHA1_TREE_HEADER, leaves, n * SHA1HashSize);
+
+  return shaSuccess;
+}
+
+/*
+ *  sha1_tree_manifest_read
+ *
+ *  Description:
+ *      Checks magic, version, hash and size, and points 'tree'
+ *      into the buffer.
+ *
+ */
+int sha1_tree_manifest_read(uint8_t* manifest, size_t size, struct sha1_tree* tree)
+{
+  if (    (manifest == 0)
+       || (tree == 0))
+  {
+    return shaNull;
+  }
+
+  if (    (size < SHA1_TREE_HEADER)
+       || (memcmp(manifest, _magic, sizeof(_magic)) != 0)
+       || (sha_get32(manifest + 8) != SHA1_TREE_VERSION)
+       || (sha_get32(manifest + 12) != HASH_ID))
+  {
+    return shaBadParam;
+  }
+
+  tree->length     = sha_get64(manifest + 16);
+  tree->chunk_size = sha_get64(manifest + 24);
+  tree->count      = sha1_tree_count(tree->length, tree->chunk_size);
+  if (    (tree->count == 0)
+       || (size != SHA1_TREE_HEADER + tree->count * SHA1HashSize))
+  {
+    return shaBadParam;
+  }
+  tree->root   = manifest + 32;
+  tree->leaves = (uint8_t (*)[SHA1HashSize])(manifest + SHA1_TREE_HEADER);
+
+  return shaSuccess;
+}
+
+/*
+ *  sha1_tree_verify
+ *
+ *  Description:
+ *      Recomputes the root from the leaf tags and compares.
+ *
+ */
+int sha1_tree_verify(const struct hmac_sha1_key* key, const struct sha1_tree* tree)
+{
+  uint8_t root[SHA1HashSize];
+
+  if (    (key == 0)
+       || (tree == 0)
+       || (tree->root == 0)
+       || (sha1_tree_count(tree->length, tree->chunk_size) != tree->count)
+       || (sha1_tree_root(key, tree->length, tree->chunk_size,
+                          (const uint8_t (*)[SHA1HashSize])tree->leaves, root) != shaSuccess))
+  {
+    return 0;
+  }
+  return sha_equal(root, tree->root, SHA1HashSize);
+}
+
+/*
+ *  sha1_tree_verify_chunk
+ *
+ *  Description:
+ *      Recomputes one leaf tag and compares.
+ *
+ */
+int sha1_tree_verify_chunk(const struct hmac_sha1_key* key, const struct sha1_tree* tree, uint64_t index,
+                           const uint8_t* chunk, size_t len)
+{
+  uint8_t tag[SHA1HashSize];
+
+  if (    (tree == 0)
+       || (tree->leaves == 0)
+       || (index >= tree->count)
+       || (len != _chunk_len(tree->length, tree->chunk_size, index))
+       || (sha1_tree_leaf(key, index, chunk, len, tag) != shaSuccess))
+  {
+    return 0;
+  }
+  return sha_equal(tag, tree->leaves[index], SHA1HashSize);
+}
@@ -0,0 +1,135 @@
+/*
+ *  sha1_tree.h
+ *
+ *  Description:
+ *      Tree mode of HMAC-SHA1 for very large objects: the object is cut
+ *      into fixed-size chunks that are authenticated independently, on
+ *      all cores, and the chunk tags are combined into one root tag.
+ *      A manifest keeps the chunk tags, so a modified chunk is re-MACed
+ *      or checked on its own without reading the rest of the object.
+ *
+ *      The tree tag is a different function from hmac_sha1() of the
+ *      whole object; both sides have to use the tree mode.
+ *
+ *      Definition, for key K, an object of 'length' octets and chunks of
+ *      'chunk_size' octets (a multiple of 64), all integers big-endian:
+ *
+ *          n       = max(1, ceil(length / chunk_size)) chunks; the last
+ *                    one may be short, an empty object has one empty chunk
+ *          leaf i  = HMAC(K, 0x00 || uint64(i) || chunk i)
+ *          node    = HMAC(K, 0x01 || left || right)
+ *          top     = tree over leaf 0 .. n-1: a single leaf is its own
+ *                    top; otherwise, with k the largest power of two
+ *                    below n, node(top of leaves 0 .. k-1,
+ *                              top of leaves k .. n-1)
+ *          root    = HMAC(K, 0x02 || uint64(length) || uint64(chunk_size) || top)
+ *
+ *      The prefixes keep leaves, nodes and the root apart, the index
+ *      pins each chunk to its place, and the root commits to the object
+ *      length and chunk size.
+ *
+ *      Manifest, SHA1_TREE_HEADER + 20 * n octets, integers big-endian:
+ *
+ *          offset  size
+ *               0     8   magic "HMACTREE"
+ *               8     4   format version, SHA1_TREE_VERSION
+ *              12     4   hash: 1 = HMAC-SHA1
+ *              16     8   length of the object
+ *              24     8   chunk_size
+ *              32    20   root tag
+ *              52  20*n   leaf tags 0 .. n-1
+ *
+ *      A manifest is trusted only after sha1_tree_verify(): the root
+ *      tag, under the key, authenticates every leaf tag in it.
+ *
+ *      Needs POSIX threads (build with -pthread).
+ *
+ */
+
+#ifndef _SHA1_TREE_H_
+#define _SHA1_TREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha1.h"
+#include "hmac.h"
+
+#define SHA1_TREE_CHUNK     (1u << 20)  /* suggested chunk size */
+#define SHA1_TREE_VERSION   1
+#define SHA1_TREE_HEADER    52          /* manifest octets before the leaf tags */
+
+/*
+ * A manifest read with sha1_tree_manifest_read(): root and leaves point
+ * into the manifest buffer, so tags written through them update it.
+ */
+struct sha1_tree
+{
+  uint64_t  length;
+  uint64_t  chunk_size;
+  size_t    count;                      /* leaf tags */
+  uint8_t*  root;
+  uint8_t (*leaves)[SHA1HashSize];
+};
+
+/* Chunks of a 'length' octet object, 0 if chunk_size is not a nonzero multiple of 64 */
+size_t sha1_tree_count(uint64_t length, uint64_t chunk_size);
+
+/*
+ * Leaf tag of chunk 'index' (its len octets).
+ *
+ * Returns sha Error Code: shaNull for missing buffers.
+ */
+int sha1_tree_leaf(const struct hmac_sha1_key* key, uint64_t index, const uint8_t* chunk, size_t len,
+                   uint8_t tag[SHA1HashSize]);
+
+/*
+ * Root tag over the sha1_tree_count(length, chunk_size) leaf tags, e.g.
+ * after replacing the leaves of modified chunks.
+ *
+ * Returns sha Error Code: shaNull for missing buffers, shaBadParam for a
+ * bad chunk_size.
+ */
+int sha1_tree_root(const struct hmac_sha1_key* key, uint64_t length, uint64_t chunk_size,
+                   const uint8_t (*leaves)[SHA1HashSize], uint8_t root[SHA1HashSize]);
+
+/*
+ * Tree tag of data[0 .. length-1]: the chunks are MACed on 'nthreads'
+ * threads (0 = one per online CPU), the calling thread included.  The
+ * leaf tags go to 'leaves' (sha1_tree_count() entries) if it is not 0.
+ *
+ * Returns sha Error Code: shaNull for missing buffers, shaBadParam for a
+ * bad chunk_size or if out of memory.
+ */
+int sha1_tree_mac(const struct hmac_sha1_key* key, const uint8_t* data, uint64_t length, uint64_t chunk_size,
+                  unsigned nthreads, uint8_t (*leaves)[SHA1HashSize], uint8_t root[SHA1HashSize]);
+
+/* Octets of the manifest of such an object, 0 for a bad chunk_size */
+size_t sha1_tree_manifest_size(uint64_t length, uint64_t chunk_size);
+
+/*
+ * Write the manifest (sha1_tree_manifest_size() octets).
+ *
+ * Returns sha Error Code: shaNull for missing buffers, shaBadParam for a
+ * bad chunk_size.
+ */
+int sha1_tree_manifest_write(uint8_t* manifest, uint64_t length, uint64_t chunk_size,
+                             const uint8_t (*leaves)[SHA1HashSize], const uint8_t root[SHA1HashSize]);
+
+/*
+ * Parse the 'size' octet manifest into 'tree'.  Checks the format only,
+ * not the tags.
+ *
+ * Returns sha Error Code: shaNull for missing buffers, shaBadParam for a
+ * malformed manifest.
+ */
+int sha1_tree_manifest_read(uint8_t* manifest, size_t size, struct sha1_tree* tree);
+
+/* 1 if the root tag of 'tree' matches its leaf tags under 'key', else 0 (constant time) */
+int sha1_tree_verify(const struct hmac_sha1_key* key, const struct sha1_tree* tree);
+
+/* 1 if chunk 'index' of a verified tree has length len and matches its leaf tag, else 0 */
+int sha1_tree_verify_chunk(const struct hmac_sha1_key* key, const struct sha1_tree* tree, uint64_t index,
+                           const uint8_t* chunk, size_t len);
+
+
+#endif /* #ifndef _SHA1_TREE_H_ */
@@ -0,0 +1,711 @@
+/*
+ *  sha256.c
+ *
+ *  Description:
+ *      This file implements the Secure Hashing Algorithm SHA-256 as
+ *      defined in FIPS PUB 180-4.
+ *
+ *      SHA-256 produces a 256-bit message digest.  The message
+ *      handling (buffering, padding, length counting, error states)
+ *      follows sha1.c line for line; only the compression function and
+ *      the state size differ.
+ *
+ * Caveats:
+ *     SHA-256 is designed to work with messages less than 2^64 bits
+ *     long.  This implementation only works with messages with a
+ *     length that is a multiple of the size of an 8-bit character.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "sha256.h"
+#include "sha256_internal.h"
+
+/* Local Function Prototyptes */
+static void     _absorb(struct sha256*, const uint8_t* message_array, size_t length);
+static void     _pad_block(struct sha256*);
+static void     _process_block(uint32_t Intermediate_Hash[8], const uint8_t* block);
+static void     _compress_scalar(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks);
+static int      _resolve(void);
+
+/*
+ * Block compression backends, fastest first, picked as in sha1.c.
+ * SHA256_BACKEND=<name> in the environment overrides the choice.
+ */
+static const struct
+{
+  const char*        name;
+  sha256_compress_fn compress;
+  unsigned           features;
+} _backends[] =
+{
+#ifdef SHA1_X86
+  { "shani",  sha256_compress_shani, SHA1_CPU_SHANI | SHA1_CPU_SSE41 | SHA1_CPU_SSSE3 },
+#endif
+  { "scalar", _compress_scalar,      0                                                },
+};
+
+#define NBACKENDS (sizeof(_backends) / sizeof(*_backends))
+
+/* Index of the backend in use, -1 until resolved; published atomically as in sha1.c */
+static int _current = -1;
+
+static inline int _backend(void)
+{
+  int i = __atomic_load_n(&_current, __ATOMIC_ACQUIRE);
+
+  return __builtin_expect(i < 0, 0) ? _resolve() : i;
+}
+
+static inline void _compress(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks)
+{
+  _backends[_backend()].compress(Intermediate_Hash, blocks, nblocks);
+}
+
+/* Constants defined in SHA-256, shared with the backends */
+const uint32_t sha256_K[64] =
+{
+  0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+  0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+  0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+  0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+  0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+  0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+  0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+  0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+/* SHA-256 circular right shift */
+static uint32_t _rotr(const uint32_t nbits, const uint32_t word)
+{
+  return ((word >> nbits) | (word << (32 - nbits)));
+}
+
+/*
+ * sha256_reset
+ *
+ * Description:
+ *     This function will initialize the SHA-256 context in preparation
+ *     for computing a new message digest.
+ *
+ * Parameters:
+ *     context: [in/out]
+ *         The context to reset.
+ *
+ * Returns:
+ *     sha Error Code.
+ *
+ */
+int sha256_reset(struct sha256* context)
+{
+  if (context == 0)
+  {
+    return shaNull;
+  }
+
+  context->Length               = 0;
+  context->Message_Block_Index  = 0;
+
+  context->Intermediate_Hash[0] = 0x6A09E667;
+  context->Intermediate_Hash[1] = 0xBB67AE85;
+  context->Intermediate_Hash[2] = 0x3C6EF372;
+  context->Intermediate_Hash[3] = 0xA54FF53A;
+  context->Intermediate_Hash[4] = 0x510E527F;
+  context->Intermediate_Hash[5] = 0x9B05688C;
+  context->Intermediate_Hash[6] = 0x1F83D9AB;
+  context->Intermediate_Hash[7] = 0x5BE0CD19;
+
+  context->flags = 0;
+
+  return shaSuccess;
+}
+
+/*
+ * sha256_clone
+ *
+ * Description:
+ *     This function will copy the SHA-256-context src, including a partial
+ *     block not yet compressed, into dst.  Both can then be continued
+ *     independently, e.g. with different endings of a message whose
+ *     common beginning was hashed once into src.  Only the buffered
+ *     octets of the message block are copied.
+ *
+ * Parameters:
+ *     dst: [out]
+ *         The context to overwrite.
+ *     src: [in]
+ *         The context to copy.
+ *
+ * Returns:
+ *     sha Error Code.
+ *
+ */
+int sha256_clone(struct sha256* dst, const struct sha256* src)
+{
+  uint32_t i;
+
+  if ((dst == 0) || (src == 0))
+  {
+    return shaNull;
+  }
+
+  for (i = 0; i < 8; ++i)
+  {
+    dst->Intermediate_Hash[i] = src->Intermediate_Hash[i];
+  }
+  memcpy(dst->Message_Block, src->Message_Block, src->Message_Block_Index);
+  dst->Length              = src->Length;
+  dst->Message_Block_Index = src->Message_Block_Index;
+  dst->flags               = src->flags;
+
+  return shaSuccess;
+}
+
+/*
+ * sha256_result
+ *
+ * Description:
+ *     This function will return the 256-bit message digest into the
+ *     Message_Digest array provided by the caller.
+ *
+ * Parameters:
+ *     context: [in/out]
+ *         The context to use to calculate the SHA-256 hash.
+ *     Message_Digest: [out]
+ *         Where the digest is returned.
+ *
+ * Returns:
+ *     sha Error Code.
+ *
+ */
+int sha256_result(struct sha256* context, uint8_t Message_Digest[SHA256HashSize])
+{
+  int i;
+
+  if (    (context == 0)
+       || (Message_Digest == 0))
+  {
+    return shaNull;
+  }
+
+  if ((context->flags & FLAG_CORRUPTED) != 0)
+  {
+    return shaStateError;
+  }
+
+  if ((context->flags & FLAG_COMPUTED) == 0)
+  {
+    _pad_block(context);
+
+    /* message may be sensitive, clear it out */
+    memset(context->Message_Block, 0, sizeof(context->Message_Block));
+    context->Length = 0;        /* and clear length */
+    context->flags |= FLAG_COMPUTED;
+  }
+
+  for (i = 0; i < SHA256HashSize; ++i)
+  {
+    Message_Digest[i] = (context->Intermediate_Hash[i >> 2] >> (8 * (3 - (i & 0x03))));
+  }
+
+  return shaSuccess;
+}
+
+/*
+ * Add 'length' octets to the message without touching the bit counter:
+ * only octets that complete a partially filled block are copied, whole
+ * blocks are compressed straight from the caller's buffer.
+ */
+static void _absorb(struct sha256* context, const uint8_t* message_array, size_t length)
+{
+  size_t fill;
+
+  /* Top up a partially filled block first */
+  if (context->Message_Block_Index != 0)
+  {
+    fill = 64 - context->Message_Block_Index;
+    if (fill > length)
+    {
+      fill = length;
+    }
+    memcpy(&context->Message_Block[context->Message_Block_Index], message_array, fill);
+    context->Message_Block_Index += (uint16_t)fill;
+    message_array += fill;
+    length -= fill;
+
+    if (context->Message_Block_Index == 64)
+    {
+      _compress(context->Intermediate_Hash, context->Message_Block, 1);
+      context->Message_Block_Index = 0;
+    }
+  }
+
+  /* Whole blocks are compressed straight from the caller's buffer */
+  if (length >= 64)
+  {
+    _compress(context->Intermediate_Hash, message_array, length / 64);
+    message_array += length & ~(size_t)63;
+    length &= 63;
+  }
+
+  /* Buffer the tail */
+  if (length != 0)
+  {
+    memcpy(context->Message_Block, message_array, length);
+    context->Message_Block_Index = (uint16_t)length;
+  }
+
+}
+
+/*
+ *  sha256_input
+ *
+ *  Description:
+ *      This function accepts an array of octets as the next portion
+ *      of the message.
+ *
+ *  Parameters:
+ *      context: [in/out]
+ *          The SHA context to update
+ *      message_array: [in]
+ *          An array of characters representing the next portion of
+ *          the message.
+ *      length: [in]
+ *          The length of the message in message_array
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha256_input(struct sha256* context, const uint8_t* message_array, size_t length)
+{
+  uint64_t room;
+  int      corrupted = 0;
+
+  if (length == 0)
+  {
+    return shaSuccess;
+  }
+
+  if (    (context == 0)
+       || (message_array == 0))
+  {
+    return shaNull;
+  }
+
+  if ((context->flags & FLAG_COMPUTED) != 0)
+  {
+    context->flags |= FLAG_CORRUPTED;
+    return shaStateError;
+  }
+
+  if ((context->flags & FLAG_CORRUPTED) != 0)
+  {
+    return shaStateError;
+  }
+
+  /* Bit counter overflow is handled as in sha1_input() */
+  room = (0 - context->Length) >> 3;
+  if (    (room != 0)
+       && (length >= room))
+  {
+    length = (size_t)room;
+    corrupted = 1;
+  }
+  context->Length += ((uint64_t)length) << 3;
+
+  _absorb(context, message_array, length);
+
+  if (corrupted)
+  {
+    /* Message is too long */
+    context->flags |= FLAG_CORRUPTED;
+  }
+
+  return shaSuccess;
+}
+
+/*
+ *  sha256_inputv
+ *
+ *  Description:
+ *      This function accepts the next portion of the message as a
+ *      list of buffers, hashed as if they had been concatenated.
+ *      Only the octets of a block that straddles two buffers are
+ *      copied; whole blocks inside a buffer are compressed in place.
+ *
+ *  Parameters:
+ *      context: [in/out]
+ *          The SHA context to update
+ *      iov: [in]
+ *          The buffers, in message order.
+ *      iovcnt: [in]
+ *          The number of buffers.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha256_inputv(struct sha256* context, const struct iovec* iov, int iovcnt)
+{
+  uint64_t room;
+  uint64_t total = 0;
+  size_t   length;
+  int      corrupted = 0;
+  int      i;
+
+  if (    (context == 0)
+       || ((iov == 0) && (iovcnt > 0)))
+  {
+    return shaNull;
+  }
+
+  if (iovcnt < 0)
+  {
+    return shaBadParam;
+  }
+
+  for (i = 0; i < iovcnt; ++i)
+  {
+    if ((iov[i].iov_base == 0) && (iov[i].iov_len != 0))
+    {
+      return shaNull;
+    }
+    total += iov[i].iov_len;
+  }
+
+  if (total == 0)
+  {
+    return shaSuccess;
+  }
+
+  if ((context->flags & FLAG_COMPUTED) != 0)
+  {
+    context->flags |= FLAG_CORRUPTED;
+    return shaStateError;
+  }
+
+  if ((context->flags & FLAG_CORRUPTED) != 0)
+  {
+    return shaStateError;
+  }
+
+  /* One bit counter update for all buffers, overflow as in sha256_input() */
+  room = (0 - context->Length) >> 3;
+  if (    (room != 0)
+       && (total >= room))
+  {
+    total = room;
+    corrupted = 1;
+  }
+  context->Length += total << 3;
+
+  for (i = 0; total != 0; ++i)
+  {
+    length = (iov[i].iov_len < total) ? iov[i].iov_len : (size_t)total;
+    _absorb(context, (const uint8_t*)iov[i].iov_base, length);
+    total -= length;
+  }
+
+  if (corrupted)
+  {
+    /* Message is too long */
+    context->flags |= FLAG_CORRUPTED;
+  }
+
+  return shaSuccess;
+}
+
+/*
+ *  _process_block
+ *
+ *  Description:
+ *      This function will process the next 512 bits of the message.
+ *      The message schedule is kept in a rolling window of 16 words.
+ *
+ *  Parameters:
+ *      Intermediate_Hash: [in/out]
+ *          The running message digest.
+ *      block: [in]
+ *          64 octets of message to compress.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Many of the variable names in this code, especially the
+ *      single character names, were used because those were the
+ *      names used in the publication.
+ *
+ */
+static void _process_block(uint32_t Intermediate_Hash[8], const uint8_t* block)
+{
+  uint32_t t;                       /* Loop counter                */
+  uint32_t T1, T2;                  /* Temporary word values       */
+  uint32_t W[16];                   /* Word sequence, rolling      */
+  uint32_t A, B, C, D, E, F, G, H;  /* Word buffers                */
+  uint32_t s0, s1;
+
+  for (t = 0; t < 16; ++t)
+  {
+    W[t]  = ((uint32_t)block[t * 4 + 0]) << 24;
+    W[t] |= ((uint32_t)block[t * 4 + 1]) << 16;
+    W[t] |= ((uint32_t)block[t * 4 + 2]) << 8;
+    W[t] |= ((uint32_t)block[t * 4 + 3]) << 0;
+  }
+
+  A = Intermediate_Hash[0];
+  B = Intermediate_Hash[1];
+  C = Intermediate_Hash[2];
+  D = Intermediate_Hash[3];
+  E = Intermediate_Hash[4];
+  F = Intermediate_Hash[5];
+  G = Intermediate_Hash[6];
+  H = Intermediate_Hash[7];
+
+  for (t = 0; t < 64; ++t)
+  {
+    if (t >= 16)
+    {
+      s0 = _rotr( 7, W[(t + 1) & 15]) ^ _rotr(18, W[(t + 1) & 15]) ^ (W[(t + 1) & 15] >>  3);
+      s1 = _rotr(17, W[(t + 14) & 15]) ^ _rotr(19, W[(t + 14) & 15]) ^ (W[(t + 14) & 15] >> 10);
+      W[t & 15] += s0 + W[(t + 9) & 15] + s1;
+    }
+
+    T1 = H + (_rotr(6, E) ^ _rotr(11, E) ^ _rotr(25, E)) + ((E & F) ^ (~E & G)) + sha256_K[t] + W[t & 15];
+    T2 = (_rotr(2, A) ^ _rotr(13, A) ^ _rotr(22, A)) + ((A & B) ^ (A & C) ^ (B & C));
+    H = G;
+    G = F;
+    F = E;
+    E = D + T1;
+    D = C;
+    C = B;
+    B = A;
+    A = T1 + T2;
+  }
+
+  Intermediate_Hash[0] += A;
+  Intermediate_Hash[1] += B;
+  Intermediate_Hash[2] += C;
+  Intermediate_Hash[3] += D;
+  Intermediate_Hash[4] += E;
+  Intermediate_Hash[5] += F;
+  Intermediate_Hash[6] += G;
+  Intermediate_Hash[7] += H;
+}
+
+/* Store a message length in bits as the big-endian last 8 octets of a block */
+static void _store_length(uint8_t* block, uint64_t bits)
+{
+  block[56] = (uint8_t)(bits >> 56);
+  block[57] = (uint8_t)(bits >> 48);
+  block[58] = (uint8_t)(bits >> 40);
+  block[59] = (uint8_t)(bits >> 32);
+  block[60] = (uint8_t)(bits >> 24);
+  block[61] = (uint8_t)(bits >> 16);
+  block[62] = (uint8_t)(bits >>  8);
+  block[63] = (uint8_t)(bits >>  0);
+}
+
+/*
+ * _pad_block
+ *
+ * Description:
+ *     Pads the message to a multiple of 512 bits as in sha1.c: a single
+ *     '1' bit, zeros, and the 64-bit message length, compressing the
+ *     final block(s).
+ *
+ * Parameters:
+ *     context: [in/out]
+ *         The context to pad
+ * Returns:
+ *     Nothing.
+ *
+ */
+static void _pad_block(struct sha256* context)
+{
+  uint16_t index = context->Message_Block_Index;
+
+  /* a second block if the length does not fit; zero runs a word at a time */
+  context->Message_Block[index++] = 0x80;
+  if (index > 56)
+  {
+    memset(context->Message_Block + index, 0, 64 - index);
+    _compress(context->Intermediate_Hash, context->Message_Block, 1);
+    index = 0;
+  }
+  memset(context->Message_Block + index, 0, 56 - index);
+
+  /*
+   * Store the message length as the last 8 bytes
+   */
+  _store_length(context->Message_Block, context->Length);
+
+  _compress(context->Intermediate_Hash, context->Message_Block, 1);
+  context->Message_Block_Index = 0;
+}
+
+/*
+ *  sha256_digest_block
+ *
+ *  Description:
+ *      SHA-256 counterpart of sha1_digest_block(): finishes a message
+ *      whose remaining 'len' <= 55 octets fit one padded block.
+ *
+ */
+void sha256_digest_block(const uint32_t state[8], uint64_t prefix, const uint8_t* msg, size_t len, uint8_t digest[SHA256HashSize])
+{
+  uint32_t block[16];               /* padding template, zeroed a word at a time */
+  uint32_t H[8];
+  uint8_t* p = (uint8_t*)block;
+  uint32_t i;
+
+  for (i = 0; i < 16; ++i)
+  {
+    block[i] = 0;
+  }
+  for (i = 0; i < 8; ++i)
+  {
+    H[i] = state[i];
+  }
+
+  if (len != 0)
+  {
+    memcpy(p, msg, len);
+  }
+  p[len] = 0x80;
+  _store_length(p, (prefix + len) << 3);
+
+  _compress(H, p, 1);
+
+  /* message may be sensitive, clear it out */
+  sha_clear(block, sizeof(block));
+
+  for (i = 0; i < 8; ++i)
+  {
+    digest[4 * i + 0] = (uint8_t)(H[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(H[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(H[i] >>  8);
+    digest[4 * i + 3] = (uint8_t)(H[i] >>  0);
+  }
+}
+
+
+
+/*
+ *  _compress_scalar
+ *
+ *  Description:
+ *      Portable backend: runs _process_block over consecutive blocks.
+ *
+ */
+static void _compress_scalar(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks)
+{
+  while (nblocks != 0)
+  {
+    _process_block(Intermediate_Hash, blocks);
+    blocks  += 64;
+    nblocks -= 1;
+  }
+}
+
+/*
+ *  sha256_compress
+ *
+ *  Description:
+ *      Compresses whole blocks with the backend in use, for the other
+ *      modules of the library.
+ *
+ */
+void sha256_compress(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks)
+{
+  _compress(Intermediate_Hash, blocks, nblocks);
+}
+
+/* Index of the backend called 'name', or of the best supported one if name is 0 */
+static int _find_backend(const char* name)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
+
+  for (i = 0; i < NBACKENDS; ++i)
+  {
+    if (    ((_backends[i].features & features) == _backends[i].features)
+         && (    (name == 0)
+              || (strcmp(name, _backends[i].name) == 0)))
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/*
+ *  _resolve
+ *
+ *  Description:
+ *      Picks the backend on first use and publishes its index.
+ *
+ */
+static int _resolve(void)
+{
+  const char* name = getenv("SHA256_BACKEND");
+  int i = -1;
+
+  if (name != 0)
+  {
+    i = _find_backend(name);
+  }
+  if (i < 0)
+  {
+    i = _find_backend(0);
+  }
+
+  __atomic_store_n(&_current, i, __ATOMIC_RELEASE);
+  return i;
+}
+
+const char* sha256_backend(void)
+{
+  return _backends[_backend()].name;
+}
+
+const char* sha256_backend_at(unsigned index)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
+
+  for (i = 0; i < NBACKENDS; ++i)
+  {
+    if ((_backends[i].features & features) == _backends[i].features)
+    {
+      if (index == 0)
+      {
+        return _backends[i].name;
+      }
+      index -= 1;
+    }
+  }
+  return 0;
+}
+
+int sha256_set_backend(const char* name)
+{
+  int i;
+
+  if (name == 0)
+  {
+    return shaNull;
+  }
+
+  i = _find_backend(name);
+  if (i < 0)
+  {
+    return shaBadParam;
+  }
+
+  __atomic_store_n(&_current, i, __ATOMIC_RELEASE);
+  return shaSuccess;
+}
@@ -0,0 +1,74 @@
+/*
+ *  sha256.h
+ *
+ *  Description:
+ *      This is the header file for code which implements the Secure
+ *      Hashing Algorithm SHA-256 as defined in FIPS PUB 180-4.
+ *
+ *      The interface mirrors sha1.h: same context layout, same error
+ *      codes, same backend selection.
+ *
+ *      Please read the file sha256.c for more information.
+ *
+ */
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha1.h"                   /* sha Error Codes and context flags */
+
+#define SHA256HashSize 32
+
+/*
+ * Data structure holding contextual information about the SHA-256 hash
+ */
+struct sha256
+{
+  uint8_t  Message_Block[64];       /* 512-bit message blocks         */
+  uint32_t Intermediate_Hash[8];    /* Message Digest                 */
+  uint64_t Length;                  /* Message length in bits         */
+  uint16_t Message_Block_Index;     /* Index into message block array */
+  uint8_t  flags;
+};
+
+
+
+/*
+ * Public API
+ */
+struct iovec;                       /* <sys/uio.h> */
+
+int sha256_reset (struct sha256* context);
+int sha256_clone (struct sha256* dst, const struct sha256* src);
+int sha256_input (struct sha256* context, const uint8_t* message_array, size_t length);
+int sha256_inputv(struct sha256* context, const struct iovec* iov, int iovcnt);
+int sha256_result(struct sha256* context, uint8_t Message_Digest[SHA256HashSize]);
+
+/*
+ * Block compression backend selection, as for SHA-1 ("shani" or
+ * "scalar"); SHA256_BACKEND=<name> in the environment overrides it.
+ */
+const char* sha256_backend    (void);
+const char* sha256_backend_at (unsigned index);
+int         sha256_set_backend(const char* name);
+
+/*
+ * Multi-buffer hashing of n independent messages, one message per SIMD
+ * lane (8 lanes with AVX2; serial on CPUs with SHA-NI, which is faster,
+ * or without AVX2).
+ * SHA256_MB_BACKEND=<name> in the environment overrides the kernel choice.
+ */
+int         sha256_multi(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*digests)[SHA256HashSize]);
+const char* sha256_mb_backend    (void);
+const char* sha256_mb_backend_at (unsigned index);
+int         sha256_mb_set_backend(const char* name);
+
+/* SHA-256 counterpart of sha1_multi_from(): suffixes of one absorbed prefix */
+int         sha256_multi_from(const struct sha256* prefix, const uint8_t* const* msgs, const size_t* lens, size_t n,
+                              uint8_t (*digests)[SHA256HashSize]);
+
+
+
+#endif /* #ifndef _SHA256_H_ */
@@ -0,0 +1,52 @@
+/*
+ *  sha256_internal.h
+ *
+ *  Description:
+ *      Interface between sha256.c and its block compression backends,
+ *      the SHA-256 counterpart of sha1_internal.h (whose CPU feature
+ *      detection and multi-buffer scheduler it shares).  Not part of the
+ *      public API.
+ *
+ */
+
+#ifndef _SHA256_INTERNAL_H_
+#define _SHA256_INTERNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha1_internal.h"
+
+/* Round constants K0 .. K63 */
+extern const uint32_t sha256_K[64];
+
+typedef void (*sha256_compress_fn)(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks);
+
+/* Compress whole blocks with the single-stream backend in use */
+void sha256_compress(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks);
+
+/* SHA-256 counterpart of sha1_digest_block(): len <= 55 octets, one compression */
+void sha256_digest_block(const uint32_t state[8], uint64_t prefix, const uint8_t* msg, size_t len, uint8_t digest[32]);
+
+#ifdef SHA1_X86
+void sha256_compress_shani(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks);
+#endif
+
+
+/*
+ * Multi-buffer kernels use the SHA-1 kernel description, with eight
+ * state words per lane: word i of lane l is state[i * lanes + l].
+ */
+const struct sha1_mb_kernel* sha256_mb_kernel(void);
+
+#ifdef SHA1_X86
+void sha256_mb_compress_avx2(uint32_t* state, const uint8_t* const* blocks, uint32_t mask);
+#endif
+
+/* SHA-256 counterpart of sha1_mb_hash(); iv == 0 means the standard initial value */
+void sha256_mb_hash(const uint32_t iv[8], uint64_t prefix,
+                    const uint8_t* head, size_t headlen,
+                    const uint8_t* const* msgs, const size_t* lens, size_t n,
+                    uint8_t (*digests)[32]);
+
+
+#endif /* #ifndef _SHA256_INTERNAL_H_ */
@@ -0,0 +1,234 @@
+/*
+ *  sha256_mb.c
+ *
+ *  Description:
+ *      Multi-buffer SHA-256: hashes many independent messages at once,
+ *      one per lane of the AVX2 kernel (8 lanes).  Lanes are fed by the
+ *      scheduler shared with SHA-1 (sha_mb_hash() in sha1_mb.c); this
+ *      file only holds the SHA-256 kernels and their selection.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sha256.h"
+#include "sha256_internal.h"
+
+static void _mb_compress_serial(uint32_t* state, const uint8_t* const* blocks, uint32_t mask);
+
+/* Multi-buffer kernels, widest first */
+static const struct sha1_mb_kernel _kernels[] =
+{
+#ifdef SHA1_X86
+  { "avx2",    8, sha256_mb_compress_avx2, SHA1_CPU_AVX2   },
+#endif
+  { "serial",  4, _mb_compress_serial,     0               },
+};
+
+#define NKERNELS (sizeof(_kernels) / sizeof(*_kernels))
+
+static const struct sha1_mb_kernel* _kernel = 0;
+
+static const uint32_t _sha256_iv[8] =
+{
+  0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+
+/*
+ *  _mb_compress_serial
+ *
+ *  Description:
+ *      Fallback kernel without SIMD lanes: compresses the active lanes
+ *      one after the other with the single-stream backend.
+ *
+ */
+static void _mb_compress_serial(uint32_t* state, const uint8_t* const* blocks, uint32_t mask)
+{
+  uint32_t H[8];
+  unsigned l, i;
+
+  for (l = 0; l < 4; ++l)
+  {
+    if (mask & (1u << l))
+    {
+      for (i = 0; i < 8; ++i)
+      {
+        H[i] = state[i * 4 + l];
+      }
+      sha256_compress(H, blocks[l], 1);
+      for (i = 0; i < 8; ++i)
+      {
+        state[i * 4 + l] = H[i];
+      }
+    }
+  }
+}
+
+/*
+ * Index of the kernel called 'name', or of the best supported one if name
+ * is 0.  One SHA-NI stream outruns eight AVX2 lanes of SHA-256, so on CPUs
+ * with the SHA extensions the automatic choice is the serial kernel.
+ */
+static int _find_kernel(const char* name)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
+
+  for (i = 0; i < NKERNELS; ++i)
+  {
+    if (    ((_kernels[i].features & features) == _kernels[i].features)
+         && (    (name != 0)
+              || (_kernels[i].features == 0)
+              || ((features & SHA1_CPU_SHANI) == 0))
+         && (    (name == 0)
+              || (strcmp(name, _kernels[i].name) == 0)))
+    {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/*
+ *  sha256_mb_kernel
+ *
+ *  Description:
+ *      Kernel in use, picked on first use.  SHA256_MB_BACKEND=<name> in
+ *      the environment overrides the choice.
+ *
+ */
+const struct sha1_mb_kernel* sha256_mb_kernel(void)
+{
+  const struct sha1_mb_kernel* kernel = __atomic_load_n(&_kernel, __ATOMIC_ACQUIRE);
+  const char* name;
+  int i = -1;
+
+  if (kernel == 0)
+  {
+    /* threads racing here pick the same kernel, or one set meanwhile */
+    name = getenv("SHA256_MB_BACKEND");
+    if (name != 0)
+    {
+      i = _find_kernel(name);
+    }
+    if (i < 0)
+    {
+      i = _find_kernel(0);
+    }
+    kernel = &_kernels[i];
+    __atomic_store_n(&_kernel, kernel, __ATOMIC_RELEASE);
+  }
+  return kernel;
+}
+
+const char* sha256_mb_backend(void)
+{
+  return sha256_mb_kernel()->name;
+}
+
+const char* sha256_mb_backend_at(unsigned index)
+{
+  unsigned features = sha1_cpu_features();
+  unsigned i;
+
+  for (i = 0; i < NKERNELS; ++i)
+  {
+    if ((_kernels[i].features & features) == _kernels[i].features)
+    {
+      if (index == 0)
+      {
+        return _kernels[i].name;
+      }
+      index -= 1;
+    }
+  }
+  return 0;
+}
+
+int sha256_mb_set_backend(const char* name)
+{
+  int i;
+
+  if (name == 0)
+  {
+    return shaNull;
+  }
+
+  i = _find_kernel(name);
+  if (i < 0)
+  {
+    return shaBadParam;
+  }
+
+  __atomic_store_n(&_kernel, &_kernels[i], __ATOMIC_RELEASE);
+  return shaSuccess;
+}
+
+void sha256_mb_hash(const uint32_t iv[8], uint64_t prefix,
+                    const uint8_t* head, size_t headlen,
+                    const uint8_t* const* msgs, const size_t* lens, size_t n,
+                    uint8_t (*digests)[32])
+{
+  sha_mb_hash(sha256_mb_kernel(), 8, (iv != 0) ? iv : _sha256_iv, prefix, head, headlen, msgs, lens, n, (uint8_t*)digests);
+}
+
+
+/*
+ *  sha256_multi
+ *
+ *  Description:
+ *      Computes the SHA-256 digest of n independent messages, spreading
+ *      them over the lanes of the multi-buffer kernel.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha256_multi(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t (*digests)[SHA256HashSize])
+{
+  int err = sha_mb_check(msgs, lens, n, digests);
+
+  if ((err == shaSuccess) && (n != 0))
+  {
+    sha256_mb_hash(0, 0, 0, 0, msgs, lens, n, digests);
+  }
+
+  return err;
+}
+
+/*
+ *  sha256_multi_from
+ *
+ *  Description:
+ *      SHA-256(P || msgs[i]) for n suffixes of a prefix P already fed
+ *      to 'prefix', without compressing P again; see sha1_multi_from().
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int sha256_multi_from(const struct sha256* prefix, const uint8_t* const* msgs, const size_t* lens, size_t n,
+                      uint8_t (*digests)[SHA256HashSize])
+{
+  int err;
+
+  if (prefix == 0)
+  {
+    return shaNull;
+  }
+
+  if ((prefix->flags & (FLAG_COMPUTED | FLAG_CORRUPTED)) != 0)
+  {
+    return shaStateError;
+  }
+
+  err = sha_mb_check(msgs, lens, n, digests);
+  if ((err == shaSuccess) && (n != 0))
+  {
+    sha256_mb_hash(prefix->Intermediate_Hash, (prefix->Length >> 3) - prefix->Message_Block_Index,
+                   prefix->Message_Block, prefix->Message_Block_Index, msgs, lens, n, digests);
+  }
+
+  return err;
+}
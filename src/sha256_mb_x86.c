@@ -0,0 +1,100 @@
+/*
+ *  sha256_mb_x86.c
+ *
+ *  Description:
+ *      Multi-buffer SHA-256 compression kernel: one 32-bit AVX2 lane per
+ *      message, 8 lanes.  The rounds are the plain FIPS 180-4 ones,
+ *      applied to a vector of A..H values; blocks are loaded and
+ *      transposed as for SHA-1 (sha_mb_x86.h) and fed by the shared
+ *      scheduler in sha1_mb.c.
+ *
+ *      The W[16] ring is updated in place from round 16 on, and A..H are
+ *      renamed through eight round invocations instead of being shifted
+ *      with moves.
+ *
+ */
+
+#include "sha256_internal.h"
+
+#ifdef SHA1_X86
+
+#include <immintrin.h>
+#include "sha_mb_x86.h"
+
+#define ROR256(x, n)     _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+#define CH256(e, f, g)   _mm256_xor_si256(_mm256_and_si256((e), _mm256_xor_si256((f), (g))), (g))
+#define MAJ256(a, b, c)  _mm256_or_si256(_mm256_and_si256((a), (b)), _mm256_and_si256(_mm256_or_si256((a), (b)), (c)))
+#define BSIG0(a)         _mm256_xor_si256(_mm256_xor_si256(ROR256(a,  2), ROR256(a, 13)), ROR256(a, 22))
+#define BSIG1(e)         _mm256_xor_si256(_mm256_xor_si256(ROR256(e,  6), ROR256(e, 11)), ROR256(e, 25))
+#define SSIG0(w)         _mm256_xor_si256(_mm256_xor_si256(ROR256(w,  7), ROR256(w, 18)), _mm256_srli_epi32((w),  3))
+#define SSIG1(w)         _mm256_xor_si256(_mm256_xor_si256(ROR256(w, 17), ROR256(w, 19)), _mm256_srli_epi32((w), 10))
+
+#define ROUND256(a, b, c, d, e, f, g, h, t)                                                     \
+  do                                                                                            \
+  {                                                                                             \
+    if ((t) >= 16)                                                                              \
+    {                                                                                           \
+      W[(t) & 15] = _mm256_add_epi32(_mm256_add_epi32(W[(t) & 15], SSIG0(W[((t) + 1) & 15])),   \
+                                     _mm256_add_epi32(W[((t) + 9) & 15], SSIG1(W[((t) + 14) & 15]))); \
+    }                                                                                           \
+    T1 = _mm256_add_epi32(_mm256_add_epi32(h, BSIG1(e)), CH256(e, f, g));                       \
+    T1 = _mm256_add_epi32(T1, _mm256_add_epi32(W[(t) & 15], _mm256_set1_epi32((int)sha256_K[t]))); \
+    d  = _mm256_add_epi32(d, T1);                                                               \
+    h  = _mm256_add_epi32(T1, _mm256_add_epi32(BSIG0(a), MAJ256(a, b, c)));                     \
+  } while (0)
+
+#define ROUNDS256x8(t)                              \
+  do                                                \
+  {                                                 \
+    ROUND256(A, B, C, D, E, F, G, H, (t) + 0);      \
+    ROUND256(H, A, B, C, D, E, F, G, (t) + 1);      \
+    ROUND256(G, H, A, B, C, D, E, F, (t) + 2);      \
+    ROUND256(F, G, H, A, B, C, D, E, (t) + 3);      \
+    ROUND256(E, F, G, H, A, B, C, D, (t) + 4);      \
+    ROUND256(D, E, F, G, H, A, B, C, (t) + 5);      \
+    ROUND256(C, D, E, F, G, H, A, B, (t) + 6);      \
+    ROUND256(B, C, D, E, F, G, H, A, (t) + 7);      \
+  } while (0)
+
+__attribute__((target("avx2")))
+void sha256_mb_compress_avx2(uint32_t* state, const uint8_t* const* blocks, uint32_t mask)
+{
+  const __m256i lane_bits = _mm256_set_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  __m256i W[16];
+  __m256i A, B, C, D, E, F, G, H, T1, m;
+  __m256i* S = (__m256i*)state;
+  unsigned t;
+
+  _load8(&W[0], blocks, 0);
+  _load8(&W[8], blocks, 1);
+
+  A = _mm256_loadu_si256(&S[0]);
+  B = _mm256_loadu_si256(&S[1]);
+  C = _mm256_loadu_si256(&S[2]);
+  D = _mm256_loadu_si256(&S[3]);
+  E = _mm256_loadu_si256(&S[4]);
+  F = _mm256_loadu_si256(&S[5]);
+  G = _mm256_loadu_si256(&S[6]);
+  H = _mm256_loadu_si256(&S[7]);
+
+  for (t = 0; t < 64; t += 8)
+  {
+    ROUNDS256x8(t);
+  }
+
+  /* Add to the running hash in active lanes only */
+  m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)mask), lane_bits), lane_bits);
+  _mm256_storeu_si256(&S[0], _mm256_add_epi32(_mm256_loadu_si256(&S[0]), _mm256_and_si256(A, m)));
+  _mm256_storeu_si256(&S[1], _mm256_add_epi32(_mm256_loadu_si256(&S[1]), _mm256_and_si256(B, m)));
+  _mm256_storeu_si256(&S[2], _mm256_add_epi32(_mm256_loadu_si256(&S[2]), _mm256_and_si256(C, m)));
+  _mm256_storeu_si256(&S[3], _mm256_add_epi32(_mm256_loadu_si256(&S[3]), _mm256_and_si256(D, m)));
+  _mm256_storeu_si256(&S[4], _mm256_add_epi32(_mm256_loadu_si256(&S[4]), _mm256_and_si256(E, m)));
+  _mm256_storeu_si256(&S[5], _mm256_add_epi32(_mm256_loadu_si256(&S[5]), _mm256_and_si256(F, m)));
+  _mm256_storeu_si256(&S[6], _mm256_add_epi32(_mm256_loadu_si256(&S[6]), _mm256_and_si256(G, m)));
+  _mm256_storeu_si256(&S[7], _mm256_add_epi32(_mm256_loadu_si256(&S[7]), _mm256_and_si256(H, m)));
+
+  /* -Os builds do not insert this, and legacy SSE code after dirty upper halves is slow */
+  _mm256_zeroupper();
+}
+
+#endif /* SHA1_X86 */
@@ -0,0 +1,105 @@
+/*
+ *  sha256_shani.c
+ *
+ *  Description:
+ *      SHA-256 block compression using the Intel SHA extensions
+ *      (sha256rnds2, sha256msg1, sha256msg2).
+ *
+ *      The state is kept as the two registers ABEF and CDGH that
+ *      sha256rnds2 works on; each call does two rounds, so a group of
+ *      four rounds takes two calls, the second one on the upper half of
+ *      W + K.  As in sha1_shani.c the schedule is produced four words at
+ *      a time, a few groups ahead of the rounds that consume it.
+ *
+ *      Only selected at run time when CPUID reports SHA, SSSE3 and
+ *      SSE4.1 support.
+ *
+ */
+
+#include "sha256_internal.h"
+
+#ifdef SHA1_X86
+
+#include <immintrin.h>
+
+/*
+ * Four rounds, group 'g' (rounds 4g .. 4g+3).  Mg holds W[4g .. 4g+3];
+ * Mg1 (the next group's words) is finished with sha256msg2 once the
+ * words it needs exist, and Mgm1 (the previous group's register, free
+ * again) starts the schedule for group g+3 with sha256msg1.
+ */
+#define ROUNDS4(g, Mg, Mgm1, Mg1)                                                     \
+  do                                                                                  \
+  {                                                                                   \
+    MSG    = _mm_add_epi32(Mg, _mm_loadu_si128((const __m128i*)&sha256_K[4 * (g)]));  \
+    CDGH   = _mm_sha256rnds2_epu32(CDGH, ABEF, MSG);                                  \
+    if ((g) >= 3 && (g) <= 14)                                                        \
+    {                                                                                 \
+      Mg1 = _mm_add_epi32(Mg1, _mm_alignr_epi8(Mg, Mgm1, 4));                         \
+      Mg1 = _mm_sha256msg2_epu32(Mg1, Mg);                                            \
+    }                                                                                 \
+    MSG    = _mm_shuffle_epi32(MSG, 0x0E);                                            \
+    ABEF   = _mm_sha256rnds2_epu32(ABEF, CDGH, MSG);                                  \
+    if ((g) >= 1 && (g) <= 12)                                                        \
+    {                                                                                 \
+      Mgm1 = _mm_sha256msg1_epu32(Mgm1, Mg);                                          \
+    }                                                                                 \
+  } while (0)
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void sha256_compress_shani(uint32_t Intermediate_Hash[8], const uint8_t* blocks, size_t nblocks)
+{
+  const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i ABEF, CDGH, ABEF_SAVE, CDGH_SAVE, MSG, TMP;
+  __m128i M0, M1, M2, M3;
+
+  /* A B C D / E F G H -> A B E F / C D G H, highest lane first */
+  TMP  = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&Intermediate_Hash[0]), 0xB1);   /* CDAB */
+  CDGH = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&Intermediate_Hash[4]), 0x1B);   /* EFGH */
+  ABEF = _mm_alignr_epi8(TMP, CDGH, 8);                                                      /* ABEF */
+  CDGH = _mm_blend_epi16(CDGH, TMP, 0xF0);                                                   /* CDGH */
+
+  while (nblocks != 0)
+  {
+    ABEF_SAVE = ABEF;
+    CDGH_SAVE = CDGH;
+
+    M0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks +  0)), BSWAP);
+    M1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16)), BSWAP);
+    M2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 32)), BSWAP);
+    M3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 48)), BSWAP);
+
+    ROUNDS4( 0, M0, M3, M1);
+    ROUNDS4( 1, M1, M0, M2);
+    ROUNDS4( 2, M2, M1, M3);
+    ROUNDS4( 3, M3, M2, M0);
+    ROUNDS4( 4, M0, M3, M1);
+    ROUNDS4( 5, M1, M0, M2);
+    ROUNDS4( 6, M2, M1, M3);
+    ROUNDS4( 7, M3, M2, M0);
+    ROUNDS4( 8, M0, M3, M1);
+    ROUNDS4( 9, M1, M0, M2);
+    ROUNDS4(10, M2, M1, M3);
+    ROUNDS4(11, M3, M2, M0);
+    ROUNDS4(12, M0, M3, M1);
+    ROUNDS4(13, M1, M0, M2);
+    ROUNDS4(14, M2, M1, M3);
+    ROUNDS4(15, M3, M2, M0);
+
+    /* Add this block's result to the running hash */
+    ABEF = _mm_add_epi32(ABEF, ABEF_SAVE);
+    CDGH = _mm_add_epi32(CDGH, CDGH_SAVE);
+
+    blocks  += 64;
+    nblocks -= 1;
+  }
+
+  TMP  = _mm_shuffle_epi32(ABEF, 0x1B);                                                      /* FEBA */
+  CDGH = _mm_shuffle_epi32(CDGH, 0xB1);                                                      /* DCHG */
+  ABEF = _mm_blend_epi16(TMP, CDGH, 0xF0);                                                   /* DCBA */
+  CDGH = _mm_alignr_epi8(CDGH, TMP, 8);                                                      /* HGFE */
+  _mm_storeu_si128((__m128i*)&Intermediate_Hash[0], ABEF);
+  _mm_storeu_si128((__m128i*)&Intermediate_Hash[4], CDGH);
+}
+
+#endif /* SHA1_X86 */
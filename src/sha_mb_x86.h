@@ -0,0 +1,72 @@
+/*
+ *  sha_mb_x86.h
+ *
+ *  Description:
+ *      Block loading shared by the AVX2 / AVX-512 multi-buffer kernels
+ *      of SHA-1 and SHA-256: eight lanes' blocks are read as rows and
+ *      transposed so that vector W[t] holds word t of every lane.
+ *      Only included by the x86 kernel sources.
+ *
+ */
+
+#ifndef _SHA_MB_X86_H_
+#define _SHA_MB_X86_H_
+
+#include <immintrin.h>
+#include <stdint.h>
+
+/* Transpose eight rows of eight 32-bit words */
+__attribute__((target("avx2")))
+static inline void _transpose8(__m256i r[8])
+{
+  __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+  __m256i u0, u1, u2, u3, u4, u5, u6, u7;
+
+  t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+  t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+  t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+  t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+  t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+  u0 = _mm256_unpacklo_epi64(t0, t2);
+  u1 = _mm256_unpackhi_epi64(t0, t2);
+  u2 = _mm256_unpacklo_epi64(t1, t3);
+  u3 = _mm256_unpackhi_epi64(t1, t3);
+  u4 = _mm256_unpacklo_epi64(t4, t6);
+  u5 = _mm256_unpackhi_epi64(t4, t6);
+  u6 = _mm256_unpacklo_epi64(t5, t7);
+  u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/* Load words [8h, 8h+8) of eight lanes' blocks as W vectors, big endian */
+__attribute__((target("avx2")))
+static inline void _load8(__m256i W[8], const uint8_t* const* blocks, unsigned h)
+{
+  const __m256i BSWAP = _mm256_set_epi8(12, 13, 14, 15,  8,  9, 10, 11,  4,  5,  6,  7,  0,  1,  2,  3,
+                                        12, 13, 14, 15,  8,  9, 10, 11,  4,  5,  6,  7,  0,  1,  2,  3);
+  unsigned l;
+
+  for (l = 0; l < 8; ++l)
+  {
+    W[l] = _mm256_loadu_si256((const __m256i*)(blocks[l] + 32 * h));
+  }
+  _transpose8(W);
+  for (l = 0; l < 8; ++l)
+  {
+    W[l] = _mm256_shuffle_epi8(W[l], BSWAP);
+  }
+}
+
+#endif /* #ifndef _SHA_MB_X86_H_ */
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha256.h"
+#include "hmac_sha256.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+
+/*
+ *
+ *  Benchmark:
+ *  ----------
+ *
+ *     bench_sha1 [-f csv|json] [-t seconds] [-s size,size,...]
+ *
+ *  Measures sha1 (reset + input + result), hmac_sha1, sha1_multi and
+ *  hmac_sha1_batch, and the same four for SHA-256, on every compression
+ *  backend this CPU supports, for each message size.  Every case is repeated until it has run for at
+ *  least 't' seconds (default 0.2).
+ *
+ *  One record per (op, backend, size) with calls, ns per call, GB/s and
+ *  cycles per byte.  Cycles are TSC ticks, i.e. at the nominal clock;
+ *  they are reported as 0 on CPUs without a TSC.  For the multi-buffer
+ *  ops a call is one message out of a batch.
+ *
+ */
+
+
+#define MAX_SIZES   32
+#define MAX_BATCH   4096
+
+static const size_t default_sizes[] = { 0, 20, 64, 1024, 64 * 1024, 1024 * 1024, 64 * 1024 * 1024 };
+
+enum { OP_SHA1, OP_HMAC, OP_SHA1_MULTI, OP_HMAC_BATCH, OP_SHA256, OP_HMAC256, OP_SHA256_MULTI, OP_HMAC256_BATCH };
+static const char* op_names[] = { "sha1", "hmac_sha1", "sha1_multi", "hmac_sha1_batch",
+                                  "sha256", "hmac_sha256", "sha256_multi", "hmac_sha256_batch" };
+
+static uint8_t* data;
+static const uint8_t* msgs[MAX_BATCH];
+static size_t lens[MAX_BATCH];
+static uint8_t digests[MAX_BATCH][20];
+static uint8_t digests256[MAX_BATCH][32];
+static struct hmac_sha1_key key_ctx;
+static struct hmac_sha256_key key_ctx256;
+static const uint8_t key[20] = "0123456789abcdefghij";
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t ticks(void)
+{
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/* Messages per call for the multi-buffer ops: enough to fill the lanes, bounded by 64 MB of input */
+static size_t batch_size(size_t size)
+{
+  size_t n = (size == 0) ? MAX_BATCH : ((64u << 20) / size);
+  return (n > MAX_BATCH) ? MAX_BATCH : ((n == 0) ? 1 : n);
+}
+
+/* One call of 'op'; returns the number of messages it covered */
+static size_t run_once(int op, size_t size)
+{
+  struct sha1 ctx;
+  struct sha256 ctx256;
+  size_t i, n;
+
+  switch (op)
+  {
+    case OP_SHA1:
+      sha1_reset(&ctx);
+      sha1_input(&ctx, data, size);
+      sha1_result(&ctx, digests[0]);
+      return 1;
+
+    case OP_HMAC:
+      hmac_sha1(key, sizeof(key), data, (uint32_t)size, digests[0]);
+      return 1;
+
+    case OP_SHA256:
+      sha256_reset(&ctx256);
+      sha256_input(&ctx256, data, size);
+      sha256_result(&ctx256, digests256[0]);
+      return 1;
+
+    case OP_HMAC256:
+      hmac_sha256(key, sizeof(key), data, (uint32_t)size, digests256[0]);
+      return 1;
+
+    default:
+      n = batch_size(size);
+      for (i = 0; i < n; ++i)
+      {
+        msgs[i] = data + ((i * size) % ((64u << 20) - size + 1));
+        lens[i] = size;
+      }
+      switch (op)
+      {
+        case OP_SHA1_MULTI:   sha1_multi(msgs, lens, n, digests);                          break;
+        case OP_HMAC_BATCH:   hmac_sha1_batch(&key_ctx, msgs, lens, n, digests);           break;
+        case OP_SHA256_MULTI: sha256_multi(msgs, lens, n, digests256);                     break;
+        default:              hmac_sha256_batch(&key_ctx256, msgs, lens, n, digests256);  break;
+      }
+      return n;
+  }
+}
+
+static void bench(int op, const char* backend, size_t size, double min_ns, int json, int* first)
+{
+  double t0, t1;
+  uint64_t c0, c1;
+  size_t calls = 0;
+  double ns_per_call, gbps, cpb;
+
+  /* warm up */
+  run_once(op, size);
+
+  t0 = now_ns();
+  c0 = ticks();
+  do
+  {
+    calls += run_once(op, size);
+    t1 = now_ns();
+  } while (t1 - t0 < min_ns);
+  c1 = ticks();
+
+  ns_per_call = (t1 - t0) / calls;
+  gbps = (size == 0) ? 0.0 : ((double)size * calls) / (t1 - t0);
+  cpb  = (size == 0) ? 0.0 : ((double)(c1 - c0)) / ((double)size * calls);
+
+  if (json)
+  {
+    printf("%s\n    { \"op\": \"%s\", \"backend\": \"%s\", \"size\": %zu, \"calls\": %zu, "
+           "\"ns_per_call\": %.1f, \"gb_per_s\": %.3f, \"cycles_per_byte\": %.2f }",
+           *first ? "" : ",", op_names[op], backend, size, calls, ns_per_call, gbps, cpb);
+  }
+  else
+  {
+    printf("%s,%s,%zu,%zu,%.1f,%.3f,%.2f\n", op_names[op], backend, size, calls, ns_per_call, gbps, cpb);
+  }
+  fflush(stdout);
+  *first = 0;
+}
+
+static void usage(const char* prog)
+{
+  printf("\n\nUsage: %s [-f csv|json] [-t seconds] [-s size,size,...]\n\n", prog);
+  exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+  size_t sizes[MAX_SIZES];
+  size_t nsizes = 0;
+  double min_ns = 0.2e9;
+  int json = 0;
+  int first = 1;
+  const char* name;
+  char* p;
+  size_t i;
+  unsigned b;
+  int op, a;
+
+  for (a = 1; a < argc; ++a)
+  {
+    if ((strcmp(argv[a], "-f") == 0) && (a + 1 < argc))
+    {
+      json = (strcmp(argv[++a], "json") == 0);
+    }
+    else if ((strcmp(argv[a], "-t") == 0) && (a + 1 < argc))
+    {
+      min_ns = atof(argv[++a]) * 1e9;
+    }
+    else if ((strcmp(argv[a], "-s") == 0) && (a + 1 < argc))
+    {
+      for (p = argv[++a]; (*p != '\0') && (nsizes < MAX_SIZES); )
+      {
+        sizes[nsizes++] = strtoul(p, &p, 0);
+        if (*p == ',')
+        {
+          p += 1;
+        }
+        else if (*p != '\0')
+        {
+          usage(argv[0]);
+        }
+      }
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+
+  if (nsizes == 0)
+  {
+    nsizes = sizeof(default_sizes) / sizeof(*default_sizes);
+    memcpy(sizes, default_sizes, sizeof(default_sizes));
+  }
+  for (i = 0; i < nsizes; ++i)
+  {
+    if (sizes[i] > (64u << 20))
+    {
+      printf("sizes above 64 MB are not supported\n");
+      return 1;
+    }
+  }
+
+  data = malloc(64u << 20);
+  if (data == 0)
+  {
+    return 1;
+  }
+  for (i = 0; i < (64u << 20); ++i)
+  {
+    data[i] = (uint8_t)(i * 2654435761u >> 24);
+  }
+  hmac_sha1_key_init(&key_ctx, key, sizeof(key));
+  hmac_sha256_key_init(&key_ctx256, key, sizeof(key));
+
+  if (json)
+  {
+    printf("{\n  \"results\": [");
+  }
+  else
+  {
+    printf("op,backend,size,calls,ns_per_call,gb_per_s,cycles_per_byte\n");
+  }
+
+  /* single-stream ops on every compression backend */
+  for (b = 0; (name = sha1_backend_at(b)) != 0; ++b)
+  {
+    sha1_set_backend(name);
+    for (op = OP_SHA1; op <= OP_HMAC; ++op)
+    {
+      for (i = 0; i < nsizes; ++i)
+      {
+        bench(op, name, sizes[i], min_ns, json, &first);
+      }
+    }
+  }
+  sha1_set_backend(sha1_backend_at(0));
+
+  for (b = 0; (name = sha256_backend_at(b)) != 0; ++b)
+  {
+    sha256_set_backend(name);
+    for (op = OP_SHA256; op <= OP_HMAC256; ++op)
+    {
+      for (i = 0; i < nsizes; ++i)
+      {
+        bench(op, name, sizes[i], min_ns, json, &first);
+      }
+    }
+  }
+  sha256_set_backend(sha256_backend_at(0));
+
+  /* batched ops on every multi-buffer kernel */
+  for (b = 0; (name = sha1_mb_backend_at(b)) != 0; ++b)
+  {
+    sha1_mb_set_backend(name);
+    for (op = OP_SHA1_MULTI; op <= OP_HMAC_BATCH; ++op)
+    {
+      for (i = 0; i < nsizes; ++i)
+      {
+        bench(op, name, sizes[i], min_ns, json, &first);
+      }
+    }
+  }
+  for (b = 0; (name = sha256_mb_backend_at(b)) != 0; ++b)
+  {
+    sha256_mb_set_backend(name);
+    for (op = OP_SHA256_MULTI; op <= OP_HMAC256_BATCH; ++op)
+    {
+      for (i = 0; i < nsizes; ++i)
+      {
+        bench(op, name, sizes[i], min_ns, json, &first);
+      }
+    }
+  }
+
+  if (json)
+  {
+    printf("\n  ]\n}\n");
+  }
+
+  free(data);
+
+  return 0;
+}
+
@@ -0,0 +1,80 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_engine.h"
+
+
+#define NJOBS   5000
+
+
+/*
+ *  Run a mix of SHA-1 and HMAC-SHA1 jobs of very different sizes through
+ *  the thread pool, with and without core pinning, and compare each
+ *  output to a direct single-threaded call.
+ */
+int main()
+{
+  static struct sha1_job jobs[NJOBS];
+  static uint8_t outputs[NJOBS][20];
+  static uint8_t expected[NJOBS][20];
+  uint8_t* data;
+  struct sha1 ctx;
+  unsigned threads[] = { 1, 3, 8, 0 };
+  size_t datalen = 1 << 20;
+  unsigned i, t;
+
+  data = malloc(datalen);
+  assert(data != 0);
+  for (i = 0; i < datalen; ++i)
+  {
+    data[i] = (uint8_t)(i ^ (i >> 8));
+  }
+
+  for (i = 0; i < NJOBS; ++i)
+  {
+    jobs[i].type    = (i % 3 == 0) ? sha1JobHash : sha1JobHmac;
+    jobs[i].key     = data + (i % 97);
+    jobs[i].keysize = i % 100;
+    jobs[i].msg     = data + (i % 1013);
+    /* a few big jobs clustered at the start, so stealing has to happen */
+    jobs[i].msgsize = (i < 16) ? (512 * 1024 + i) : (i % 700);
+    jobs[i].output  = outputs[i];
+
+    if (jobs[i].type == sha1JobHash)
+    {
+      sha1_reset(&ctx);
+      sha1_input(&ctx, jobs[i].msg, jobs[i].msgsize);
+      sha1_result(&ctx, expected[i]);
+    }
+    else
+    {
+      hmac_sha1(jobs[i].key, jobs[i].keysize, jobs[i].msg, jobs[i].msgsize, expected[i]);
+    }
+  }
+
+  printf("\n");
+
+  for (t = 0; t < sizeof(threads) / sizeof(*threads); ++t)
+  {
+    memset(outputs, 0, sizeof(outputs));
+    assert(sha1_engine_run(jobs, NJOBS, threads[t], (t & 1) ? SHA1_ENGINE_PIN_CORES : 0) == shaSuccess);
+    assert(memcmp(outputs, expected, sizeof(outputs)) == 0);
+    printf("  sha1_engine_run: %u jobs on %u thread(s) match.\n", NJOBS, threads[t]);
+  }
+
+  jobs[7].type = 42;
+  assert(sha1_engine_run(jobs, NJOBS, 2, 0) == shaBadParam);
+  jobs[7].type = sha1JobHash;
+  jobs[7].output = 0;
+  assert(sha1_engine_run(jobs, NJOBS, 2, 0) == shaNull);
+
+  printf("\n");
+
+  free(data);
+
+  return 0;
+}
+
@@ -0,0 +1,103 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_files.h"
+
+
+#define NFILES  200
+
+
+/*
+ *  Hash a directory of files of assorted sizes (empty, around the block
+ *  size, around the read chunk, several chunks) with sha1_files_hash(),
+ *  with generous and with one-chunk buffer memory, plain and keyed, and
+ *  compare every digest to sha1_input() / hmac_sha1() over the contents.
+ *  A missing file and a directory in the list must fail on their own.
+ */
+int main()
+{
+  static const size_t sizes[] = { 0, 1, 63, 64, 65, 4096, SHA1_FILES_CHUNK - 1, SHA1_FILES_CHUNK,
+                                  SHA1_FILES_CHUNK + 1, 3 * SHA1_FILES_CHUNK + 17, 9 * SHA1_FILES_CHUNK + 5 };
+  static const size_t memory[] = { 0, SHA1_FILES_CHUNK };
+  static char names[NFILES + 2][64];
+  static const char* paths[NFILES + 2];
+  static uint8_t expected[NFILES + 2][SHA1HashSize];
+  static uint8_t expected_hmac[NFILES + 2][SHA1HashSize];
+  static uint8_t digests[NFILES + 2][SHA1HashSize];
+  static int errors[NFILES + 2];
+  const size_t maxlen = 9 * SHA1_FILES_CHUNK + 5 + NFILES;
+  struct hmac_sha1_key key;
+  struct sha1 ctx;
+  char dir[] = "/tmp/test_files_sha1.XXXXXX";
+  uint8_t* data;
+  size_t len;
+  FILE* f;
+  unsigned i, m, keyed;
+
+  data = malloc(maxlen);
+  assert(data != 0);
+  for (i = 0; i < maxlen; ++i)
+  {
+    data[i] = (uint8_t)((i * 2654435761u) >> 13);
+  }
+  hmac_sha1_key_init(&key, (const uint8_t*)"key", 3);
+
+  assert(mkdtemp(dir) != 0);
+  for (i = 0; i < NFILES; ++i)
+  {
+    len = sizes[i % (sizeof(sizes) / sizeof(*sizes))] + ((i < 11) ? 0 : i % 7);
+    snprintf(names[i], sizeof(names[i]), "%s/f%u", dir, i);
+    f = fopen(names[i], "wb");
+    assert(f != 0);
+    assert(fwrite(data + i, 1, len, f) == len);
+    fclose(f);
+    paths[i] = names[i];
+
+    sha1_reset(&ctx);
+    sha1_input(&ctx, data + i, len);
+    sha1_result(&ctx, expected[i]);
+    hmac_sha1_with_key(&key, data + i, len, expected_hmac[i]);
+  }
+  snprintf(names[NFILES], sizeof(names[NFILES]), "%s/missing", dir);
+  paths[NFILES] = names[NFILES];
+  paths[NFILES + 1] = dir;
+
+  printf("\n");
+
+  for (m = 0; m < sizeof(memory) / sizeof(*memory); ++m)
+  {
+    for (keyed = 0; keyed < 2; ++keyed)
+    {
+      memset(digests, 0, sizeof(digests));
+      assert(sha1_files_hash(paths, NFILES + 2, keyed ? &key : 0, digests, errors, 0, memory[m]) == shaSuccess);
+      for (i = 0; i < NFILES; ++i)
+      {
+        assert(errors[i] == 0);
+        assert(memcmp(digests[i], keyed ? expected_hmac[i] : expected[i], SHA1HashSize) == 0);
+      }
+      assert(errors[NFILES] == ENOENT);
+      assert(errors[NFILES + 1] == EINVAL);
+    }
+    printf("  sha1_files_hash: %u files match sha1_input / hmac_sha1 using the %s reader, %s buffers.\n",
+           NFILES, sha1_files_backend(), (memory[m] == 0) ? "default" : "one chunk of");
+  }
+  assert(sha1_files_hash(0, 1, 0, digests, errors, 0, 0) == shaNull);
+
+  for (i = 0; i < NFILES; ++i)
+  {
+    unlink(names[i]);
+  }
+  rmdir(dir);
+  free(data);
+
+  printf("\n");
+
+  return 0;
+}
@@ -43,6 +43,44 @@ static void test_hash(const uint8_t* msg, unsigned len, const uint8_t* digest_ex
 
 
 
+/* FIPS 180-1 "one million a's", fed in chunks that straddle block boundaries */
+static void test_million_a(void)
+{
+  static const uint8_t expected[] = "34aa973cd4c4daa4f61eeb2bdbad27316534016f";
+  static const unsigned chunks[] = { 1, 7, 55, 64, 65, 127, 1000, 4096 };
+  uint8_t buf[4096];
+  uint8_t digest[20];
+  uint8_t digest_hex[41];
+  struct sha1 ctx;
+  unsigned remaining;
+  unsigned n;
+  size_t i;
+
+  memset(buf, 'a', sizeof(buf));
+
+  for (i = 0; i < sizeof(chunks) / sizeof(*chunks); ++i)
+  {
+    sha1_reset(&ctx);
+    remaining = 1000000;
+    while (remaining != 0)
+    {
+      n = (remaining < chunks[i]) ? remaining : chunks[i];
+      assert(sha1_input(&ctx, buf, n) == shaSuccess);
+      remaining -= n;
+    }
+    assert(sha1_result(&ctx, digest) == shaSuccess);
+
+    for (n = 0; n < sizeof(digest); ++n)
+    {
+      sprintf((char*)digest_hex + (2 * n), "%.02x", digest[n]);
+    }
+    printf("  SHA1(1000000 x 'a', %4u-byte chunks) = '%s'\n", chunks[i], digest_hex);
+    assert(memcmp(digest_hex, expected, 40) == 0);
+  }
+}
+
+
+
 typedef struct
 {
   const uint8_t* input;
@@ -77,7 +115,7 @@ int main()
 {
   int ntests = sizeof(tests) / sizeof(*tests);
 
-  printf("\nRunning %u golden tests.\n\n", ntests);
+  printf("\nRunning %u golden tests using the %s backend.\n\n", ntests, sha1_backend());
 
   const uint8_t* msg_input;
   const uint8_t* hash_output;
@@ -93,6 +131,8 @@ int main()
     test_hash(msg_input, msg_length, hash_output);
   }
 
+  test_million_a();
+
   printf("\n\n");
 
   return 0;
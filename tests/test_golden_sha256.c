@@ -0,0 +1,147 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "sha256.h"
+
+
+#define NMSGS   300             /* sha256_multi: messages of length 0 .. NMSGS-1 */
+
+
+static void to_hex(const uint8_t* digest, char* hex)
+{
+  size_t i;
+
+  for (i = 0; i < SHA256HashSize; ++i)
+  {
+    sprintf(hex + (2 * i), "%.02x", digest[i]);
+  }
+}
+
+static void calculate_sha256(const uint8_t* msg, unsigned nbytes, uint8_t* output)
+{
+  struct sha256 ctx;
+
+  assert(sha256_reset(&ctx) == shaSuccess);
+  assert(sha256_input(&ctx, msg, nbytes) == shaSuccess);
+  assert(sha256_result(&ctx, output) == shaSuccess);
+}
+
+
+typedef struct
+{
+  const char* input;
+  const char* output;
+} regression_test_t;
+
+/* FIPS 180-4 examples and a few classics */
+static const regression_test_t tests[] =
+{
+  { "abc",
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+  { "",
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+  { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+  { "The quick brown fox jumps over the lazy dog",
+    "d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592" },
+  { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+    "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+};
+
+/* "one million a's", fed in chunks that straddle block boundaries */
+static void test_million_a(void)
+{
+  static const char expected[] = "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+  static const unsigned chunks[] = { 1, 55, 64, 65, 4096 };
+  uint8_t buf[4096];
+  uint8_t digest[SHA256HashSize];
+  char hex[2 * SHA256HashSize + 1];
+  struct sha256 ctx;
+  unsigned remaining, n;
+  size_t i;
+
+  memset(buf, 'a', sizeof(buf));
+
+  for (i = 0; i < sizeof(chunks) / sizeof(*chunks); ++i)
+  {
+    sha256_reset(&ctx);
+    for (remaining = 1000000; remaining != 0; remaining -= n)
+    {
+      n = (remaining < chunks[i]) ? remaining : chunks[i];
+      assert(sha256_input(&ctx, buf, n) == shaSuccess);
+    }
+    assert(sha256_result(&ctx, digest) == shaSuccess);
+    to_hex(digest, hex);
+    assert(strcmp(hex, expected) == 0);
+  }
+  printf("  SHA256(1000000 x 'a') = '%s'\n", expected);
+}
+
+/* sha256_multi() on every multi-buffer kernel against sha256_input() */
+static void test_multi(void)
+{
+  static uint8_t data[NMSGS];
+  static uint8_t expected[NMSGS][SHA256HashSize];
+  static uint8_t digests[NMSGS][SHA256HashSize];
+  const uint8_t* msgs[NMSGS];
+  size_t lens[NMSGS];
+  const char* name;
+  unsigned i, b;
+
+  for (i = 0; i < NMSGS; ++i)
+  {
+    data[i] = (uint8_t)(i * 131 + 7);
+  }
+  for (i = 0; i < NMSGS; ++i)
+  {
+    lens[i] = (i & 1) ? (NMSGS - 1 - i) : i;
+    msgs[i] = data;
+    calculate_sha256(msgs[i], lens[i], expected[i]);
+  }
+
+  for (b = 0; (name = sha256_mb_backend_at(b)) != 0; ++b)
+  {
+    assert(sha256_mb_set_backend(name) == shaSuccess);
+    memset(digests, 0, sizeof(digests));
+    assert(sha256_multi(msgs, lens, NMSGS, digests) == shaSuccess);
+    for (i = 0; i < NMSGS; ++i)
+    {
+      assert(memcmp(digests[i], expected[i], SHA256HashSize) == 0);
+    }
+    printf("  sha256_multi: %u messages match sha256_input on the %s backend.\n", NMSGS, name);
+  }
+  assert(sha256_mb_set_backend("no-such-backend") == shaBadParam);
+}
+
+
+int main()
+{
+  int ntests = sizeof(tests) / sizeof(*tests);
+  uint8_t digest[SHA256HashSize];
+  char hex[2 * SHA256HashSize + 1];
+  const char* name;
+  unsigned b;
+  int i;
+
+  for (b = 0; (name = sha256_backend_at(b)) != 0; ++b)
+  {
+    assert(sha256_set_backend(name) == shaSuccess);
+
+    printf("\nRunning %u SHA-256 golden tests using the %s backend.\n\n", ntests, sha256_backend());
+
+    for (i = 0; i < ntests; ++i)
+    {
+      calculate_sha256((const uint8_t*)tests[i].input, strlen(tests[i].input), digest);
+      to_hex(digest, hex);
+      printf("  SHA256('%s') = '%s'\n", tests[i].input, hex);
+      assert(strcmp(hex, tests[i].output) == 0);
+    }
+
+    test_million_a();
+    test_multi();
+  }
+
+  printf("\n\n");
+
+  return 0;
+}
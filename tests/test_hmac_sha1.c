@@ -33,6 +33,12 @@ int main(int argc, char* argv[])
   uint8_t msg_bin[1024];
   uint8_t expected_bin[20];
   uint8_t hmac_bin[20];
+  struct hmac_sha1_key key_ctx;
+  struct hmac_sha1_ctx stream;
+  uint32_t chunk, offset, n;
+  static const uint8_t* batch_msgs[1025];
+  static size_t batch_lens[1025];
+  static uint8_t batch_out[1025][20];
   uint32_t key_len;
   uint32_t msg_len;
   uint32_t output_len;  
@@ -58,6 +64,40 @@ int main(int argc, char* argv[])
   /* Compare HASH(input) to expected-output */
   compare_output_with_expected(hmac_bin, expected_bin);
 
+  /* Same again through a precomputed key, used twice to make sure it is not consumed */
+  hmac_sha1_key_init(&key_ctx, key_bin, (key_len / 2));
+  hmac_sha1_with_key(&key_ctx, msg_bin, (msg_len / 2), hmac_bin);
+  compare_output_with_expected(hmac_bin, expected_bin);
+
+  /* And in a batch, mixed with every shorter prefix of the message */
+  for (n = 0; n <= (msg_len / 2); ++n)
+  {
+    batch_msgs[n] = msg_bin;
+    batch_lens[n] = (msg_len / 2) - n;
+  }
+  hmac_sha1_batch(&key_ctx, batch_msgs, batch_lens, n, batch_out);
+  compare_output_with_expected(batch_out[0], expected_bin);
+  for (n = 1; n <= (msg_len / 2); ++n)
+  {
+    hmac_sha1_with_key(&key_ctx, msg_bin, (msg_len / 2) - n, hmac_bin);
+    compare_output_with_expected(batch_out[n], hmac_bin);
+  }
+
+  /* And streamed in uneven chunks */
+  for (chunk = 1; chunk <= 65; chunk += 16)
+  {
+    hmac_sha1_init(&stream, key_bin, (key_len / 2));
+    for (offset = 0; offset < (msg_len / 2); offset += chunk)
+    {
+      n = ((msg_len / 2) - offset < chunk) ? ((msg_len / 2) - offset) : chunk;
+      assert(hmac_sha1_update(&stream, msg_bin + offset, n) == shaSuccess);
+    }
+    assert(hmac_sha1_final(&stream, hmac_bin) == shaSuccess);
+    compare_output_with_expected(hmac_bin, expected_bin);
+  }
+  hmac_sha1_with_key(&key_ctx, msg_bin, (msg_len / 2), hmac_bin);
+  compare_output_with_expected(hmac_bin, expected_bin);
+
   return 0;
 }
 
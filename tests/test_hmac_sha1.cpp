@@ -0,0 +1,98 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hmac_sha1.hpp"
+
+using namespace tiny_hmac;
+
+
+static std::uint8_t data[200];
+
+
+static Sha1Digest c_sha1(const std::uint8_t* msg, std::size_t len)
+{
+  struct sha1 ctx;
+  Sha1Digest digest;
+
+  sha1_reset(&ctx);
+  sha1_input(&ctx, msg, len);
+  sha1_result(&ctx, digest.data());
+  return digest;
+}
+
+static Sha1Digest c_hmac(const std::uint8_t* key, std::size_t keylen, const std::uint8_t* msg, std::size_t len)
+{
+  Sha1Digest tag;
+
+  hmac_sha1(key, keylen, msg, len, tag.data());
+  return tag;
+}
+
+/* the compile-time-length overloads for every N in Ns, against the C API */
+template <std::size_t... Ns>
+static void check_fixed(const HmacSha1Key& key, std::index_sequence<Ns...>)
+{
+  ((assert(Sha1::digest(std::span<const std::uint8_t, Ns>(data, Ns)) == c_sha1(data, Ns)),
+    assert(HmacSha1::mac(key, std::span<const std::uint8_t, Ns>(data, Ns)) == c_hmac(data + 100, 20, data, Ns))), ...);
+}
+
+
+/*
+ *  The C++ wrapper against the C functions it wraps: one-shot, streaming,
+ *  copies, moves, and the single-block templates for every message length
+ *  up to 100 octets.
+ */
+int main()
+{
+  static_assert(std::is_nothrow_move_constructible_v<Sha1>);
+  static_assert(std::is_nothrow_move_constructible_v<HmacSha1>);
+  static_assert(std::is_nothrow_move_assignable_v<HmacSha1Key>);
+
+  for (std::size_t i = 0; i < sizeof(data); ++i)
+  {
+    data[i] = static_cast<std::uint8_t>(i * 61 + 5);
+  }
+  const HmacSha1Key key(std::span<const std::uint8_t>(data + 100, 20));
+
+  std::printf("\n");
+
+  check_fixed(key, std::make_index_sequence<101>());
+  std::printf("  Sha1::digest / HmacSha1::mac: fixed-length messages of 0 .. 100 octets match the C API.\n");
+
+  for (std::size_t len = 0; len <= 150; ++len)
+  {
+    const std::vector<std::uint8_t> msg(data, data + len);
+
+    assert(Sha1::digest(msg) == c_sha1(data, len));
+    assert(HmacSha1::mac(key, msg) == c_hmac(data + 100, 20, data, len));
+
+    Sha1 sha;
+    HmacSha1 mac(std::span<const std::uint8_t>(data + 100, 20));
+    sha.update(std::span(msg).first(len / 3));
+    mac.update(std::span(msg).first(len / 3));
+    Sha1 sha_fork = sha;
+    HmacSha1 mac_fork = mac;
+    sha_fork.update(std::span(msg).subspan(len / 3));
+    mac_fork.update(std::span(msg).subspan(len / 3));
+    assert(sha_fork.finalize() == c_sha1(data, len));
+    assert(mac_fork.finalize() == c_hmac(data + 100, 20, data, len));
+
+    /* finalize() starts over under the same key */
+    HmacSha1 moved = std::move(mac_fork);
+    moved.update(msg);
+    assert(moved.finalize() == c_hmac(data + 100, 20, data, len));
+  }
+  std::printf("  Sha1 / HmacSha1: streamed, forked and moved contexts match the C API.\n");
+
+  const std::array<std::uint8_t, 3> abc = { 'a', 'b', 'c' };
+  assert(Sha1::digest(abc) == Sha1::digest("abc"));
+  assert(HmacSha1::mac(HmacSha1Key("key"), "The quick brown fox jumps over the lazy dog")
+         == c_hmac((const std::uint8_t*)"key", 3, (const std::uint8_t*)"The quick brown fox jumps over the lazy dog", 43));
+
+  std::printf("\n");
+
+  return 0;
+}
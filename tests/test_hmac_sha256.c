@@ -0,0 +1,142 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sha256.h"
+#include "hmac_sha256.h"
+
+
+#define NBATCH  300             /* hmac_sha256_batch: messages of length 0 .. NBATCH-1 */
+
+
+struct test_vector
+{
+  uint8_t     key[131];
+  uint32_t    keylen;
+  const char* msg;
+  uint32_t    msglen;
+  const char* tag;              /* hex, possibly truncated */
+};
+
+static void to_hex(const uint8_t* tag, size_t n, char* hex)
+{
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+  {
+    sprintf(hex + (2 * i), "%.02x", tag[i]);
+  }
+}
+
+
+/*
+ *  RFC 4231 test cases through one-shot, precomputed-key and streaming
+ *  HMAC-SHA-256, then hmac_sha256_batch() on every multi-buffer kernel
+ *  against hmac_sha256().
+ */
+int main()
+{
+  static struct test_vector vectors[7] =
+  {
+    { { 0 }, 20, "Hi There", 8,
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { "Jefe", 4, "what do ya want for nothing?", 28,
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+    { { 0 }, 20, 0, 50,
+      "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+    { { 0 }, 25, 0, 50,
+      "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+    { { 0 }, 20, "Test With Truncation", 20,
+      "a3b6167473100ee06e0c796c2955552b" },
+    { { 0 }, 131, "Test Using Larger Than Block-Size Key - Hash Key First", 54,
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+    { { 0 }, 131, "This is a test using a larger than block-size key and a larger than block-size data."
+                  " The key needs to be hashed before being used by the HMAC algorithm.", 152,
+      "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" },
+  };
+  uint8_t data_dd[50], data_cd[50];
+  uint8_t tag[HMAC_SHA256_DIGEST_SIZE];
+  char hex[2 * HMAC_SHA256_DIGEST_SIZE + 1];
+  struct hmac_sha256_key key_ctx;
+  struct hmac_sha256_ctx stream;
+  static uint8_t data[NBATCH];
+  static uint8_t expected[NBATCH][HMAC_SHA256_DIGEST_SIZE];
+  static uint8_t batch_out[NBATCH][HMAC_SHA256_DIGEST_SIZE];
+  const uint8_t* msgs[NBATCH];
+  size_t lens[NBATCH];
+  const uint8_t* msg;
+  const char* name;
+  uint32_t i, j, n;
+  unsigned b;
+
+  memset(vectors[0].key, 0x0b, 20);
+  memset(vectors[2].key, 0xaa, 20);
+  for (i = 0; i < 25; ++i)
+  {
+    vectors[3].key[i] = (uint8_t)(i + 1);
+  }
+  memset(vectors[4].key, 0x0c, 20);
+  memset(vectors[5].key, 0xaa, 131);
+  memset(vectors[6].key, 0xaa, 131);
+  memset(data_dd, 0xdd, sizeof(data_dd));
+  memset(data_cd, 0xcd, sizeof(data_cd));
+
+  printf("\n");
+
+  for (i = 0; i < 7; ++i)
+  {
+    msg = (i == 2) ? data_dd : (i == 3) ? data_cd : (const uint8_t*)vectors[i].msg;
+    n = (uint32_t)strlen(vectors[i].tag) / 2;
+
+    hmac_sha256(vectors[i].key, vectors[i].keylen, msg, vectors[i].msglen, tag);
+    to_hex(tag, n, hex);
+    assert(memcmp(hex, vectors[i].tag, 2 * n) == 0);
+
+    hmac_sha256_key_init(&key_ctx, vectors[i].key, vectors[i].keylen);
+    memset(tag, 0, sizeof(tag));
+    hmac_sha256_with_key(&key_ctx, msg, vectors[i].msglen, tag);
+    to_hex(tag, n, hex);
+    assert(memcmp(hex, vectors[i].tag, 2 * n) == 0);
+
+    /* streaming, one byte at a time */
+    hmac_sha256_init(&stream, vectors[i].key, vectors[i].keylen);
+    for (j = 0; j < vectors[i].msglen; ++j)
+    {
+      assert(hmac_sha256_update(&stream, msg + j, 1) == shaSuccess);
+    }
+    memset(tag, 0, sizeof(tag));
+    assert(hmac_sha256_final(&stream, tag) == shaSuccess);
+    to_hex(tag, n, hex);
+    assert(memcmp(hex, vectors[i].tag, 2 * n) == 0);
+  }
+  printf("  hmac_sha256: RFC 4231 test cases 1-7 passed (one-shot, precomputed key, streaming).\n");
+
+  /* batch over messages of every length up to NBATCH-1, under the 131-byte key */
+  for (i = 0; i < NBATCH; ++i)
+  {
+    data[i] = (uint8_t)(i * 29 + 3);
+  }
+  hmac_sha256_key_init(&key_ctx, vectors[6].key, vectors[6].keylen);
+  for (i = 0; i < NBATCH; ++i)
+  {
+    msgs[i] = data;
+    lens[i] = (i * 7) % NBATCH;
+    hmac_sha256_with_key(&key_ctx, msgs[i], lens[i], expected[i]);
+  }
+
+  for (b = 0; (name = sha256_mb_backend_at(b)) != 0; ++b)
+  {
+    assert(sha256_mb_set_backend(name) == shaSuccess);
+    memset(batch_out, 0, sizeof(batch_out));
+    hmac_sha256_batch(&key_ctx, msgs, lens, NBATCH, batch_out);
+    for (i = 0; i < NBATCH; ++i)
+    {
+      assert(memcmp(batch_out[i], expected[i], HMAC_SHA256_DIGEST_SIZE) == 0);
+    }
+    printf("  hmac_sha256_batch: %u messages match hmac_sha256 on the %s backend.\n", NBATCH, name);
+  }
+
+  printf("\n");
+
+  return 0;
+}
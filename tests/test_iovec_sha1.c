@@ -0,0 +1,188 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "sha1.h"
+#include "sha256.h"
+#include "hmac.h"
+#include "hmac_sha256.h"
+
+
+#define MSGLEN  1000
+#define MAXSEGS 16
+
+
+/* Cut msg[0 .. len) into n segments at pseudo-random points, some of them empty */
+static int split(const uint8_t* msg, size_t len, unsigned seed, struct iovec* iov)
+{
+  size_t cut, off = 0;
+  int n = 0;
+
+  while ((off < len) && (n < MAXSEGS - 1))
+  {
+    seed = seed * 1103515245u + 12345u;
+    switch ((seed >> 16) % 4)
+    {
+      case 0:  cut = 0;                        break;
+      case 1:  cut = (seed >> 8) % 3;          break;
+      case 2:  cut = 64 - (off % 64);          break;
+      default: cut = (seed >> 4) % 300;        break;
+    }
+    if (cut > len - off)
+    {
+      cut = len - off;
+    }
+    iov[n].iov_base = (void*)(msg + off);
+    iov[n].iov_len  = cut;
+    off += cut;
+    n += 1;
+  }
+  iov[n].iov_base = (void*)(msg + off);
+  iov[n].iov_len  = len - off;
+
+  return n + 1;
+}
+
+
+/*
+ *  sha1_inputv(), sha256_inputv(), hmac_sha1v() and hmac_sha256v() over
+ *  many splits of messages of every length up to MSGLEN, against the
+ *  same message in one buffer.  Last, one sha1_input() call of more
+ *  than 4 GiB (zero pages of an anonymous mapping) where size_t allows.
+ */
+int main()
+{
+  static uint8_t msg[MSGLEN];
+  struct iovec iov[MAXSEGS];
+  struct hmac_sha1_key key1;
+  struct hmac_sha256_key key256;
+  struct hmac_sha1_ctx stream;
+  struct sha1 ctx1;
+  struct sha256 ctx256;
+  uint8_t expected[SHA256HashSize], actual[SHA256HashSize];
+  unsigned len, seed, ncases = 0;
+  int n;
+
+  for (len = 0; len < MSGLEN; ++len)
+  {
+    msg[len] = (uint8_t)(len * 37 + 11);
+  }
+  hmac_sha1_key_init(&key1, msg, 80);
+  hmac_sha256_key_init(&key256, msg, 80);
+
+  printf("\n");
+
+  for (len = 0; len <= MSGLEN; len += 1 + (len > 200) * 13)
+  {
+    for (seed = 0; seed < 8; ++seed)
+    {
+      n = split(msg, len, seed * 7919 + len, iov);
+
+      sha1_reset(&ctx1);
+      sha1_input(&ctx1, msg, len);
+      sha1_result(&ctx1, expected);
+      sha1_reset(&ctx1);
+      assert(sha1_inputv(&ctx1, iov, n) == shaSuccess);
+      assert(sha1_result(&ctx1, actual) == shaSuccess);
+      assert(memcmp(actual, expected, SHA1HashSize) == 0);
+
+      /* after a partial block, and in two calls */
+      sha1_reset(&ctx1);
+      sha1_input(&ctx1, msg, 3);
+      assert(sha1_inputv(&ctx1, iov, n / 2) == shaSuccess);
+      assert(sha1_inputv(&ctx1, iov + n / 2, n - n / 2) == shaSuccess);
+      assert(sha1_result(&ctx1, actual) == shaSuccess);
+      sha1_reset(&ctx1);
+      sha1_input(&ctx1, msg, 3);
+      sha1_input(&ctx1, msg, len);
+      sha1_result(&ctx1, expected);
+      assert(memcmp(actual, expected, SHA1HashSize) == 0);
+
+      sha256_reset(&ctx256);
+      sha256_input(&ctx256, msg, len);
+      sha256_result(&ctx256, expected);
+      sha256_reset(&ctx256);
+      assert(sha256_inputv(&ctx256, iov, n) == shaSuccess);
+      assert(sha256_result(&ctx256, actual) == shaSuccess);
+      assert(memcmp(actual, expected, SHA256HashSize) == 0);
+
+      hmac_sha1_with_key(&key1, msg, len, expected);
+      assert(hmac_sha1v(&key1, iov, n, actual) == shaSuccess);
+      assert(memcmp(actual, expected, HMAC_SHA1_DIGEST_SIZE) == 0);
+      hmac_sha1_init_key(&stream, &key1);
+      assert(hmac_sha1_updatev(&stream, iov, n) == shaSuccess);
+      assert(hmac_sha1_final(&stream, actual) == shaSuccess);
+      assert(memcmp(actual, expected, HMAC_SHA1_DIGEST_SIZE) == 0);
+
+      hmac_sha256_with_key(&key256, msg, len, expected);
+      assert(hmac_sha256v(&key256, iov, n, actual) == shaSuccess);
+      assert(memcmp(actual, expected, HMAC_SHA256_DIGEST_SIZE) == 0);
+
+      ncases += 1;
+    }
+  }
+  printf("  sha1_inputv / sha256_inputv / hmac_sha1v / hmac_sha256v: %u scattered messages match.\n", ncases);
+
+  /* bad parameters */
+  sha1_reset(&ctx1);
+  assert(sha1_inputv(&ctx1, 0, 0) == shaSuccess);
+  assert(sha1_inputv(&ctx1, 0, 1) == shaNull);
+  assert(sha1_inputv(&ctx1, iov, -1) == shaBadParam);
+  iov[0].iov_base = 0;
+  iov[0].iov_len  = 1;
+  assert(sha1_inputv(&ctx1, iov, 1) == shaNull);
+  assert(hmac_sha1v(&key1, iov, 1, actual) == shaNull);
+
+  /* empty and missing messages: a null message is only valid with length 0, a longer one is ignored as before */
+  {
+    static const uint8_t empty1[HMAC_SHA1_DIGEST_SIZE] = {
+      0xf4, 0x2b, 0xb0, 0xee, 0xb0, 0x18, 0xeb, 0xbd, 0x45, 0x97,
+      0xae, 0x72, 0x13, 0x71, 0x1e, 0xc6, 0x07, 0x60, 0x84, 0x3f
+    };
+    static const uint8_t empty256[HMAC_SHA256_DIGEST_SIZE] = {
+      0x5d, 0x5d, 0x13, 0x95, 0x63, 0xc9, 0x5b, 0x59, 0x67, 0xb9, 0xbd, 0x9a, 0x8c, 0x9b, 0x23, 0x3a,
+      0x9d, 0xed, 0xb4, 0x50, 0x72, 0x79, 0x4c, 0xd2, 0x32, 0xdc, 0x1b, 0x74, 0x83, 0x26, 0x07, 0xd0
+    };
+    const uint8_t* k = (const uint8_t*)"key";
+
+    hmac_sha1(k, 3, msg, 0, actual);
+    assert(memcmp(actual, empty1, HMAC_SHA1_DIGEST_SIZE) == 0);
+    hmac_sha1(k, 3, 0, 0, actual);
+    assert(memcmp(actual, empty1, HMAC_SHA1_DIGEST_SIZE) == 0);
+    hmac_sha1(k, 3, 0, 20, actual);
+    assert(memcmp(actual, empty1, HMAC_SHA1_DIGEST_SIZE) == 0);
+    hmac_sha256(k, 3, 0, 0, actual);
+    assert(memcmp(actual, empty256, HMAC_SHA256_DIGEST_SIZE) == 0);
+    hmac_sha256(k, 3, 0, 20, actual);
+    assert(memcmp(actual, empty256, HMAC_SHA256_DIGEST_SIZE) == 0);
+    printf("  hmac_sha1 / hmac_sha256: empty and null messages give the empty-message tag.\n");
+  }
+
+  if (sizeof(size_t) > 4)
+  {
+    /* 2^32 + 70 zero octets, then "tail" and three more zeros */
+    static const uint8_t big[SHA1HashSize] = {
+      0x65, 0x01, 0xcc, 0xee, 0xef, 0x9d, 0xee, 0xdf, 0xa9, 0xf5,
+      0xaf, 0x1f, 0x92, 0x1c, 0xc8, 0x22, 0xb0, 0x88, 0xa0, 0x69
+    };
+    const size_t biglen = ((size_t)1 << 32) + 77;
+    uint8_t* map = mmap(0, biglen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (map != MAP_FAILED)
+    {
+      memcpy(map + biglen - 7, "tail", 4);
+      sha1_reset(&ctx1);
+      assert(sha1_input(&ctx1, map, biglen) == shaSuccess);
+      assert(sha1_result(&ctx1, actual) == shaSuccess);
+      assert(memcmp(actual, big, SHA1HashSize) == 0);
+      munmap(map, biglen);
+      printf("  sha1_input: one call over 4 GiB + 77 octets matches.\n");
+    }
+  }
+
+  printf("\n");
+
+  return 0;
+}
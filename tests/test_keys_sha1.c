@@ -0,0 +1,172 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "hmac.h"
+#include "sha1_keys.h"
+
+
+#define NIDS        16          /* keys rotated while the readers run */
+#define NVERSIONS   32          /* versions each of them cycles through */
+#define NREADERS    4
+#define NROTATIONS  20000
+
+
+static struct hmac_sha1_key versions[NIDS][NVERSIONS];
+static unsigned loads;
+static int stop;
+
+
+/* raw key 'version' of 'id'; returns its length */
+static size_t raw_key(uint64_t id, unsigned version, uint8_t raw[80])
+{
+  unsigned i;
+
+  for (i = 0; i < 80; ++i)
+  {
+    raw[i] = (uint8_t)(id * 31 + version * 7 + i);
+  }
+  /* keys past the block size are hashed first: vary the length across it */
+  return 10 + (id * 13 + version) % 70;
+}
+
+static void make_key(uint64_t id, unsigned version, struct hmac_sha1_key* key)
+{
+  uint8_t raw[80];
+
+  hmac_sha1_key_init(key, raw, raw_key(id, version, raw));
+}
+
+/* loader for the eviction test: every id exists, version 0 */
+static int load(void* arg, uint64_t id, struct hmac_sha1_key* key)
+{
+  (void)arg;
+  loads += 1;
+  if (id >= 1000)
+  {
+    return -1;
+  }
+  make_key(id, 0, key);
+  return 0;
+}
+
+/* looks keys up while main() rotates them: every result must be one whole version */
+static void* reader(void* arg)
+{
+  struct sha1_keys* keys = arg;
+  struct hmac_sha1_key key;
+  unsigned long n = 0;
+  unsigned id, v;
+
+  while (!__atomic_load_n(&stop, __ATOMIC_RELAXED))
+  {
+    id = (unsigned)(n++ % NIDS);
+    assert(sha1_keys_get(keys, id, &key) == shaSuccess);
+    for (v = 0; v < NVERSIONS; ++v)
+    {
+      if (memcmp(&key, &versions[id][v], sizeof(key)) == 0)
+      {
+        break;
+      }
+    }
+    assert(v < NVERSIONS);
+  }
+  return 0;
+}
+
+
+/*
+ *  sha1_keys: publication, rotation, removal, LRU eviction with a
+ *  loader, and lookups racing with rotations on several threads.
+ */
+int main()
+{
+  struct sha1_keys* keys;
+  struct hmac_sha1_key key, expected;
+  pthread_t threads[NREADERS];
+  uint8_t raw[80];
+  unsigned i, id, v;
+
+  printf("\n");
+
+  keys = sha1_keys_create(100, 0, 0);
+  assert(keys != 0);
+  hmac_sha1_key_init(&expected, (const uint8_t*)"secret", 6);
+  assert(sha1_keys_put(keys, 42, (const uint8_t*)"secret", 6) == shaSuccess);
+  assert(sha1_keys_get(keys, 42, &key) == shaSuccess);
+  assert(memcmp(&key, &expected, sizeof(key)) == 0);
+  assert(sha1_keys_get(keys, 43, &key) == shaBadParam);
+
+  hmac_sha1_key_init(&expected, (const uint8_t*)"rotated", 7);
+  assert(sha1_keys_put(keys, 42, (const uint8_t*)"rotated", 7) == shaSuccess);
+  assert(sha1_keys_count(keys) == 1);
+  assert(sha1_keys_get(keys, 42, &key) == shaSuccess);
+  assert(memcmp(&key, &expected, sizeof(key)) == 0);
+
+  assert(sha1_keys_remove(keys, 42) == shaSuccess);
+  assert(sha1_keys_remove(keys, 42) == shaBadParam);
+  assert(sha1_keys_get(keys, 42, &key) == shaBadParam);
+  assert(sha1_keys_count(keys) == 0);
+  assert(sha1_keys_put(keys, 1, 0, 1) == shaNull);
+  assert(sha1_keys_get(0, 1, &key) == shaNull);
+  sha1_keys_destroy(keys);
+  assert(sha1_keys_create(0, 0, 0) == 0);
+  printf("  sha1_keys: put, rotate, get and remove match hmac_sha1_key_init.\n");
+
+  /* capacity 8: key 0 stays hot, keys 1 .. 99 stream through */
+  keys = sha1_keys_create(8, load, 0);
+  assert(keys != 0);
+  for (id = 0; id < 100; ++id)
+  {
+    assert(sha1_keys_get(keys, id, &key) == shaSuccess);
+    make_key(id, 0, &expected);
+    assert(memcmp(&key, &expected, sizeof(key)) == 0);
+    assert(sha1_keys_get(keys, 0, &key) == shaSuccess);
+    assert(sha1_keys_count(keys) <= 8);
+  }
+  assert(loads == 100);
+  assert(sha1_keys_get(keys, 99, &key) == shaSuccess);
+  assert(loads == 100);
+  assert(sha1_keys_get(keys, 1, &key) == shaSuccess);
+  assert(loads == 101);
+  assert(sha1_keys_get(keys, 1000, &key) == shaBadParam);
+  sha1_keys_destroy(keys);
+  printf("  sha1_keys: a hot key survives 99 others through 8 slots, evicted keys reload.\n");
+
+  /* rotations racing with lock-free lookups */
+  for (id = 0; id < NIDS; ++id)
+  {
+    for (v = 0; v < NVERSIONS; ++v)
+    {
+      make_key(id, v, &versions[id][v]);
+    }
+  }
+  keys = sha1_keys_create(NIDS, 0, 0);
+  assert(keys != 0);
+  for (id = 0; id < NIDS; ++id)
+  {
+    assert(sha1_keys_put(keys, id, raw, raw_key(id, 0, raw)) == shaSuccess);
+  }
+  for (i = 0; i < NREADERS; ++i)
+  {
+    assert(pthread_create(&threads[i], 0, reader, keys) == 0);
+  }
+  for (i = 0; i < NROTATIONS; ++i)
+  {
+    id = i % NIDS;
+    v  = (i / NIDS + 1) % NVERSIONS;
+    assert(sha1_keys_put(keys, id, raw, raw_key(id, v, raw)) == shaSuccess);
+  }
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+  for (i = 0; i < NREADERS; ++i)
+  {
+    pthread_join(threads[i], 0);
+  }
+  assert(sha1_keys_count(keys) == NIDS);
+  sha1_keys_destroy(keys);
+  printf("  sha1_keys: %u rotations under %u lock-free readers, no torn or freed keys seen.\n", NROTATIONS, NREADERS);
+
+  printf("\n");
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sha1.h"
+#include "sha256.h"
+#include "hmac.h"
+#include "hmac_sha256.h"
+
+
+#define NMSGS   300             /* messages of length 0 .. NMSGS-1, all block/padding boundaries */
+#define PREFIX  200             /* longest shared prefix */
+
+
+static void calculate_sha1(const uint8_t* msg, unsigned nbytes, uint8_t* output)
+{
+  struct sha1 ctx;
+
+  assert(sha1_reset(&ctx) == 0);
+  assert(sha1_input(&ctx, msg, nbytes) == 0);
+  assert(sha1_result(&ctx, output) == 0);
+}
+
+
+/*
+ *  Check sha1_multi_from(), sha256_multi_from(), hmac_sha1_batch_from()
+ *  and hmac_sha256_batch_from() over prefixes of plen octets against
+ *  clones of the prefix context finished one by one.
+ */
+static void check_prefix(const uint8_t* prefix, unsigned plen, const uint8_t* const* msgs, const size_t* lens, unsigned n)
+{
+  static uint8_t digests[NMSGS][SHA1HashSize];
+  static uint8_t digests256[NMSGS][SHA256HashSize];
+  static uint8_t hmacs[NMSGS][HMAC_SHA1_DIGEST_SIZE];
+  static uint8_t hmacs256[NMSGS][HMAC_SHA256_DIGEST_SIZE];
+  uint8_t expected[SHA256HashSize];
+  struct sha1 ctx, fork;
+  struct sha256 ctx256, fork256;
+  struct hmac_sha1_ctx mac, mac_fork;
+  struct hmac_sha256_ctx mac256, mac256_fork;
+  unsigned i;
+
+  sha1_reset(&ctx);
+  sha1_input(&ctx, prefix, plen);
+  sha256_reset(&ctx256);
+  sha256_input(&ctx256, prefix, plen);
+  hmac_sha1_init(&mac, prefix, 20);
+  hmac_sha1_update(&mac, prefix, plen);
+  hmac_sha256_init(&mac256, prefix, 32);
+  hmac_sha256_update(&mac256, prefix, plen);
+
+  assert(sha1_multi_from(&ctx, msgs, lens, n, digests) == shaSuccess);
+  assert(sha256_multi_from(&ctx256, msgs, lens, n, digests256) == shaSuccess);
+  assert(hmac_sha1_batch_from(&mac, msgs, lens, n, hmacs) == shaSuccess);
+  assert(hmac_sha256_batch_from(&mac256, msgs, lens, n, hmacs256) == shaSuccess);
+
+  for (i = 0; i < n; ++i)
+  {
+    assert(sha1_clone(&fork, &ctx) == shaSuccess);
+    sha1_input(&fork, msgs[i], lens[i]);
+    sha1_result(&fork, expected);
+    assert(memcmp(digests[i], expected, SHA1HashSize) == 0);
+
+    assert(sha256_clone(&fork256, &ctx256) == shaSuccess);
+    sha256_input(&fork256, msgs[i], lens[i]);
+    sha256_result(&fork256, expected);
+    assert(memcmp(digests256[i], expected, SHA256HashSize) == 0);
+
+    assert(hmac_sha1_clone(&mac_fork, &mac) == shaSuccess);
+    hmac_sha1_update(&mac_fork, msgs[i], lens[i]);
+    hmac_sha1_final(&mac_fork, expected);
+    assert(memcmp(hmacs[i], expected, HMAC_SHA1_DIGEST_SIZE) == 0);
+
+    assert(hmac_sha256_clone(&mac256_fork, &mac256) == shaSuccess);
+    hmac_sha256_update(&mac256_fork, msgs[i], lens[i]);
+    hmac_sha256_final(&mac256_fork, expected);
+    assert(memcmp(hmacs256[i], expected, HMAC_SHA256_DIGEST_SIZE) == 0);
+  }
+
+  /* the prefix contexts are still usable, and finished ones are refused */
+  sha1_result(&ctx, expected);
+  assert(sha1_multi_from(&ctx, msgs, lens, n, digests) == shaStateError);
+  hmac_sha1_final(&mac, expected);
+  assert(hmac_sha1_batch_from(&mac, msgs, lens, n, hmacs) == shaStateError);
+}
+
+
+/*
+ *  Hash messages of every length from 0 to NMSGS-1 with sha1_multi() on
+ *  every multi-buffer backend the CPU supports, in an order that mixes
+ *  short and long messages so lanes finish at different times, and
+ *  compare against sha1_input()/sha1_result().  Then the same messages
+ *  as suffixes of shared prefixes of assorted lengths.
+ */
+int main()
+{
+  static uint8_t data[NMSGS];
+  static uint8_t expected[NMSGS][SHA1HashSize];
+  static uint8_t digests[NMSGS][SHA1HashSize];
+  const uint8_t* msgs[NMSGS];
+  size_t lens[NMSGS];
+  static const unsigned plens[] = { 0, 1, 55, 63, 64, 65, 128, PREFIX };
+  static uint8_t prefix[PREFIX];
+  const char* name;
+  unsigned i, b, p;
+
+  for (i = 0; i < NMSGS; ++i)
+  {
+    data[i] = (uint8_t)(i * 131 + 7);
+  }
+  for (i = 0; i < PREFIX; ++i)
+  {
+    prefix[i] = (uint8_t)(i * 29 + 3);
+  }
+
+  for (i = 0; i < NMSGS; ++i)
+  {
+    lens[i] = (i & 1) ? (NMSGS - 1 - i) : i;
+    msgs[i] = data + (i % 5);
+    if (lens[i] + (i % 5) > NMSGS)
+    {
+      lens[i] = NMSGS - (i % 5);
+    }
+    calculate_sha1(msgs[i], lens[i], expected[i]);
+  }
+
+  printf("\n");
+
+  for (b = 0; (name = sha1_mb_backend_at(b)) != 0; ++b)
+  {
+    assert(sha1_mb_set_backend(name) == shaSuccess);
+    memset(digests, 0, sizeof(digests));
+
+    assert(sha1_multi(msgs, lens, NMSGS, digests) == shaSuccess);
+
+    for (i = 0; i < NMSGS; ++i)
+    {
+      assert(memcmp(digests[i], expected[i], SHA1HashSize) == 0);
+    }
+    printf("  sha1_multi: %u messages match sha1_input on the %s backend.\n", NMSGS, name);
+
+    for (p = 0; p < sizeof(plens) / sizeof(*plens); ++p)
+    {
+      check_prefix(prefix, plens[p], msgs, lens, NMSGS);
+    }
+    printf("  sha*_multi_from / hmac_sha*_batch_from: shared prefixes of 0 .. %u octets match clones.\n", PREFIX);
+  }
+
+  assert(sha1_mb_set_backend("no-such-backend") == shaBadParam);
+  assert(sha1_multi(msgs, lens, 0, digests) == shaSuccess);
+
+  printf("\n");
+
+  return 0;
+}
+
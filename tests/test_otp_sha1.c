@@ -0,0 +1,128 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "otp.h"
+
+
+#define NCODES  100
+
+
+/* RFC 4226 appendix D: secret "12345678901234567890", counters 0 .. 9 */
+static const uint32_t hotp_vectors[10] =
+{
+  755224, 287082, 359152, 969429, 338314, 254676, 287922, 162583, 399871, 520489
+};
+
+/* RFC 6238 appendix B, SHA1 column: 8 digits, 30-second steps */
+static const struct { uint64_t time; uint32_t code; } totp_vectors[] =
+{
+  { 59ull,          94287082 },
+  { 1111111109ull,   7081804 },
+  { 1111111111ull,  14050471 },
+  { 1234567890ull,  89005924 },
+  { 2000000000ull,  69279037 },
+  { 20000000000ull, 65353130 },
+};
+
+/* HOTP the long way: hmac_sha1() over the counter, then truncate */
+static uint32_t reference_hotp(const uint8_t* secret, uint32_t secretlen, uint64_t counter, unsigned digits)
+{
+  uint8_t msg[8], tag[20];
+  uint32_t bin, mod = 1;
+  unsigned i, offset;
+
+  for (i = 0; i < 8; ++i)
+  {
+    msg[i] = (uint8_t)(counter >> (8 * (7 - i)));
+  }
+  hmac_sha1(secret, secretlen, msg, 8, tag);
+
+  offset = tag[19] & 0x0F;
+  bin = ((uint32_t)(tag[offset] & 0x7F) << 24) | ((uint32_t)tag[offset + 1] << 16)
+      | ((uint32_t)tag[offset + 2] << 8) | tag[offset + 3];
+  for (i = 0; i < digits; ++i)
+  {
+    mod *= 10;
+  }
+  return bin % mod;
+}
+
+
+/*
+ *  RFC 4226 / RFC 6238 vectors, then runs of counters and verification
+ *  windows on every multi-buffer backend, compared against codes built
+ *  on hmac_sha1().
+ */
+int main()
+{
+  const uint8_t secret[] = "12345678901234567890";
+  struct hmac_sha1_key key;
+  uint32_t codes[NCODES];
+  uint64_t base = 0xFFFFFFFFull - 40;   /* run across the 32-bit carry */
+  uint64_t matched;
+  const char* name;
+  unsigned i, b, hits;
+
+  hmac_sha1_key_init(&key, secret, sizeof(secret) - 1);
+
+  printf("\n");
+
+  for (i = 0; i < 10; ++i)
+  {
+    assert(hotp_sha1(&key, i, 6) == hotp_vectors[i]);
+  }
+  for (i = 0; i < sizeof(totp_vectors) / sizeof(*totp_vectors); ++i)
+  {
+    assert(totp_sha1(&key, totp_vectors[i].time, 0, 30, 8) == totp_vectors[i].code);
+  }
+  printf("  hotp_sha1/totp_sha1: RFC 4226 and RFC 6238 vectors passed.\n");
+
+  for (b = 0; (name = sha1_mb_backend_at(b)) != 0; ++b)
+  {
+    assert(sha1_mb_set_backend(name) == shaSuccess);
+
+    assert(hotp_sha1_codes(&key, base, NCODES, 8, codes) == shaSuccess);
+    for (i = 0; i < NCODES; ++i)
+    {
+      assert(codes[i] == reference_hotp(secret, sizeof(secret) - 1, base + i, 8));
+    }
+
+    /* match inside the window, on both edges and just outside */
+    assert(hotp_sha1_verify(&key, base + 50, 10, 20, 8, codes[50], &matched) == 1 && matched == base + 50);
+    assert(hotp_sha1_verify(&key, base + 50, 10, 20, 8, codes[40], &matched) == 1 && matched == base + 40);
+    assert(hotp_sha1_verify(&key, base + 50, 10, 20, 8, codes[70], &matched) == 1 && matched == base + 70);
+    for (i = 0, hits = 0; i < NCODES; ++i)
+    {
+      hits += ((i >= 40) && (i <= 70) && (codes[i] == codes[39]));
+    }
+    assert(hotp_sha1_verify(&key, base + 50, 10, 20, 8, codes[39], 0) == (hits != 0));
+    assert(hotp_sha1_verify(&key, base + 50, 10, 20, 8, 100000000, 0) == 0);
+
+    /* windows clipped at both ends of the counter range */
+    assert(hotp_sha1_verify(&key, 2, 5, 3, 6, hotp_vectors[0], &matched) == 1 && matched == 0);
+    assert(hotp_sha1_verify(&key, 2, 5, 3, 6, hotp_vectors[5], &matched) == 1 && matched == 5);
+    assert(hotp_sha1_verify(&key, 2, 5, 2, 6, hotp_vectors[5], 0) == 0);
+    assert(hotp_sha1_verify(&key, UINT64_MAX - 1, 1, 5, 6,
+                            reference_hotp(secret, sizeof(secret) - 1, UINT64_MAX, 6), &matched) == 1 && matched == UINT64_MAX);
+
+    assert(totp_sha1_verify(&key, 1111111111ull + 30, 0, 30, 1, 8, 14050471, &matched) == 1 && matched == 1111111111ull / 30);
+    assert(totp_sha1_verify(&key, 1111111111ull + 60, 0, 30, 1, 8, 14050471, 0) == 0);
+
+    printf("  hotp_sha1_codes/verify: %u counters match hmac_sha1 on the %s backend.\n", NCODES, name);
+  }
+
+  /* parameter checks */
+  assert(hotp_sha1_codes(&key, 0, NCODES, 0, codes) == shaBadParam);
+  assert(hotp_sha1_codes(&key, 0, NCODES, OTP_MAX_DIGITS + 1, codes) == shaBadParam);
+  assert(hotp_sha1_codes(0, 0, NCODES, 6, codes) == shaNull);
+  assert(hotp_sha1_codes(&key, 0, 0, 6, 0) == shaSuccess);
+  assert(hotp_sha1_verify(&key, 0, 1, 1, 0, 0, 0) == 0);
+  assert(totp_sha1(&key, 59, 0, 0, 8) == 0);
+
+  printf("\n");
+
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "pbkdf2.h"
+
+
+#define NPASS     37            /* passwords of length 0, 2, .. 72: short keys and hashed keys */
+#define DKLEN     45            /* three output blocks, the last one truncated */
+#define ITERS     5
+
+
+struct test_vector
+{
+  const char* pass;
+  uint32_t    passlen;
+  const char* salt;
+  uint32_t    saltlen;
+  uint32_t    iterations;
+  const char* dk;
+  size_t      dklen;
+};
+
+/* RFC 6070 test vectors (the 16777216-iteration one is left out to keep the test fast) */
+static const struct test_vector vectors[] =
+{
+  { "password", 8, "salt", 4, 1,
+    "\x0c\x60\xc8\x0f\x96\x1f\x0e\x71\xf3\xa9\xb5\x24\xaf\x60\x12\x06\x2f\xe0\x37\xa6", 20 },
+  { "password", 8, "salt", 4, 2,
+    "\xea\x6c\x01\x4d\xc7\x2d\x6f\x8c\xcd\x1e\xd9\x2a\xce\x1d\x41\xf0\xd8\xde\x89\x57", 20 },
+  { "password", 8, "salt", 4, 4096,
+    "\x4b\x00\x79\x01\xb7\x65\x48\x9a\xbe\xad\x49\xd9\x26\xf7\x21\xd0\x65\xa4\x29\xc1", 20 },
+  { "passwordPASSWORDpassword", 24, "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+    "\x3d\x2e\xec\x4f\xe4\x1c\x84\x9b\x80\xc8\xd8\x36\x62\xc0\xe4\x4a\x8b\x29\x1a\x96\x4c\xf2\xf0\x70\x38", 25 },
+  { "pass\0word", 9, "sa\0lt", 5, 4096,
+    "\x56\xfa\x6a\xa7\x55\x48\x09\x9d\xcc\x37\xd7\xf0\x34\x25\xe0\xc3", 16 },
+};
+
+/* Straight from RFC 8018: one full hmac_sha1() per iteration */
+static void reference_pbkdf2(const uint8_t* pass, uint32_t passlen, const uint8_t* salt, uint32_t saltlen,
+                             uint32_t iterations, uint8_t* out, size_t outlen)
+{
+  uint8_t msg[256];
+  uint8_t u[20], t[20];
+  uint32_t block, j, i;
+  size_t n;
+
+  for (block = 1; outlen > 0; ++block)
+  {
+    memcpy(msg, salt, saltlen);
+    msg[saltlen + 0] = (uint8_t)(block >> 24);
+    msg[saltlen + 1] = (uint8_t)(block >> 16);
+    msg[saltlen + 2] = (uint8_t)(block >> 8);
+    msg[saltlen + 3] = (uint8_t)(block);
+    hmac_sha1(pass, passlen, msg, saltlen + 4, u);
+    memcpy(t, u, 20);
+    for (j = 1; j < iterations; ++j)
+    {
+      hmac_sha1(pass, passlen, u, 20, u);
+      for (i = 0; i < 20; ++i)
+      {
+        t[i] ^= u[i];
+      }
+    }
+    n = (outlen < 20) ? outlen : 20;
+    memcpy(out, t, n);
+    out += n;
+    outlen -= n;
+  }
+}
+
+
+/*
+ *  RFC 6070 vectors through pbkdf2_hmac_sha1(), then many passwords at
+ *  once through pbkdf2_hmac_sha1_multi() on every multi-buffer backend,
+ *  compared against a textbook implementation on top of hmac_sha1().
+ */
+int main()
+{
+  static uint8_t data[2 * NPASS];
+  static uint8_t expected[NPASS][DKLEN];
+  static uint8_t derived[NPASS][DKLEN];
+  const uint8_t* pass[NPASS];
+  size_t lens[NPASS];
+  const uint8_t salt[] = "NaCl, 16 bytes!";
+  uint8_t dk[32];
+  const char* name;
+  unsigned i, b;
+
+  printf("\n");
+
+  for (i = 0; i < sizeof(vectors) / sizeof(*vectors); ++i)
+  {
+    memset(dk, 0, sizeof(dk));
+    assert(pbkdf2_hmac_sha1((const uint8_t*)vectors[i].pass, vectors[i].passlen,
+                            (const uint8_t*)vectors[i].salt, vectors[i].saltlen,
+                            vectors[i].iterations, dk, vectors[i].dklen) == shaSuccess);
+    assert(memcmp(dk, vectors[i].dk, vectors[i].dklen) == 0);
+    assert(dk[vectors[i].dklen] == 0);
+  }
+  printf("  pbkdf2_hmac_sha1: %u RFC 6070 vectors passed.\n", (unsigned)(sizeof(vectors) / sizeof(*vectors)));
+
+  for (i = 0; i < sizeof(data); ++i)
+  {
+    data[i] = (uint8_t)(i * 73 + 1);
+  }
+  for (i = 0; i < NPASS; ++i)
+  {
+    pass[i] = data + (i % 3);
+    lens[i] = 2 * i;
+    reference_pbkdf2(pass[i], (uint32_t)lens[i], salt, sizeof(salt) - 1, ITERS, expected[i], DKLEN);
+  }
+
+  for (b = 0; (name = sha1_mb_backend_at(b)) != 0; ++b)
+  {
+    assert(sha1_mb_set_backend(name) == shaSuccess);
+    memset(derived, 0, sizeof(derived));
+
+    assert(pbkdf2_hmac_sha1_multi(pass, lens, NPASS, salt, sizeof(salt) - 1, ITERS, derived[0], DKLEN) == shaSuccess);
+
+    for (i = 0; i < NPASS; ++i)
+    {
+      assert(memcmp(derived[i], expected[i], DKLEN) == 0);
+    }
+    printf("  pbkdf2_hmac_sha1_multi: %u passwords match the reference on the %s backend.\n", NPASS, name);
+  }
+
+  /* parameter checks */
+  assert(pbkdf2_hmac_sha1(0, 1, salt, 4, 1, dk, 20) == shaNull);
+  assert(pbkdf2_hmac_sha1(data, 1, 0, 4, 1, dk, 20) == shaNull);
+  assert(pbkdf2_hmac_sha1(data, 1, salt, 4, 1, 0, 20) == shaNull);
+  assert(pbkdf2_hmac_sha1(data, 1, salt, 4, 0, dk, 20) == shaBadParam);
+  assert(pbkdf2_hmac_sha1(0, 0, 0, 0, 1, dk, 20) == shaSuccess);
+  assert(pbkdf2_hmac_sha1_multi(pass, lens, 0, salt, 4, 1, 0, 20) == shaSuccess);
+
+  printf("\n");
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_stats.h"
+
+
+#define NTHREADS  4
+#define NMACS     1000
+#define MACLEN    100               /* two inner blocks, bucket 7 */
+#define NMULTI    10                /* messages of MACLEN octets: two blocks each */
+
+
+static uint8_t message[1 << 16];
+
+
+/* NMACS one-shot MACs, then the thread exits and its counts must survive */
+static void* worker(void* arg)
+{
+  uint8_t tag[HMAC_SHA1_DIGEST_SIZE];
+  unsigned i;
+
+  (void)arg;
+  for (i = 0; i < NMACS; ++i)
+  {
+    hmac_sha1((const uint8_t*)"key", 3, message, MACLEN, tag);
+  }
+  return 0;
+}
+
+static uint64_t total_blocks(const struct sha1_stats* stats)
+{
+  uint64_t n = 0;
+  unsigned i;
+
+  for (i = 0; i < SHA1_STATS_BACKENDS; ++i)
+  {
+    n += stats->blocks[i];
+  }
+  return n;
+}
+
+static uint64_t total_mb_blocks(const struct sha1_stats* stats)
+{
+  uint64_t n = 0;
+  unsigned i;
+
+  for (i = 0; i < SHA1_STATS_BACKENDS; ++i)
+  {
+    n += stats->mb_blocks[i];
+  }
+  return n;
+}
+
+/* index of the multi-buffer kernel 'name' in a snapshot */
+static unsigned mb_index(const struct sha1_stats* stats, const char* name)
+{
+  unsigned k;
+
+  for (k = 0; strcmp(stats->mb_kernels[k], name) != 0; ++k)
+  {
+    assert(stats->mb_kernels[k + 1] != 0);
+  }
+  return k;
+}
+
+static uint64_t total_of(const uint64_t* histogram)
+{
+  uint64_t n = 0;
+  unsigned i;
+
+  for (i = 0; i < SHA1_STATS_BUCKETS; ++i)
+  {
+    n += histogram[i];
+  }
+  return n;
+}
+
+
+/*
+ *  SHA1_STATS: per-call, per-block and HMAC counters and histograms on
+ *  one thread, then merged across threads that have exited.
+ */
+int main()
+{
+  struct sha1_stats stats;
+  struct hmac_sha1_key key;
+  struct sha1 ctx;
+  uint8_t digest[SHA1HashSize];
+  pthread_t threads[NTHREADS];
+  const uint8_t* msgs[NMULTI];
+  size_t lens[NMULTI];
+  uint8_t digests[NMULTI][SHA1HashSize];
+  const char* backend;
+  const char* kernels[2];
+  unsigned i, b, k;
+
+  printf("\n");
+
+  assert(sha1_stats_snapshot(0) == shaNull);
+  assert(sha1_stats_snapshot(&stats) == shaSuccess);
+  backend = sha1_backend();
+  for (b = 0; strcmp(stats.backends[b], backend) != 0; ++b)
+  {
+    assert(stats.backends[b + 1] != 0);
+  }
+
+  /* 0 + 1 + 64 + 1000 octets: 1065 octets, 16 whole blocks, 17 with padding */
+  sha1_stats_reset();
+  sha1_reset(&ctx);
+  sha1_input(&ctx, message, 0);
+  sha1_input(&ctx, message, 1);
+  sha1_input(&ctx, message, 64);
+  sha1_input(&ctx, message, 1000);
+  sha1_result(&ctx, digest);
+  assert(sha1_stats_snapshot(&stats) == shaSuccess);
+  assert(stats.input_calls == 3);
+  assert(stats.input_bytes == 1065);
+  assert(stats.input_sizes[1] == 1);          /* 1           */
+  assert(stats.input_sizes[7] == 1);          /* 64 .. 127   */
+  assert(stats.input_sizes[10] == 1);         /* 512 .. 1023 */
+  assert(stats.blocks[b] == 17);
+  assert(total_blocks(&stats) == 17);
+  assert(stats.hmac_calls == 0);
+  printf("  sha1_stats: input calls, octets, size buckets and %s blocks counted.\n", backend);
+
+  /* with_key on a short and a long message */
+  sha1_stats_reset();
+  hmac_sha1_key_init(&key, (const uint8_t*)"key", 3);
+  hmac_sha1_with_key(&key, message, 20, digest);
+  hmac_sha1_with_key(&key, message, 5000, digest);
+  assert(sha1_stats_snapshot(&stats) == shaSuccess);
+  assert(stats.hmac_calls == 2);
+  assert(stats.hmac_bytes == 5020);
+  assert(stats.hmac_sizes[5] == 1);           /* 16 .. 31     */
+  assert(stats.hmac_sizes[13] == 1);          /* 4096 .. 8191 */
+  assert(total_of(stats.hmac_ns) == 2);
+  /* 2 pad blocks of key_init, 1 + 1 padded, then 78 whole + 1 padded inner and 1 outer */
+  assert(total_blocks(&stats) == 84);
+  printf("  sha1_stats: hmac_sha1_with_key calls, sizes, latencies and blocks counted.\n");
+
+  /* multi-buffer blocks count for the kernel only, the serial one included */
+  for (i = 0; i < NMULTI; ++i)
+  {
+    msgs[i] = message + i;
+    lens[i] = MACLEN;
+  }
+  kernels[0] = sha1_mb_backend();
+  kernels[1] = "serial";
+  for (k = 0; k < 2; ++k)
+  {
+    assert(sha1_mb_set_backend(kernels[k]) == shaSuccess);
+    sha1_stats_reset();
+    assert(sha1_multi(msgs, lens, NMULTI, digests) == shaSuccess);
+    assert(sha1_stats_snapshot(&stats) == shaSuccess);
+    assert(stats.mb_blocks[mb_index(&stats, kernels[k])] == NMULTI * 2);
+    assert(total_mb_blocks(&stats) == NMULTI * 2);
+    assert(total_blocks(&stats) == 0);
+  }
+  assert(sha1_mb_set_backend(kernels[0]) == shaSuccess);
+  printf("  sha1_stats: sha1_multi blocks counted once, for the %s and serial kernels.\n", kernels[0]);
+
+  /* threads that exit before the snapshot */
+  sha1_stats_reset();
+  for (i = 0; i < NTHREADS; ++i)
+  {
+    assert(pthread_create(&threads[i], 0, worker, 0) == 0);
+  }
+  for (i = 0; i < NTHREADS; ++i)
+  {
+    pthread_join(threads[i], 0);
+  }
+  assert(sha1_stats_snapshot(&stats) == shaSuccess);
+  assert(stats.hmac_calls == NTHREADS * NMACS);
+  assert(stats.hmac_bytes == NTHREADS * NMACS * MACLEN);
+  assert(stats.hmac_sizes[7] == NTHREADS * NMACS);
+  assert(total_of(stats.hmac_ns) == NTHREADS * NMACS);
+  /* per MAC: key block x2 (key_init), 1 whole + 1 padded inner, 1 outer */
+  assert(total_blocks(&stats) == NTHREADS * NMACS * 5);
+  printf("  sha1_stats: %u MACs on %u exited threads merged into the snapshot.\n", NTHREADS * NMACS, NTHREADS);
+
+  printf("\n");
+
+  return 0;
+}
@@ -28,7 +28,7 @@ static void compare_output_with_expected(const uint8_t* actual, const uint8_t* e
  */
 int main(int argc, char* argv[])
 {
-  uint8_t input_bin[1024];
+  uint8_t* input_bin;
   uint8_t expected_bin[20];
   uint8_t digest_bin[20];
   uint32_t input_len;
@@ -44,6 +44,10 @@ int main(int argc, char* argv[])
   /* Check that length of string-arguments are correct */
   check_format_args(argv, input_len, output_len);
 
+  /* Input of any size: allocate room for it */
+  input_bin = malloc((input_len / 2) + 1);
+  assert(input_bin != 0);
+
   /* Copy and convert input and expected-output from hex-string to binary */
   copy_input_args(argv, input_len, output_len, input_bin, expected_bin);
 
@@ -53,6 +57,8 @@ int main(int argc, char* argv[])
   /* Compare HASH(input) to expected-output */
   compare_output_with_expected(digest_bin, expected_bin);
 
+  free(input_bin);
+
   return 0;
 }
 
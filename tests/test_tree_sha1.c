@@ -0,0 +1,199 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_tree.h"
+
+
+#define CHUNK     4096
+#define LENGTH    (37 * CHUNK + 1000)   /* 38 chunks, the last one short */
+#define NCHUNKS   38
+
+
+static const uint8_t secret[] = "tree mode key";
+
+
+/* leaf i by the definition: HMAC(K, 0x00 || uint64(i) || chunk) over one contiguous buffer */
+static void ref_leaf(const uint8_t* data, uint64_t length, uint64_t chunk, uint64_t i, uint8_t tag[20])
+{
+  static uint8_t msg[9 + CHUNK];
+  size_t len = (size_t)((length - i * chunk < chunk) ? length - i * chunk : chunk);
+  int b;
+
+  msg[0] = 0x00;
+  for (b = 0; b < 8; ++b)
+  {
+    msg[1 + b] = (uint8_t)(i >> (56 - 8 * b));
+  }
+  memcpy(msg + 9, data + i * chunk, len);
+  hmac_sha1(secret, sizeof(secret), msg, 9 + len, tag);
+}
+
+static void ref_node(const uint8_t left[20], const uint8_t right[20], uint8_t tag[20])
+{
+  uint8_t msg[41];
+
+  msg[0] = 0x01;
+  memcpy(msg + 1, left, 20);
+  memcpy(msg + 21, right, 20);
+  hmac_sha1(secret, sizeof(secret), msg, sizeof(msg), tag);
+}
+
+static void ref_root(uint64_t length, uint64_t chunk, const uint8_t top[20], uint8_t tag[20])
+{
+  uint8_t msg[37];
+  int b;
+
+  msg[0] = 0x02;
+  for (b = 0; b < 8; ++b)
+  {
+    msg[1 + b] = (uint8_t)(length >> (56 - 8 * b));
+    msg[9 + b] = (uint8_t)(chunk >> (56 - 8 * b));
+  }
+  memcpy(msg + 17, top, 20);
+  hmac_sha1(secret, sizeof(secret), msg, sizeof(msg), tag);
+}
+
+
+/*
+ *  HMAC-SHA1 tree mode: tags against the definition built from
+ *  hmac_sha1(), thread counts, the manifest round trip, and re-MACing
+ *  and checking single chunks.
+ */
+int main()
+{
+  static uint8_t leaves[NCHUNKS][20], again[NCHUNKS][20];
+  struct hmac_sha1_key key;
+  struct sha1_tree tree;
+  uint8_t l[5][20], n01[20], n23[20], n03[20], top[20];
+  uint8_t root[20], expected[20];
+  uint8_t* data;
+  uint8_t* manifest;
+  size_t size, i;
+  unsigned threads[] = { 1, 3, 8, 0 };
+
+  printf("\n");
+
+  data = malloc(LENGTH);
+  assert(data != 0);
+  for (i = 0; i < LENGTH; ++i)
+  {
+    data[i] = (uint8_t)(i * 2654435761u >> 24);
+  }
+  hmac_sha1_key_init(&key, secret, sizeof(secret));
+
+  /* shapes of 1, 2, 3 and 5 chunks of 64 octets */
+  for (i = 0; i < 5; ++i)
+  {
+    ref_leaf(data, 5 * 64, 64, i, l[i]);
+  }
+  ref_root(64, 64, l[0], expected);
+  assert(sha1_tree_mac(&key, data, 64, 64, 1, 0, root) == shaSuccess);
+  assert(memcmp(root, expected, 20) == 0);
+
+  ref_leaf(data, 128, 64, 1, l[1]);
+  ref_node(l[0], l[1], n01);
+  ref_root(128, 64, n01, expected);
+  assert(sha1_tree_mac(&key, data, 128, 64, 2, 0, root) == shaSuccess);
+  assert(memcmp(root, expected, 20) == 0);
+
+  ref_leaf(data, 150, 64, 2, l[2]);             /* short last chunk */
+  ref_node(n01, l[2], top);
+  ref_root(150, 64, top, expected);
+  assert(sha1_tree_mac(&key, data, 150, 64, 2, 0, root) == shaSuccess);
+  assert(memcmp(root, expected, 20) == 0);
+
+  ref_leaf(data, 5 * 64, 64, 2, l[2]);
+  ref_node(l[2], l[3], n23);
+  ref_node(n01, n23, n03);
+  ref_node(n03, l[4], top);
+  ref_root(5 * 64, 64, top, expected);
+  assert(sha1_tree_mac(&key, data, 5 * 64, 64, 4, 0, root) == shaSuccess);
+  assert(memcmp(root, expected, 20) == 0);
+
+  /* the empty object is one empty chunk */
+  ref_leaf(data, 0, 64, 0, l[0]);
+  ref_root(0, 64, l[0], expected);
+  assert(sha1_tree_count(0, 64) == 1);
+  assert(sha1_tree_mac(&key, 0, 0, 64, 0, 0, root) == shaSuccess);
+  assert(memcmp(root, expected, 20) == 0);
+  printf("  sha1_tree: 0 to 5 chunks match leaf, node and root built from hmac_sha1().\n");
+
+  /* any number of threads gives the same leaves and root */
+  assert(sha1_tree_count(LENGTH, CHUNK) == NCHUNKS);
+  assert(sha1_tree_mac(&key, data, LENGTH, CHUNK, 1, leaves, expected) == shaSuccess);
+  for (i = 0; i < NCHUNKS; ++i)
+  {
+    ref_leaf(data, LENGTH, CHUNK, i, l[0]);
+    assert(memcmp(leaves[i], l[0], 20) == 0);
+  }
+  for (i = 0; i < sizeof(threads) / sizeof(*threads); ++i)
+  {
+    memset(again, 0, sizeof(again));
+    assert(sha1_tree_mac(&key, data, LENGTH, CHUNK, threads[i], again, root) == shaSuccess);
+    assert(memcmp(root, expected, 20) == 0);
+    assert(memcmp(again, leaves, sizeof(leaves)) == 0);
+  }
+  printf("  sha1_tree: %u chunks on 1, 3, 8 and all CPUs give the same tags.\n", NCHUNKS);
+
+  /* manifest round trip */
+  size = sha1_tree_manifest_size(LENGTH, CHUNK);
+  assert(size == SHA1_TREE_HEADER + NCHUNKS * 20);
+  manifest = malloc(size);
+  assert(manifest != 0);
+  assert(sha1_tree_manifest_write(manifest, LENGTH, CHUNK, (const uint8_t (*)[20])leaves, expected) == shaSuccess);
+  assert(memcmp(manifest, "HMACTREE\0\0\0\1\0\0\0\1", 16) == 0);
+  assert(sha1_tree_manifest_read(manifest, size, &tree) == shaSuccess);
+  assert((tree.length == LENGTH) && (tree.chunk_size == CHUNK) && (tree.count == NCHUNKS));
+  assert(sha1_tree_verify(&key, &tree) == 1);
+  for (i = 0; i < NCHUNKS; ++i)
+  {
+    assert(sha1_tree_verify_chunk(&key, &tree, i, data + i * CHUNK, (i == NCHUNKS - 1) ? 1000 : CHUNK) == 1);
+  }
+  assert(sha1_tree_verify_chunk(&key, &tree, 0, data, CHUNK - 1) == 0);
+  assert(sha1_tree_verify_chunk(&key, &tree, NCHUNKS, data, 0) == 0);
+
+  /* a tampered leaf tag fails the manifest, malformed manifests are rejected */
+  tree.leaves[7][3] ^= 1;
+  assert(sha1_tree_verify(&key, &tree) == 0);
+  tree.leaves[7][3] ^= 1;
+  assert(sha1_tree_manifest_read(manifest, size - 1, &tree) == shaBadParam);
+  manifest[0] ^= 1;
+  assert(sha1_tree_manifest_read(manifest, size, &tree) == shaBadParam);
+  manifest[0] ^= 1;
+  manifest[11] = 2;
+  assert(sha1_tree_manifest_read(manifest, size, &tree) == shaBadParam);
+  manifest[11] = SHA1_TREE_VERSION;
+  assert(sha1_tree_manifest_read(manifest, size, &tree) == shaSuccess);
+  printf("  sha1_tree: manifest round trip, tampered tags and headers rejected.\n");
+
+  /* modify one chunk: only it fails, re-MACing it and the root matches a full pass */
+  data[20 * CHUNK + 5] ^= 0x40;
+  for (i = 0; i < NCHUNKS; ++i)
+  {
+    assert(sha1_tree_verify_chunk(&key, &tree, i, data + i * CHUNK, (i == NCHUNKS - 1) ? 1000 : CHUNK) == (i != 20));
+  }
+  assert(sha1_tree_leaf(&key, 20, data + 20 * CHUNK, CHUNK, tree.leaves[20]) == shaSuccess);
+  assert(sha1_tree_root(&key, tree.length, tree.chunk_size, (const uint8_t (*)[20])tree.leaves, tree.root) == shaSuccess);
+  assert(sha1_tree_verify(&key, &tree) == 1);
+  assert(sha1_tree_mac(&key, data, LENGTH, CHUNK, 0, 0, root) == shaSuccess);
+  assert(memcmp(root, tree.root, 20) == 0);
+  assert(memcmp(root, expected, 20) != 0);
+  printf("  sha1_tree: one modified chunk found and re-MACed in place in the manifest.\n");
+
+  /* parameters */
+  assert(sha1_tree_count(LENGTH, 100) == 0);
+  assert(sha1_tree_manifest_size(LENGTH, 0) == 0);
+  assert(sha1_tree_mac(&key, data, LENGTH, 100, 0, 0, root) == shaBadParam);
+  assert(sha1_tree_mac(&key, 0, LENGTH, CHUNK, 0, 0, root) == shaNull);
+  assert(sha1_tree_root(&key, LENGTH, CHUNK, 0, root) == shaNull);
+
+  free(manifest);
+  free(data);
+
+  printf("\n");
+
+  return 0;
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_engine.h"
+
+
+/*
+ *
+ *  Bulk test-vector runner:
+ *  ------------------------
+ *
+ *     test_vectors_sha1 [-j threads] [file ...]        (no file or '-' = stdin)
+ *
+ *  Reads test vectors and checks all of them in-process, on a pool of
+ *  'threads' workers (default: one per CPU).  Records are read in batches
+ *  of bounded size, so files of any length work.
+ *
+ *  Text format, one vector per line, empty fields written as '-':
+ *
+ *     sha1 <msg-hex> <digest-hex>
+ *     hmac <key-hex> <msg-hex> <digest-hex>
+ *     # comment
+ *
+ *  Binary format, after the 8-byte magic "SHA1VEC\n", little endian:
+ *
+ *     uint8  type          0 = sha1, 1 = hmac
+ *     uint32 keylen
+ *     uint64 msglen
+ *     key[keylen] msg[msglen] digest[20]
+ *
+ *  keylen + msglen must not exceed BATCH_BYTES (256 MB).
+ *
+ *  Every failing vector is printed as "FAIL <text record>"; the exit code
+ *  is the number of failures (capped at 255), or 255 if a file cannot be
+ *  read or the engine reports an error.
+ *
+ */
+
+
+#define BATCH_RECORDS   65536
+#define BATCH_BYTES     (256u << 20)
+
+struct vector
+{
+  uint8_t* key;
+  uint8_t* msg;
+  uint8_t  expected[20];
+  uint8_t  output[20];
+};
+
+static struct sha1_job jobs[BATCH_RECORDS];
+static struct vector   vectors[BATCH_RECORDS];
+static size_t          nvectors;
+static size_t          nbytes;
+static size_t          total;
+static size_t          failures;
+static unsigned        nthreads;
+
+
+static int hexval(int c)
+{
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+  return -1;
+}
+
+/* Convert a hex field ('-' for empty) into a fresh buffer; returns 0 on bad input */
+static int parse_hex(const char* s, uint8_t** out, size_t* len)
+{
+  size_t n, i;
+  int hi, lo;
+
+  if (strcmp(s, "-") == 0)
+  {
+    *out = 0;
+    *len = 0;
+    return 1;
+  }
+
+  n = strlen(s);
+  if ((n & 1) != 0)
+  {
+    return 0;
+  }
+
+  *out = malloc(n / 2 + 1);
+  if (*out == 0)
+  {
+    return 0;
+  }
+  for (i = 0; i < n / 2; ++i)
+  {
+    hi = hexval(s[2 * i]);
+    lo = hexval(s[2 * i + 1]);
+    if ((hi < 0) || (lo < 0))
+    {
+      free(*out);
+      *out = 0;                 /* the caller frees what it got */
+      return 0;
+    }
+    (*out)[i] = (uint8_t)((hi << 4) | lo);
+  }
+  *len = n / 2;
+  return 1;
+}
+
+static void print_hex(const uint8_t* p, size_t n)
+{
+  size_t i;
+
+  if (n == 0)
+  {
+    printf("-");
+  }
+  for (i = 0; i < n; ++i)
+  {
+    printf("%.02x", p[i]);
+  }
+}
+
+/* Check the current batch on the thread pool and release it */
+static void run_batch(void)
+{
+  size_t i;
+  int err;
+
+  err = sha1_engine_run(jobs, nvectors, nthreads, 0);
+  if (err != shaSuccess)
+  {
+    printf("sha1_engine_run: error %d on a batch of %zu vectors\n", err, nvectors);
+    exit(255);
+  }
+
+  for (i = 0; i < nvectors; ++i)
+  {
+    if (memcmp(vectors[i].output, vectors[i].expected, 20) != 0)
+    {
+      failures += 1;
+      printf("FAIL %s ", (jobs[i].type == sha1JobHmac) ? "hmac" : "sha1");
+      if (jobs[i].type == sha1JobHmac)
+      {
+        print_hex(jobs[i].key, jobs[i].keysize);
+        printf(" ");
+      }
+      print_hex(jobs[i].msg, jobs[i].msgsize);
+      printf(" ");
+      print_hex(vectors[i].expected, 20);
+      printf("\n");
+    }
+    free(vectors[i].key);
+    free(vectors[i].msg);
+  }
+
+  total += nvectors;
+  nvectors = 0;
+  nbytes = 0;
+}
+
+/* Queue one vector; takes ownership of key and msg */
+static void add_vector(int type, uint8_t* key, size_t keylen, uint8_t* msg, size_t msglen, const uint8_t* expected)
+{
+  struct vector* v = &vectors[nvectors];
+  struct sha1_job* j = &jobs[nvectors];
+
+  v->key = key;
+  v->msg = msg;
+  memcpy(v->expected, expected, 20);
+
+  j->type    = type;
+  j->key     = key;
+  j->keysize = keylen;
+  j->msg     = msg;
+  j->msgsize = msglen;
+  j->output  = v->output;
+
+  nvectors += 1;
+  nbytes += keylen + msglen;
+  if ((nvectors == BATCH_RECORDS) || (nbytes >= BATCH_BYTES))
+  {
+    run_batch();
+  }
+}
+
+static int read_text(FILE* f, const char* name)
+{
+  char* line = 0;
+  size_t cap = 0;
+  size_t lineno = 0;
+  ssize_t n;
+  char* field[4];
+  char* tok;
+  int nfields, type;
+  uint8_t *key, *msg, *digest;
+  size_t keylen, msglen, digestlen;
+
+  while ((n = getline(&line, &cap, f)) >= 0)
+  {
+    lineno += 1;
+
+    nfields = 0;
+    for (tok = strtok(line, " \t\r\n"); tok != 0; tok = strtok(0, " \t\r\n"))
+    {
+      if (nfields == 4)
+      {
+        nfields = 5;            /* too many fields, rejected below */
+        break;
+      }
+      field[nfields++] = tok;
+    }
+    if ((nfields == 0) || (field[0][0] == '#'))
+    {
+      continue;
+    }
+
+    type = (strcmp(field[0], "hmac") == 0) ? sha1JobHmac : sha1JobHash;
+    key = msg = digest = 0;
+    keylen = 0;
+    if (    (nfields > 4)
+         || ((type == sha1JobHash) && ((nfields != 3) || (strcmp(field[0], "sha1") != 0)))
+         || ((type == sha1JobHmac) && (nfields != 4))
+         || ((type == sha1JobHmac) && !parse_hex(field[1], &key, &keylen))
+         || !parse_hex(field[nfields - 2], &msg, &msglen)
+         || !parse_hex(field[nfields - 1], &digest, &digestlen)
+         || (digestlen != 20))
+    {
+      printf("%s:%zu: malformed vector\n", name, lineno);
+      free(key);
+      free(msg);
+      free(digest);
+      free(line);
+      return 0;
+    }
+
+    add_vector(type, key, keylen, msg, msglen, digest);
+    free(digest);
+  }
+
+  free(line);
+  return 1;
+}
+
+static int read_binary(FILE* f, const char* name)
+{
+  uint8_t hdr[13];
+  uint8_t digest[20];
+  uint64_t keylen, msglen;
+  uint8_t *key, *msg;
+  int i;
+
+  while (fread(hdr, 1, 1, f) == 1)
+  {
+    if (    (fread(hdr + 1, 1, 12, f) != 12)
+         || (hdr[0] > 1))
+    {
+      printf("%s: malformed binary record\n", name);
+      return 0;
+    }
+
+    keylen = msglen = 0;
+    for (i = 3; i >= 0; --i)
+    {
+      keylen = (keylen << 8) | hdr[1 + i];
+    }
+    for (i = 7; i >= 0; --i)
+    {
+      msglen = (msglen << 8) | hdr[5 + i];
+    }
+
+    /* lengths come from the file: bound them before allocating */
+    if (    (keylen > BATCH_BYTES)
+         || (msglen > BATCH_BYTES - keylen))
+    {
+      printf("%s: binary record of %llu + %llu octets exceeds %u\n", name,
+             (unsigned long long)keylen, (unsigned long long)msglen, BATCH_BYTES);
+      return 0;
+    }
+
+    key = malloc(keylen + 1);
+    msg = malloc(msglen + 1);
+    if (    (key == 0)
+         || (msg == 0)
+         || (fread(key, 1, keylen, f) != keylen)
+         || (fread(msg, 1, msglen, f) != msglen)
+         || (fread(digest, 1, 20, f) != 20))
+    {
+      printf("%s: truncated binary record\n", name);
+      free(key);
+      free(msg);
+      return 0;
+    }
+
+    add_vector(hdr[0] ? sha1JobHmac : sha1JobHash, key, keylen, msg, msglen, digest);
+  }
+
+  return 1;
+}
+
+static int read_file(const char* name)
+{
+  FILE* f = (strcmp(name, "-") == 0) ? stdin : fopen(name, "rb");
+  char magic[8];
+  int c, ok;
+
+  if (f == 0)
+  {
+    printf("%s: cannot open\n", name);
+    return 0;
+  }
+
+  /* text records start with a lowercase keyword, binary files with 'S' */
+  c = getc(f);
+  if (c == 'S')
+  {
+    magic[0] = 'S';
+    if (    (fread(magic + 1, 1, 7, f) == 7)
+         && (memcmp(magic, "SHA1VEC\n", 8) == 0))
+    {
+      ok = read_binary(f, name);
+    }
+    else
+    {
+      printf("%s: bad magic\n", name);
+      ok = 0;
+    }
+  }
+  else
+  {
+    if (c != EOF)
+    {
+      ungetc(c, f);
+    }
+    ok = read_text(f, name);
+  }
+
+  if (f != stdin)
+  {
+    fclose(f);
+  }
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  int nfiles = 0;
+  int ok = 1;
+  int a;
+
+  for (a = 1; a < argc; ++a)
+  {
+    if ((strcmp(argv[a], "-j") == 0) && (a + 1 < argc))
+    {
+      nthreads = (unsigned)atoi(argv[++a]);
+    }
+    else
+    {
+      ok &= read_file(argv[a]);
+      nfiles += 1;
+    }
+  }
+  if (nfiles == 0)
+  {
+    ok &= read_file("-");
+  }
+  run_batch();
+
+  printf("%zu/%zu vectors passed.\n", total - failures, total);
+
+  if (!ok)
+  {
+    return 255;
+  }
+  return (failures > 255) ? 255 : (int)failures;
+}
+
@@ -0,0 +1,699 @@
+/*
+ *  hmac-sha1sum.c
+ *
+ *  Description:
+ *      Command-line SHA-1 / HMAC-SHA1 over files, with sha1sum-compatible
+ *      output and check mode:
+ *
+ *          hmac-sha1sum [-k key | -K keyfile] [-r] [-c] [-j threads] [-m MB] [file ...]
+ *
+ *      Without a key it prints plain SHA-1 digests, with one it prints
+ *      HMAC-SHA1 tags.  No file, or '-', reads standard input.
+ *
+ *      With -r, directories are walked and every regular file below them
+ *      is listed, so the output is a manifest of the tree; -c checks such
+ *      a manifest.  Both hash their files through sha1_files_hash(), which
+ *      overlaps the reads (io_uring) with hashing on all cores.
+ *
+ *      Regular files are mapped with mmap() and handed to the hash in
+ *      large chunks of whole blocks, so sha1_input() compresses straight
+ *      from the page cache without copying.  A file truncated while it is
+ *      mapped raises SIGBUS on the missing pages; that is caught, and the
+ *      file is hashed again with read() as it is now.
+ *
+ *      Pipes, terminals and files that cannot be mapped are read into one
+ *      large aligned buffer that is filled completely before it is
+ *      hashed, so again only whole blocks reach sha1_input() until the
+ *      last read.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sha1.h"
+#include "hmac.h"
+#include "sha1_files.h"
+#include "sha1_internal.h"
+
+#define MAP_CHUNK    (64u << 20)    /* octets hashed between dropping pages of a mapping  */
+#define READ_SIZE    (1u << 20)     /* read() buffer for pipes and unmappable files       */
+#define READ_ALIGN   4096
+#define MAX_KEY      4096
+
+/* Growable list of file names, with their expected digests in check mode */
+struct list
+{
+  char**   names;
+  uint8_t  (*digests)[SHA1HashSize];
+  size_t   n;
+  size_t   cap;
+};
+
+/* Either a plain SHA-1 or an HMAC-SHA1 in progress */
+struct digest
+{
+  const struct hmac_sha1_key* key;  /* 0 for plain SHA-1 */
+  struct sha1                 sha;
+  struct hmac_sha1_ctx        hmac;
+};
+
+static const char* _prog = "hmac-sha1sum";
+static uint8_t*    _buffer = 0;
+static struct list* _walk = 0;     /* list nftw() adds to */
+static unsigned    _threads = 0;
+static size_t      _membytes = 0;
+static sigjmp_buf  _bus_jump;      /* where SIGBUS in a mapping returns to */
+
+
+static void _digest_init(struct digest* d, const struct hmac_sha1_key* key)
+{
+  d->key = key;
+  if (key != 0)
+  {
+    hmac_sha1_init_key(&d->hmac, key);
+  }
+  else
+  {
+    sha1_reset(&d->sha);
+  }
+}
+
+static int _digest_update(struct digest* d, const uint8_t* p, size_t n)
+{
+  return (d->key != 0) ? hmac_sha1_update(&d->hmac, p, n) : sha1_input(&d->sha, p, n);
+}
+
+static int _digest_final(struct digest* d, uint8_t out[SHA1HashSize])
+{
+  return (d->key != 0) ? hmac_sha1_final(&d->hmac, out) : sha1_result(&d->sha, out);
+}
+
+/* Pages past the end of a file that shrank under the mapping */
+static void _on_sigbus(int sig)
+{
+  (void)sig;
+  siglongjmp(_bus_jump, 1);
+}
+
+/*
+ * Hash a mapped regular file; returns 0, -1 with errno set if it could
+ * not be mapped, or -2 if it was truncated while being hashed (d then
+ * holds a partial digest).
+ */
+static int _hash_mapped(int fd, size_t size, struct digest* d)
+{
+  struct sigaction bus, saved;
+  const uint8_t* p;
+  size_t off, n;
+
+  p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED)
+  {
+    return -1;
+  }
+
+  memset(&bus, 0, sizeof(bus));
+  bus.sa_handler = _on_sigbus;
+  sigemptyset(&bus.sa_mask);
+  sigaction(SIGBUS, &bus, &saved);
+  if (sigsetjmp(_bus_jump, 1) != 0)
+  {
+    sigaction(SIGBUS, &saved, 0);
+    munmap((void*)p, size);
+    return -2;
+  }
+
+  /* Hints only: read ahead aggressively, use huge pages where the file system can */
+  madvise((void*)p, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise((void*)p, size, MADV_HUGEPAGE);
+#endif
+
+  for (off = 0; off < size; off += n)
+  {
+    n = ((size - off) < MAP_CHUNK) ? (size - off) : MAP_CHUNK;
+    _digest_update(d, p + off, n);
+
+    /* Done with these pages: keep the resident set small on multi-GB files */
+    madvise((void*)(p + off), n, MADV_DONTNEED);
+  }
+
+  sigaction(SIGBUS, &saved, 0);
+  munmap((void*)p, size);
+  return 0;
+}
+
+/* Hash whatever read() returns until end of file; returns 0 or -1 with errno set */
+static int _hash_stream(int fd, struct digest* d)
+{
+  size_t  fill;
+  ssize_t r;
+
+  if (_buffer == 0)
+  {
+    if (posix_memalign((void**)&_buffer, READ_ALIGN, READ_SIZE) != 0)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+  }
+
+  do
+  {
+    /* Fill the whole buffer, so that only the last update is not a multiple of the block size */
+    for (fill = 0; fill < READ_SIZE; fill += (size_t)r)
+    {
+      r = read(fd, _buffer + fill, READ_SIZE - fill);
+      if (r < 0)
+      {
+        if (errno == EINTR)
+        {
+          r = 0;
+          continue;
+        }
+        return -1;
+      }
+      if (r == 0)
+      {
+        break;
+      }
+    }
+    if (fill != 0)
+    {
+      _digest_update(d, _buffer, fill);
+    }
+  } while (fill == READ_SIZE);
+
+  return 0;
+}
+
+/* Digest of one file, '-' being standard input; returns 0 or -1 after printing an error */
+static int _hash_file(const char* name, const struct hmac_sha1_key* key, uint8_t out[SHA1HashSize])
+{
+  struct digest d;
+  struct stat   st;
+  int fd, rc;
+
+  if (strcmp(name, "-") == 0)
+  {
+    fd = STDIN_FILENO;
+  }
+  else
+  {
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+    {
+      fprintf(stderr, "%s: %s: %s\n", _prog, name, strerror(errno));
+      return -1;
+    }
+  }
+
+  _digest_init(&d, key);
+
+  rc = -1;
+  if (    (fstat(fd, &st) == 0)
+       && S_ISREG(st.st_mode)
+       && (st.st_size > 0)
+       && ((uint64_t)st.st_size <= (size_t)-1))
+  {
+    rc = _hash_mapped(fd, (size_t)st.st_size, &d);
+    if (rc == -2)
+    {
+      /* start over with read() on what is left; the mapping did not move the file offset */
+      fprintf(stderr, "%s: %s: file truncated while being read, reading it again\n", _prog, name);
+      _digest_init(&d, key);
+    }
+  }
+  if (rc != 0)
+  {
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    rc = _hash_stream(fd, &d);
+  }
+  if (rc != 0)
+  {
+    fprintf(stderr, "%s: %s: %s\n", _prog, name, strerror(errno));
+  }
+  else if (_digest_final(&d, out) != shaSuccess)
+  {
+    fprintf(stderr, "%s: %s: input too long\n", _prog, name);
+    rc = -1;
+  }
+
+  if (fd != STDIN_FILENO)
+  {
+    close(fd);
+  }
+  return rc;
+}
+
+/*
+ * File name as sha1sum prints it: names holding a newline or a backslash
+ * get them escaped, and the line gets a leading backslash.
+ */
+static void _print_line(const uint8_t digest[SHA1HashSize], const char* name)
+{
+  const char* s;
+  int escape = (strpbrk(name, "\\\n") != 0);
+  unsigned i;
+
+  if (escape)
+  {
+    putchar('\\');
+  }
+  for (i = 0; i < SHA1HashSize; ++i)
+  {
+    printf("%02x", digest[i]);
+  }
+  fputs("  ", stdout);
+  for (s = name; *s != 0; ++s)
+  {
+    if (escape && (*s == '\\'))
+    {
+      fputs("\\\\", stdout);
+    }
+    else if (escape && (*s == '\n'))
+    {
+      fputs("\\n", stdout);
+    }
+    else
+    {
+      putchar(*s);
+    }
+  }
+  putchar('\n');
+}
+
+static int _hex_nibble(int c)
+{
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+  return -1;
+}
+
+/*
+ * Parse one line of sha1sum output in place: "<40 hex>  name" or
+ * "<40 hex> *name", optionally with the leading backslash of an escaped
+ * name.  Returns the file name, or 0 if the line is malformed.
+ */
+static char* _parse_line(char* line, uint8_t digest[SHA1HashSize])
+{
+  char *name, *s, *d;
+  int escaped = 0;
+  int hi, lo;
+  unsigned i;
+
+  line[strcspn(line, "\r\n")] = 0;
+  if (line[0] == '\\')
+  {
+    escaped = 1;
+    line += 1;
+  }
+  for (i = 0; i < SHA1HashSize; ++i)
+  {
+    hi = _hex_nibble(line[2 * i]);
+    lo = (hi < 0) ? -1 : _hex_nibble(line[2 * i + 1]);
+    if (lo < 0)
+    {
+      return 0;
+    }
+    digest[i] = (uint8_t)((hi << 4) | lo);
+  }
+  s = line + 2 * SHA1HashSize;
+  if (    (s[0] != ' ')
+       || ((s[1] != ' ') && (s[1] != '*'))
+       || (s[2] == 0))
+  {
+    return 0;
+  }
+  name = s + 2;
+
+  if (escaped)
+  {
+    for (s = d = name; *s != 0; ++s, ++d)
+    {
+      if ((s[0] == '\\') && (s[1] == 'n'))
+      {
+        *d = '\n';
+        ++s;
+      }
+      else if ((s[0] == '\\') && (s[1] == '\\'))
+      {
+        *d = '\\';
+        ++s;
+      }
+      else
+      {
+        *d = *s;
+      }
+    }
+    *d = 0;
+  }
+  return name;
+}
+
+static void _list_add(struct list* l, const char* name, const uint8_t* digest)
+{
+  if (l->n == l->cap)
+  {
+    l->cap = (l->cap != 0) ? 2 * l->cap : 1024;
+    l->names = realloc(l->names, l->cap * sizeof(*l->names));
+    l->digests = realloc(l->digests, l->cap * sizeof(*l->digests));
+    if ((l->names == 0) || (l->digests == 0))
+    {
+      fprintf(stderr, "%s: %s\n", _prog, strerror(ENOMEM));
+      exit(2);
+    }
+  }
+  l->names[l->n] = strdup(name);
+  if (l->names[l->n] == 0)
+  {
+    fprintf(stderr, "%s: %s\n", _prog, strerror(ENOMEM));
+    exit(2);
+  }
+  if (digest != 0)
+  {
+    memcpy(l->digests[l->n], digest, SHA1HashSize);
+  }
+  l->n += 1;
+}
+
+static void _list_free(struct list* l)
+{
+  size_t i;
+
+  for (i = 0; i < l->n; ++i)
+  {
+    free(l->names[i]);
+  }
+  free(l->names);
+  free(l->digests);
+}
+
+static int _walk_one(const char* path, const struct stat* st, int type, struct FTW* ftw)
+{
+  (void)ftw;
+
+  if ((type == FTW_F) && S_ISREG(st->st_mode))
+  {
+    _list_add(_walk, path, 0);
+  }
+  else if ((type == FTW_DNR) || (type == FTW_NS))
+  {
+    fprintf(stderr, "%s: %s: %s\n", _prog, path, strerror((type == FTW_DNR) ? EACCES : ENOENT));
+  }
+  return 0;
+}
+
+static int _cmp_names(const void* a, const void* b)
+{
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* Add a file, or every regular file below a directory in name order; returns 0 or -1 */
+static int _add_tree(struct list* l, const char* name)
+{
+  struct stat st;
+  size_t first = l->n;
+
+  if (    (strcmp(name, "-") == 0)
+       || (stat(name, &st) != 0)
+       || !S_ISDIR(st.st_mode))
+  {
+    _list_add(l, name, 0);
+    return 0;
+  }
+
+  _walk = l;
+  if (nftw(name, _walk_one, 64, FTW_PHYS) != 0)
+  {
+    fprintf(stderr, "%s: %s: %s\n", _prog, name, strerror(errno));
+    return -1;
+  }
+  qsort(l->names + first, l->n - first, sizeof(*l->names), _cmp_names);
+  return 0;
+}
+
+/*
+ * Digests of all files in the list, pipelined; entries that are not
+ * regular files (standard input, pipes, devices) are hashed one by one.
+ * errors[i] is 0 or -1 (error already printed).
+ */
+static void _hash_list(const struct list* l, const struct hmac_sha1_key* key, uint8_t (*out)[SHA1HashSize], int* errors)
+{
+  size_t i;
+
+  if (sha1_files_hash((const char* const*)l->names, l->n, key, out, errors, _threads, _membytes) != shaSuccess)
+  {
+    fprintf(stderr, "%s: %s\n", _prog, strerror(ENOMEM));
+    exit(2);
+  }
+
+  for (i = 0; i < l->n; ++i)
+  {
+    if (    (errors[i] == EINVAL)
+         || ((errors[i] == ENOENT) && (strcmp(l->names[i], "-") == 0)))
+    {
+      errors[i] = _hash_file(l->names[i], key, out[i]);
+    }
+    else if (errors[i] != 0)
+    {
+      fprintf(stderr, "%s: %s: %s\n", _prog, l->names[i], strerror(errors[i]));
+      errors[i] = -1;
+    }
+  }
+}
+
+/* Read the entries of one checksum list; returns 0 or -1 */
+static int _read_list(struct list* l, const char* list, unsigned* malformed)
+{
+  uint8_t expected[SHA1HashSize];
+  char line[8192];
+  char* name;
+  FILE* f;
+
+  f = (strcmp(list, "-") == 0) ? stdin : fopen(list, "r");
+  if (f == 0)
+  {
+    fprintf(stderr, "%s: %s: %s\n", _prog, list, strerror(errno));
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), f) != 0)
+  {
+    name = _parse_line(line, expected);
+    if (name == 0)
+    {
+      *malformed += 1;
+      continue;
+    }
+    _list_add(l, name, expected);
+  }
+
+  if (f != stdin)
+  {
+    fclose(f);
+  }
+  return 0;
+}
+
+/* Key from a file, read whole (up to MAX_KEY octets) */
+static int _read_key(const char* name, uint8_t* key, size_t* keylen)
+{
+  size_t n;
+  FILE* f;
+
+  f = fopen(name, "rb");
+  if (f == 0)
+  {
+    fprintf(stderr, "%s: %s: %s\n", _prog, name, strerror(errno));
+    return -1;
+  }
+  n = fread(key, 1, MAX_KEY, f);
+  if (fgetc(f) != EOF)
+  {
+    fprintf(stderr, "%s: %s: key longer than %u octets\n", _prog, name, MAX_KEY);
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+  *keylen = n;
+  return 0;
+}
+
+static void _usage(void)
+{
+  fprintf(stderr,
+          "Usage: %s [-k key | -K keyfile] [-r] [-c] [-j threads] [-m MB] [file ...]\n"
+          "\n"
+          "  Print or check SHA-1 digests, or HMAC-SHA1 tags when a key is given.\n"
+          "  With no file, or when file is -, read standard input.\n"
+          "\n"
+          "  -k key      HMAC key, taken literally from the command line\n"
+          "  -K keyfile  HMAC key, the whole contents of keyfile\n"
+          "  -r          hash every regular file below the directories given\n"
+          "  -c          read digests from the files and check them\n"
+          "  -j threads  hashing threads for -r and -c (default: one per CPU)\n"
+          "  -m MB       bound on read buffers for -r and -c (default: %u)\n",
+          _prog, SHA1_FILES_MEMORY >> 20);
+  exit(2);
+}
+
+
+int main(int argc, char* argv[])
+{
+  static char* stdin_only[] = { "-" };
+  static uint8_t key[MAX_KEY];
+  struct hmac_sha1_key key_ctx;
+  const struct hmac_sha1_key* k = 0;
+  uint8_t digest[SHA1HashSize];
+  uint8_t (*digests)[SHA1HashSize];
+  struct list l;
+  unsigned failed = 0, malformed = 0;
+  size_t keylen = 0;
+  char** files;
+  int* errors;
+  int nfiles;
+  int check = 0, recurse = 0;
+  int opt, i;
+  size_t j;
+
+  while ((opt = getopt(argc, argv, "ck:K:rj:m:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'c':
+        check = 1;
+        break;
+      case 'r':
+        recurse = 1;
+        break;
+      case 'j':
+        _threads = (unsigned)strtoul(optarg, 0, 10);
+        break;
+      case 'm':
+        _membytes = (size_t)strtoul(optarg, 0, 10) << 20;
+        break;
+      case 'k':
+        keylen = strlen(optarg);
+        if (keylen > MAX_KEY)
+        {
+          fprintf(stderr, "%s: key longer than %u octets\n", _prog, MAX_KEY);
+          return 2;
+        }
+        memcpy(key, optarg, keylen);
+        k = &key_ctx;
+        break;
+      case 'K':
+        if (_read_key(optarg, key, &keylen) != 0)
+        {
+          return 2;
+        }
+        k = &key_ctx;
+        break;
+      default:
+        _usage();
+    }
+  }
+
+  if (k != 0)
+  {
+    hmac_sha1_key_init(&key_ctx, key, keylen);
+    sha_clear(key, sizeof(key));
+  }
+
+  files = argv + optind;
+  nfiles = argc - optind;
+  if (nfiles == 0)
+  {
+    files = stdin_only;
+    nfiles = 1;
+  }
+
+  if (check || recurse)
+  {
+    /* collect every file first, then hash them all in one pipelined pass */
+    memset(&l, 0, sizeof(l));
+    for (i = 0; i < nfiles; ++i)
+    {
+      if ((check ? _read_list(&l, files[i], &malformed) : _add_tree(&l, files[i])) != 0)
+      {
+        failed += 1;
+      }
+    }
+
+    digests = malloc((l.n + 1) * sizeof(*digests));
+    errors = malloc((l.n + 1) * sizeof(*errors));
+    if ((digests == 0) || (errors == 0))
+    {
+      fprintf(stderr, "%s: %s\n", _prog, strerror(ENOMEM));
+      return 2;
+    }
+    _hash_list(&l, k, digests, errors);
+
+    for (j = 0; j < l.n; ++j)
+    {
+      if (!check)
+      {
+        if (errors[j] == 0)
+        {
+          _print_line(digests[j], l.names[j]);
+        }
+      }
+      else if (errors[j] != 0)
+      {
+        printf("%s: FAILED open or read\n", l.names[j]);
+      }
+      else
+      {
+        printf("%s: %s\n", l.names[j], (memcmp(digests[j], l.digests[j], SHA1HashSize) == 0) ? "OK" : "FAILED");
+      }
+      failed += (errors[j] != 0) || (check && (memcmp(digests[j], l.digests[j], SHA1HashSize) != 0));
+    }
+
+    free(errors);
+    free(digests);
+    _list_free(&l);
+  }
+  else
+  {
+    for (i = 0; i < nfiles; ++i)
+    {
+      if (_hash_file(files[i], k, digest) != 0)
+      {
+        failed += 1;
+      }
+      else
+      {
+        _print_line(digest, files[i]);
+      }
+    }
+  }
+
+  if (malformed != 0)
+  {
+    fprintf(stderr, "%s: WARNING: %u line%s improperly formatted\n", _prog, malformed, (malformed == 1) ? " is" : "s are");
+  }
+  if (check && (failed != 0))
+  {
+    fprintf(stderr, "%s: WARNING: %u computed checksum%s did NOT match\n", _prog, failed, (failed == 1) ? "" : "s");
+  }
+
+  free(_buffer);
+  sha_clear(&key_ctx, sizeof(key_ctx));
+
+  return ((failed != 0) || (malformed != 0)) ? 1 : 0;
+}